@@ -0,0 +1,74 @@
+// Measures graph size and A* query time before and after degree-2 chain compression.
+//
+// Usage: bench_chain [-f map.osm] [-n queries]
+
+#include <cmath>
+#include <random>
+#include "bench_common.h"
+#include "../src/chain_graph.h"
+#include "../src/graph_search.h"
+#include "../src/route_model.h"
+
+int main(int argc, const char **argv)
+{
+    int num_queries = 1000;
+    for (int i = 1; i + 1 < argc; ++i)
+        if (std::string_view{argv[i]} == "-n")
+            num_queries = std::stoi(argv[i + 1]);
+
+    MappedFile file{MapFileArgument(argc, argv)};
+    if (!file.Valid()) {
+        std::cout << "Failed to read." << std::endl;
+        return 1;
+    }
+    RouteModel model{std::move(file)};
+    RouteGraph graph{model};
+
+    Stopwatch build;
+    ChainGraph chains{graph};
+    const double build_us = build.ElapsedMicros();
+
+    std::vector<int> routable;
+    for (int node = 0; node < graph.NumNodes(); ++node)
+        if (graph.Degree(node) > 0)
+            routable.push_back(node);
+
+    std::mt19937 rng{7};
+    std::uniform_int_distribution<size_t> pick(0, routable.size() - 1);
+    SearchWorkspace workspace;
+    double base_us = 0., chain_us = 0.;
+    long base_expanded = 0, chain_expanded = 0;
+    int measured = 0, mismatches = 0;
+    for (int q = 0; q < num_queries; ++q) {
+        const int source = routable[pick(rng)], target = routable[pick(rng)];
+
+        Stopwatch base_timer;
+        SearchResult expected = AStar(graph, workspace, {{source, 0.f}}, {{target, 0.f}});
+        base_us += base_timer.ElapsedMicros();
+
+        SearchResult found;
+        Stopwatch chain_timer;
+        chains.ShortestPath(workspace, source, target, &found);
+        chain_us += chain_timer.ElapsedMicros();
+
+        if (!expected.Found())
+            continue;
+        base_expanded += expected.expanded;
+        chain_expanded += found.expanded;
+        if (std::abs(found.cost - expected.cost) > 1e-4f)
+            mismatches++;
+        measured++;
+    }
+
+    std::cout << "Routable nodes:       " << routable.size() << " -> " << chains.NumKeptNodes() << "\n";
+    std::cout << "Arcs:                 " << graph.NumArcs() << " -> " << chains.NumArcs() << "\n";
+    std::cout << "Compression time:     " << build_us / 1000. << " ms\n";
+    std::cout << "Queries measured:     " << measured << "\n";
+    std::cout << "Full graph A*:        " << base_us / num_queries << " us, "
+              << (double)base_expanded / std::max(measured, 1) << " expansions\n";
+    std::cout << "Compressed A*:        " << chain_us / num_queries << " us, "
+              << (double)chain_expanded / std::max(measured, 1) << " expansions (including unpacking)\n";
+    std::cout << "Speedup:              " << base_us / chain_us << "x\n";
+    std::cout << "Distance mismatches:  " << mismatches << std::endl;
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,34 @@
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../src/mapped_file.h"
+
+// Shared helpers for the benchmark executables.
+
+// Returns the value following `-f`, or the default map next to the build directory.
+inline std::string MapFileArgument(int argc, const char **argv)
+{
+    for (int i = 1; i + 1 < argc; ++i)
+        if (std::string_view{argv[i]} == "-f")
+            return argv[i + 1];
+    return "../map.osm";
+}
+
+class Stopwatch {
+  public:
+    Stopwatch() : m_Start(std::chrono::steady_clock::now()) {}
+    double ElapsedMicros() const {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_Start).count();
+    }
+
+  private:
+    std::chrono::steady_clock::time_point m_Start;
+};
+
+#endif
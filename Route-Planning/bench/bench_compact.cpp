@@ -0,0 +1,77 @@
+// Compares the memory footprint of the road geometry and A* query time on a
+// graph reading coordinates from the Model against one reading the fixed-point
+// coordinates of CompactGeometry.
+//
+// Usage: bench_compact [-f map.osm] [-n queries]
+
+#include <cmath>
+#include <random>
+#include "bench_common.h"
+#include "../src/compact_geometry.h"
+#include "../src/graph_search.h"
+#include "../src/route_model.h"
+
+int main(int argc, const char **argv)
+{
+    int num_queries = 1000;
+    for (int i = 1; i + 1 < argc; ++i)
+        if (std::string_view{argv[i]} == "-n")
+            num_queries = std::stoi(argv[i + 1]);
+
+    MappedFile file{MapFileArgument(argc, argv)};
+    if (!file.Valid()) {
+        std::cout << "Failed to read." << std::endl;
+        return 1;
+    }
+    RouteModel model{std::move(file)};
+    RouteGraph graph{model};
+
+    Stopwatch encode;
+    CompactGeometry geometry{model};
+    const double encode_us = encode.ElapsedMicros();
+    Stopwatch build;
+    RouteGraph compact{geometry};
+    const double build_us = build.ElapsedMicros();
+
+    std::vector<int> routable;
+    for (int node = 0; node < graph.NumNodes(); ++node)
+        if (graph.Degree(node) > 0)
+            routable.push_back(node);
+
+    std::mt19937 rng{7};
+    std::uniform_int_distribution<size_t> pick(0, routable.size() - 1);
+    SearchWorkspace workspace;
+    double model_us = 0., compact_us = 0., max_error = 0.;
+    int mismatches = 0;
+    for (int q = 0; q < num_queries; ++q) {
+        const int source = routable[pick(rng)], target = routable[pick(rng)];
+
+        Stopwatch model_timer;
+        SearchResult expected = AStar(graph, workspace, {{source, 0.f}}, {{target, 0.f}});
+        model_us += model_timer.ElapsedMicros();
+
+        Stopwatch compact_timer;
+        SearchResult found = AStar(compact, workspace, {{source, 0.f}}, {{target, 0.f}});
+        compact_us += compact_timer.ElapsedMicros();
+
+        if (found.Found() != expected.Found() || std::abs(found.cost - expected.cost) > 1e-4f)
+            mismatches++;
+    }
+    for (int node = 0; node < graph.NumNodes(); ++node) {
+        const auto a = graph.Coord(node), b = compact.Coord(node);
+        max_error = std::max({max_error, std::abs(a.x - b.x), std::abs(a.y - b.y)});
+    }
+
+    const size_t model_bytes = CompactGeometry::ModelBytes(model), compact_bytes = geometry.MemoryBytes();
+    std::cout << "Nodes / arcs:         " << graph.NumNodes() << " / " << graph.NumArcs()
+              << (compact.NumArcs() == graph.NumArcs() ? "" : " (arc count differs!)") << "\n";
+    std::cout << "Model geometry:       " << model_bytes / 1024 << " KB\n";
+    std::cout << "Compact geometry:     " << compact_bytes / 1024 << " KB ("
+              << 100. * compact_bytes / model_bytes << "%)\n";
+    std::cout << "Encode / graph build: " << encode_us / 1000. << " ms / " << build_us / 1000. << " ms\n";
+    std::cout << "Max coordinate error: " << max_error * graph.MetricScale() * 1000. << " mm\n";
+    std::cout << "Model A*:             " << model_us / num_queries << " us\n";
+    std::cout << "Compact A*:           " << compact_us / num_queries << " us\n";
+    std::cout << "Cost mismatches:      " << mismatches << std::endl;
+    return mismatches == 0 && compact.NumArcs() == graph.NumArcs() ? 0 : 1;
+}
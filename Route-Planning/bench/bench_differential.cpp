@@ -0,0 +1,115 @@
+// Differential regression and performance gate: random queries answered by
+// plain A* on the full graph (the reference) and by every accelerated engine,
+// with per-engine latency distributions. Exits with 1 when an engine returns a
+// different cost or an invalid route, so it can run as a CI gate.
+//
+// The legacy RoutePlanner::AStarSearch is timed for comparison only: it takes
+// the closest unvisited node per road as neighbor and closes nodes when they
+// are first reached, so its routes are not always shortest.
+//
+// Usage: bench_differential [-f map.osm] [-n queries] [-s seed] [-l landmarks]
+
+#include <thread>
+#include "bench_common.h"
+#include "../src/chain_graph.h"
+#include "../src/compact_geometry.h"
+#include "../src/differential.h"
+#include "../src/landmarks.h"
+#include "../src/partition_overlay.h"
+#include "../src/route_planner.h"
+#include "../src/route_service.h"
+
+int main(int argc, const char **argv)
+{
+    int num_queries = 2000;
+    unsigned seed = 1;
+    int num_landmarks = 16;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string_view{argv[i]} == "-n")
+            num_queries = std::stoi(argv[i + 1]);
+        else if (std::string_view{argv[i]} == "-s")
+            seed = std::stoul(argv[i + 1]);
+        else if (std::string_view{argv[i]} == "-l")
+            num_landmarks = std::stoi(argv[i + 1]);
+    }
+
+    MappedFile file{MapFileArgument(argc, argv)};
+    if (!file.Valid()) {
+        std::cout << "Failed to read." << std::endl;
+        return 1;
+    }
+    RouteModel model{std::move(file)};
+    const RouteGraph &graph = model.Graph();
+    const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+
+    Stopwatch preprocess;
+    const ChainGraph chains{graph};
+    const Landmarks landmarks = Landmarks::Compute(graph, num_landmarks, threads);
+    PartitionOverlay overlay{graph, {32, 256, 2048}};
+    overlay.Customize(threads);
+    const CompactGeometry geometry{model};
+    const RouteGraph compact{geometry};
+    RouteService service{model, 1};
+    std::cout << "Preprocessing:     " << preprocess.ElapsedMicros() / 1000. << " ms\n";
+
+    SearchWorkspace workspace;
+    auto extract = [&](const RouteGraph &searched, const SearchResult &result, int target, RoutePath &path) {
+        if (result.Found())
+            path = ExtractPath(searched, workspace, target);
+        return result;
+    };
+    auto at = [&](int node) { return graph.Coord(node); };
+    std::vector<DifferentialEngine> engines = {
+        {"astar", [&](int source, int target, RoutePath &path) {
+             return extract(graph, AStar(graph, workspace, {{source, 0.f}}, {{target, 0.f}}), target, path);
+         }},
+        {"alt", [&](int source, int target, RoutePath &path) {
+             return extract(graph, landmarks.Search(graph, workspace, source, target), target, path);
+         }},
+        {"chain", [&](int source, int target, RoutePath &path) {
+             SearchResult result;
+             path = chains.ShortestPath(workspace, source, target, &result);
+             return result;
+         }},
+        {"overlay", [&](int source, int target, RoutePath &path) {
+             SearchResult result;
+             path = overlay.ShortestPath(workspace, source, target, &result);
+             return result;
+         }},
+        {"compact", [&](int source, int target, RoutePath &path) {
+             return extract(compact, AStar(compact, workspace, {{source, 0.f}}, {{target, 0.f}}), target, path);
+         }},
+        {"service", [&](int source, int target, RoutePath &) {
+             // Snaps to the nodes themselves; the route is left out as it starts on the snapped segment.
+             const auto from = at(source), to = at(target);
+             const RouteQueryResult answer =
+                 service.Run((float)from.x * 100.f, (float)from.y * 100.f, (float)to.x * 100.f, (float)to.y * 100.f);
+             SearchResult result;
+             if (answer.status == SearchStatus::Found) {
+                 result.target = 0;
+                 result.cost = (float)(answer.stats.distance / graph.MetricScale());
+             }
+             return result;
+         }},
+        {"legacy", [&](int source, int target, RoutePath &) {
+             const auto from = at(source), to = at(target);
+             model.ResetSearchState();
+             RoutePlanner planner{model, (float)from.x * 100.f, (float)from.y * 100.f, (float)to.x * 100.f,
+                                  (float)to.y * 100.f};
+             planner.AStarSearch();
+             SearchResult result;
+             if (planner.GetStatus() == SearchStatus::Found) {
+                 result.target = 0;
+                 result.cost = (float)(planner.GetDistance() / graph.MetricScale());
+             }
+             return result;
+         }, false},
+    };
+
+    const auto queries = RandomQueries(graph, num_queries, seed);
+    const DifferentialReport report = RunDifferential(graph, engines, queries);
+    std::cout << "Queries:           " << queries.size() << " (seed " << seed << ")\n";
+    report.Write(std::cout);
+    std::cout << (report.Passed() ? "PASSED" : "FAILED") << std::endl;
+    return report.Passed() ? 0 : 1;
+}
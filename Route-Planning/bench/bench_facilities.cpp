@@ -0,0 +1,102 @@
+// Measures k-nearest facility queries: a search that stops after k facilities
+// against a full Dijkstra followed by picking the k cheapest, and the batch
+// version of RouteService on one and on all threads, for random depots and
+// random query points.
+//
+// Usage: bench_facilities [-f map.osm] [-n queries] [-d depots] [-k k]
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <thread>
+#include "bench_common.h"
+#include "../src/facilities.h"
+#include "../src/route_service.h"
+
+int main(int argc, const char **argv)
+{
+    int num_queries = 2000;
+    int num_depots = 500;
+    int k = 5;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string_view{argv[i]} == "-n")
+            num_queries = std::stoi(argv[i + 1]);
+        else if (std::string_view{argv[i]} == "-d")
+            num_depots = std::stoi(argv[i + 1]);
+        else if (std::string_view{argv[i]} == "-k")
+            k = std::stoi(argv[i + 1]);
+    }
+
+    MappedFile file{MapFileArgument(argc, argv)};
+    if (!file.Valid()) {
+        std::cout << "Failed to read." << std::endl;
+        return 1;
+    }
+    RouteModel model{std::move(file)};
+    const RouteGraph &graph = model.Graph();
+    const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::mt19937 rng{5};
+    std::uniform_real_distribution<float> percent(0.f, 100.f);
+    std::vector<std::pair<float, float>> depots(num_depots), points(num_queries);
+    for (auto &depot : depots)
+        depot = {percent(rng), percent(rng)};
+    for (auto &point : points)
+        point = {percent(rng), percent(rng)};
+
+    RouteService serial{model, 1}, parallel{model, threads};
+    const FacilitySet facilities = serial.SnapFacilities(depots);
+    const SegmentRTree segments{graph};
+
+    // Graph level, one thread: early stop against a full search.
+    SearchWorkspace workspace;
+    double early_us = 0., full_us = 0.;
+    int mismatches = 0;
+    std::vector<float> costs;
+    for (const auto &[x, y] : points) {
+        const auto sources = segments.SourceSeeds(segments.Nearest(x * 0.01, y * 0.01));
+        Stopwatch early;
+        const auto nearest = NearestFacilities(graph, workspace, sources, facilities, k);
+        early_us += early.ElapsedMicros();
+
+        Stopwatch full;
+        BoundedDijkstra(graph, workspace, sources, RouteGraph::kClosed);
+        costs.assign(facilities.Count(), RouteGraph::kClosed);
+        for (int node = 0; node < graph.NumNodes(); ++node)
+            if (workspace.Reached(node))
+                facilities.ForEachAt(node, [&](int facility, float cost) {
+                    costs[facility] = std::min(costs[facility], workspace.G(node) + cost);
+                });
+        std::vector<float> expected;
+        for (float cost : costs)
+            if (cost < RouteGraph::kClosed)
+                expected.push_back(cost);
+        const size_t count = std::min<size_t>(k, expected.size());
+        std::partial_sort(expected.begin(), expected.begin() + count, expected.end());
+        full_us += full.ElapsedMicros();
+
+        if (nearest.size() != count)
+            mismatches++;
+        else
+            for (size_t i = 0; i < count; ++i)
+                if (std::abs(nearest[i].cost - expected[i]) > 1e-4f)
+                    mismatches++;
+    }
+
+    auto batch = [&](const RouteService &service) {
+        Stopwatch timer;
+        service.NearestFacilities(points, facilities, k);
+        return timer.ElapsedMicros();
+    };
+    const double serial_us = batch(serial), parallel_us = batch(parallel);
+
+    std::cout << "Depots:               " << num_depots << ", k = " << k << ", " << num_queries << " query points\n"
+              << "Full Dijkstra + pick: " << full_us / num_queries << " us/query\n"
+              << "Stop after k:         " << early_us / num_queries << " us/query (" << full_us / early_us << "x)\n"
+              << "Service batch, 1 thr: " << serial_us / 1000. << " ms (" << num_queries / serial_us * 1e6
+              << " queries/s)\n"
+              << "Service batch, " << threads << " thr: " << parallel_us / 1000. << " ms ("
+              << num_queries / parallel_us * 1e6 << " queries/s)\n"
+              << "Cost mismatches:      " << mismatches << "\n";
+    return mismatches == 0 ? 0 : 1;
+}
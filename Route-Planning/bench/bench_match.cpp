@@ -0,0 +1,91 @@
+// Map matches synthetic GPS traces, sampled from random routes with Gaussian
+// noise, and reports throughput and accuracy for one thread and for all threads.
+//
+// Usage: bench_match [-f map.osm] [-n traces] [-s noise_m]
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+#include <thread>
+#include "bench_common.h"
+#include "../src/graph_search.h"
+#include "../src/map_matcher.h"
+#include "../src/route_model.h"
+
+int main(int argc, const char **argv)
+{
+    int num_traces = 500;
+    double noise_m = 5.;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string_view{argv[i]} == "-n")
+            num_traces = std::stoi(argv[i + 1]);
+        else if (std::string_view{argv[i]} == "-s")
+            noise_m = std::stod(argv[i + 1]);
+    }
+
+    MappedFile file{MapFileArgument(argc, argv)};
+    if (!file.Valid()) {
+        std::cout << "Failed to read." << std::endl;
+        return 1;
+    }
+    RouteModel model{std::move(file)};
+    const RouteGraph &graph = model.Graph();
+    SegmentRTree segments{graph};
+    MapMatcher matcher{graph, segments};
+
+    std::vector<int> routable;
+    for (int node = 0; node < graph.NumNodes(); ++node)
+        if (graph.Degree(node) > 0)
+            routable.push_back(node);
+
+    // Sample a fix every 15 m along random routes.
+    std::mt19937 rng{7};
+    std::uniform_int_distribution<size_t> pick(0, routable.size() - 1);
+    std::normal_distribution<double> noise(0., noise_m / graph.MetricScale());
+    const double spacing = 15. / graph.MetricScale();
+    SearchWorkspace workspace;
+    std::vector<std::vector<TracePoint>> traces;
+    std::vector<std::set<std::pair<int, int>>> truth;
+    size_t num_points = 0;
+    while ((int)traces.size() < num_traces) {
+        const int source = routable[pick(rng)], target = routable[pick(rng)];
+        if (!AStar(graph, workspace, {{source, 0.f}}, {{target, 0.f}}).Found())
+            continue;
+        RoutePath path = ExtractPath(graph, workspace, target);
+        if (path.size() < 2)
+            continue;
+        std::vector<TracePoint> trace;
+        std::set<std::pair<int, int>> on_route;
+        double offset = 0.;
+        for (size_t i = 1; i < path.size(); ++i) {
+            const auto &a = graph.Coord(path.nodes[i - 1]), &b = graph.Coord(path.nodes[i]);
+            const double length = std::hypot(b.x - a.x, b.y - a.y);
+            for (; offset < length; offset += spacing)
+                trace.push_back({a.x + (b.x - a.x) * offset / length + noise(rng), a.y + (b.y - a.y) * offset / length + noise(rng)});
+            offset -= length;
+            on_route.insert(std::minmax(path.nodes[i - 1], path.nodes[i]));
+        }
+        num_points += trace.size();
+        traces.push_back(std::move(trace));
+        truth.push_back(std::move(on_route));
+    }
+
+    auto run = [&](unsigned threads) {
+        Stopwatch timer;
+        auto matches = matcher.MatchTraces(traces, threads);
+        const double seconds = timer.ElapsedMicros() / 1e6;
+        size_t correct = 0, breaks = 0;
+        for (size_t t = 0; t < matches.size(); ++t) {
+            breaks += matches[t].breaks;
+            for (const auto &snap : matches[t].points)
+                correct += snap.Valid() && truth[t].count(std::minmax(snap.from, snap.to));
+        }
+        std::cout << "Threads " << threads << ":  " << num_points / seconds << " points/s, "
+                  << 100. * correct / num_points << "% on the true route, " << breaks << " breaks\n";
+    };
+    std::cout << "Traces: " << traces.size() << ", points: " << num_points << ", noise: " << noise_m << " m\n";
+    run(1);
+    run(std::thread::hardware_concurrency());
+    return 0;
+}
@@ -0,0 +1,101 @@
+// Measures the multi-level partition overlay: partitioning, customization on one
+// and on all threads, and query time against A* on the full graph, before and
+// after applying random traffic penalties.
+//
+// Usage: bench_overlay [-f map.osm] [-n queries] [-c cell_size ...]
+
+#include <cmath>
+#include <random>
+#include <thread>
+#include "bench_common.h"
+#include "../src/graph_search.h"
+#include "../src/partition_overlay.h"
+#include "../src/route_model.h"
+
+int main(int argc, const char **argv)
+{
+    int num_queries = 1000;
+    std::vector<int> cell_sizes;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string_view{argv[i]} == "-n")
+            num_queries = std::stoi(argv[i + 1]);
+        else if (std::string_view{argv[i]} == "-c")
+            cell_sizes.push_back(std::stoi(argv[i + 1]));
+    }
+    if (cell_sizes.empty())
+        cell_sizes = {32, 256, 2048};
+
+    MappedFile file{MapFileArgument(argc, argv)};
+    if (!file.Valid()) {
+        std::cout << "Failed to read." << std::endl;
+        return 1;
+    }
+    RouteModel model{std::move(file)};
+    RouteGraph graph{model};
+
+    Stopwatch partition;
+    PartitionOverlay overlay{graph, cell_sizes};
+    const double partition_us = partition.ElapsedMicros();
+
+    std::vector<int> routable;
+    for (int node = 0; node < graph.NumNodes(); ++node)
+        if (graph.Degree(node) > 0)
+            routable.push_back(node);
+
+    const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    auto customize = [&](unsigned customize_threads) {
+        Stopwatch timer;
+        overlay.Customize(customize_threads);
+        return timer.ElapsedMicros();
+    };
+    auto run_queries = [&](const char *label) {
+        std::mt19937 rng{7};
+        std::uniform_int_distribution<size_t> pick(0, routable.size() - 1);
+        SearchWorkspace workspace;
+        double base_us = 0., overlay_us = 0.;
+        long base_expanded = 0, overlay_expanded = 0;
+        int mismatches = 0;
+        for (int q = 0; q < num_queries; ++q) {
+            const int source = routable[pick(rng)], target = routable[pick(rng)];
+            Stopwatch base_timer;
+            SearchResult expected = AStar(graph, workspace, {{source, 0.f}}, {{target, 0.f}});
+            base_us += base_timer.ElapsedMicros();
+            SearchResult found;
+            Stopwatch overlay_timer;
+            overlay.ShortestPath(workspace, source, target, &found);
+            overlay_us += overlay_timer.ElapsedMicros();
+            base_expanded += expected.expanded;
+            overlay_expanded += found.expanded;
+            if (found.Found() != expected.Found() || (expected.Found() && std::abs(found.cost - expected.cost) > 1e-4f))
+                mismatches++;
+        }
+        std::cout << label << "\n";
+        std::cout << "  Full graph A*:      " << base_us / num_queries << " us, "
+                  << (double)base_expanded / num_queries << " expansions\n";
+        std::cout << "  Overlay query:      " << overlay_us / num_queries << " us (including unpacking), "
+                  << (double)overlay_expanded / num_queries << " expansions\n";
+        std::cout << "  Cost mismatches:    " << mismatches << "\n";
+        return mismatches;
+    };
+
+    std::cout << "Levels:               " << overlay.NumLevels() << "\n";
+    for (int level = 0; level < overlay.NumLevels(); ++level)
+        std::cout << "  level " << level << ":            " << overlay.NumCells(level) << " cells, "
+                  << overlay.NumBoundaryNodes(level) << " boundary nodes\n";
+    std::cout << "Shortcuts:            " << overlay.NumShortcuts() << "\n";
+    std::cout << "Partition time:       " << partition_us / 1000. << " ms\n";
+    std::cout << "Customize, 1 thread:  " << customize(1) / 1000. << " ms\n";
+    std::cout << "Customize, " << threads << " threads: " << customize(threads) / 1000. << " ms\n";
+    int mismatches = run_queries("Base costs:");
+
+    // Traffic: slow down a random 10% of the edges by up to 3x, then customize again.
+    std::mt19937 rng{11};
+    std::uniform_real_distribution<float> factor(1.f, 3.f);
+    for (int node : routable)
+        for (int arc = graph.FirstArc(node); arc < graph.LastArc(node); ++arc)
+            if (node < graph.Head(arc) && rng() % 10 == 0)
+                graph.ScaleEdge(node, graph.Head(arc), factor(rng));
+    std::cout << "Re-customize:         " << customize(threads) / 1000. << " ms\n";
+    mismatches += run_queries("With traffic penalties:");
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+// Compares loading the same extract as OSM XML and as OSM PBF, and the PBF block
+// decoding on one and on all threads. Without -p the XML map is converted first.
+//
+// Usage: bench_pbf [-f map.osm] [-p map.osm.pbf] [-o converted.osm.pbf] [-n repetitions]
+
+#include <algorithm>
+#include <thread>
+#include "bench_common.h"
+#include "../src/model.h"
+#include "../src/osm_pbf.h"
+
+// Fastest of `repetitions` runs, in milliseconds.
+template <typename F>
+static double BestOf(int repetitions, F &&run)
+{
+    double best = std::numeric_limits<double>::max();
+    for (int i = 0; i < repetitions; ++i) {
+        Stopwatch timer;
+        run();
+        best = std::min(best, timer.ElapsedMicros() / 1000.);
+    }
+    return best;
+}
+
+int main(int argc, const char **argv)
+{
+    std::string pbf_file, output_file = "map.osm.pbf";
+    int repetitions = 5;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string_view{argv[i]} == "-p")
+            pbf_file = argv[i + 1];
+        else if (std::string_view{argv[i]} == "-o")
+            output_file = argv[i + 1];
+        else if (std::string_view{argv[i]} == "-n")
+            repetitions = std::stoi(argv[i + 1]);
+    }
+    const std::string xml_file = MapFileArgument(argc, argv);
+    MappedFile xml{xml_file};
+    if (!xml.Valid()) {
+        std::cout << "Failed to read." << std::endl;
+        return 1;
+    }
+    if (pbf_file.empty()) {
+        Stopwatch convert;
+        const auto pbf = ConvertOsmXmlToPbf(xml.Data(), xml.Size());
+        std::ofstream os{output_file, std::ios::binary | std::ios::trunc};
+        os.write(reinterpret_cast<const char *>(pbf.data()), pbf.size());
+        if (!os) {
+            std::cout << "Failed to write " << output_file << std::endl;
+            return 1;
+        }
+        std::cout << "Converted to " << output_file << " in " << convert.ElapsedMicros() / 1000. << " ms\n";
+        pbf_file = output_file;
+    }
+    MappedFile pbf{pbf_file};
+    if (!pbf.Valid() || !IsOsmPbf(pbf.Data(), pbf.Size())) {
+        std::cout << pbf_file << " is not a PBF file." << std::endl;
+        return 1;
+    }
+
+    const double xml_ms = BestOf(repetitions, [&] { Model model{MappedFile{xml_file}}; });
+    const double pbf_ms = BestOf(repetitions, [&] { Model model{MappedFile{pbf_file}}; });
+    const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    const double decode_1_ms = BestOf(repetitions, [&] { ReadOsmPbf(pbf.Data(), pbf.Size(), 1); });
+    const double decode_n_ms = BestOf(repetitions, [&] { ReadOsmPbf(pbf.Data(), pbf.Size(), threads); });
+
+    Model from_xml{MappedFile{xml_file}}, from_pbf{MappedFile{pbf_file}};
+    const bool same = from_xml.Nodes().size() == from_pbf.Nodes().size() &&
+                      from_xml.Ways().size() == from_pbf.Ways().size() &&
+                      from_xml.Roads().size() == from_pbf.Roads().size() &&
+                      from_xml.Buildings().size() == from_pbf.Buildings().size() &&
+                      from_xml.Landuses().size() == from_pbf.Landuses().size();
+
+    std::cout << "File size:            XML " << xml.Size() / 1024 << " KB, PBF " << pbf.Size() / 1024 << " KB ("
+              << (double)xml.Size() / pbf.Size() << "x smaller)\n";
+    std::cout << "Model load (XML):     " << xml_ms << " ms\n";
+    std::cout << "Model load (PBF):     " << pbf_ms << " ms (" << xml_ms / pbf_ms << "x faster)\n";
+    std::cout << "PBF decode, 1 thread: " << decode_1_ms << " ms\n";
+    std::cout << "PBF decode, " << threads << " threads: " << decode_n_ms << " ms\n";
+    std::cout << "Same model contents:  " << (same ? "yes" : "NO") << std::endl;
+    return same ? 0 : 1;
+}
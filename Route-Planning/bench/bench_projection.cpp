@@ -0,0 +1,68 @@
+// Measures the Mercator projection of Model::AdjustCoordinates: projecting each
+// node with log/tan against the batched polynomial kernel on one and on all
+// threads, on random nodes in a square region.
+//
+// Usage: bench_projection [-n nodes] [-a degrees] [-l latitude] [-r repetitions]
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <thread>
+#include "bench_common.h"
+#include "../src/projection.h"
+
+int main(int argc, const char **argv)
+{
+    size_t num_nodes = 4000000;
+    double degrees = 1.;
+    double min_lat = 52.;
+    int repetitions = 5;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string_view{argv[i]} == "-n")
+            num_nodes = std::stoul(argv[i + 1]);
+        else if (std::string_view{argv[i]} == "-a")
+            degrees = std::stod(argv[i + 1]);
+        else if (std::string_view{argv[i]} == "-l")
+            min_lat = std::stod(argv[i + 1]);
+        else if (std::string_view{argv[i]} == "-r")
+            repetitions = std::max(1, std::stoi(argv[i + 1]));
+    }
+
+    std::mt19937 rng{11};
+    std::uniform_real_distribution<double> lat(min_lat, min_lat + degrees), lon(0., degrees);
+    std::vector<Model::Node> input(num_nodes);
+    for (auto &node : input)
+        node = {lon(rng), lat(rng)};
+    const double origin_x = MercatorX(0.), origin_y = MercatorY(min_lat);
+    const double scale = MercatorY(min_lat + degrees) - origin_y;
+
+    const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<Model::Node> nodes, exact;
+    auto best_of = [&](auto &&project) {
+        double best = 1e300;
+        for (int r = 0; r < repetitions; ++r) {
+            nodes = input;
+            Stopwatch timer;
+            project();
+            best = std::min(best, timer.ElapsedMicros());
+        }
+        return best;
+    };
+    const double exact_us = best_of([&] { ProjectMercatorExact(nodes.data(), nodes.size(), origin_x, origin_y, scale); });
+    exact = nodes;
+    const double serial_us = best_of([&] { ProjectMercator(nodes.data(), nodes.size(), origin_x, origin_y, scale, 1); });
+    const double parallel_us =
+        best_of([&] { ProjectMercator(nodes.data(), nodes.size(), origin_x, origin_y, scale, threads); });
+
+    double max_error = 0.;
+    for (size_t i = 0; i < nodes.size(); ++i)
+        max_error = std::max({max_error, std::abs(nodes[i].x - exact[i].x), std::abs(nodes[i].y - exact[i].y)});
+
+    std::cout << "Nodes:              " << num_nodes << " in " << degrees << " x " << degrees << " degrees\n"
+              << "log/tan per node:   " << exact_us / 1000. << " ms\n"
+              << "Batched, 1 thr.:    " << serial_us / 1000. << " ms (" << exact_us / serial_us << "x)\n"
+              << "Batched, " << threads << " thr.:  " << parallel_us / 1000. << " ms (" << exact_us / parallel_us
+              << "x)\n"
+              << "Max deviation:      " << max_error * scale * 1e6 << " um\n";
+    return 0;
+}
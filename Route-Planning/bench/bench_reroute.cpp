@@ -0,0 +1,87 @@
+// Compares repairing a route with LPA* after a road closure against a fresh A*
+// search on the same graph, with a workspace reused across queries as a
+// long-running router would keep it.
+//
+// Usage: bench_reroute [-f map.osm] [-n queries]
+
+#include <cmath>
+#include <random>
+#include "bench_common.h"
+#include "../src/graph_search.h"
+#include "../src/lpa_star.h"
+#include "../src/route_graph.h"
+#include "../src/route_model.h"
+
+int main(int argc, const char **argv)
+{
+    int num_queries = 200;
+    for (int i = 1; i + 1 < argc; ++i)
+        if (std::string_view{argv[i]} == "-n")
+            num_queries = std::stoi(argv[i + 1]);
+
+    MappedFile file{MapFileArgument(argc, argv)};
+    if (!file.Valid()) {
+        std::cout << "Failed to read." << std::endl;
+        return 1;
+    }
+    RouteModel model{std::move(file)};
+    RouteGraph graph{model};
+
+    std::vector<int> routable;
+    for (int node = 0; node < graph.NumNodes(); ++node)
+        if (graph.Degree(node) > 0)
+            routable.push_back(node);
+
+    std::mt19937 rng{42};
+    std::uniform_int_distribution<size_t> pick(0, routable.size() - 1);
+
+    SearchWorkspace workspace;
+    int measured = 0, mismatches = 0;
+    double repair_us = 0., fresh_us = 0.;
+    long repair_expansions = 0, fresh_expansions = 0;
+    for (int q = 0; q < num_queries; ++q) {
+        const int start = routable[pick(rng)], goal = routable[pick(rng)];
+        LPAStar planner{graph, start, goal};
+        if (!planner.ComputeShortestPath())
+            continue;
+        auto path = planner.Path();
+        if (path.size() < 3)
+            continue;
+
+        // Close the segment in the middle of the current route.
+        const int from = path.nodes[path.size() / 2 - 1], to = path.nodes[path.size() / 2];
+        graph.CloseEdge(from, to);
+
+        const int before = planner.Expansions();
+        Stopwatch repair;
+        planner.Replan();
+        repair_us += repair.ElapsedMicros();
+        repair_expansions += planner.Expansions() - before;
+
+        Stopwatch fresh;
+        const SearchResult scratch = AStar(graph, workspace, {{start, 0.f}}, {{goal, 0.f}});
+        fresh_us += fresh.ElapsedMicros();
+        fresh_expansions += scratch.expanded;
+
+        const float scratch_distance = scratch.Found() ? (float)(scratch.cost * graph.MetricScale()) : INFINITY;
+        if (scratch.Found() != std::isfinite(planner.GetDistance()) ||
+            (scratch.Found() &&
+             std::abs(planner.GetDistance() - scratch_distance) > 1e-3f * std::max(1.f, scratch_distance)))
+            mismatches++;
+        graph.RestoreEdge(from, to);
+        measured++;
+    }
+
+    if (measured == 0) {
+        std::cout << "No routable queries." << std::endl;
+        return 1;
+    }
+    std::cout << "Queries measured:     " << measured << "\n";
+    std::cout << "Repair (LPA*):        " << repair_us / measured << " us, "
+              << (double)repair_expansions / measured << " expansions\n";
+    std::cout << "Fresh A*:             " << fresh_us / measured << " us, "
+              << (double)fresh_expansions / measured << " expansions\n";
+    std::cout << "Speedup:              " << fresh_us / repair_us << "x\n";
+    std::cout << "Distance mismatches:  " << mismatches << std::endl;
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,92 @@
+// Measures the routing daemon: starts a RouteServer on a temporary socket and
+// sends random route requests from concurrent clients, reporting throughput and
+// client-side latency percentiles, next to the map load time that every
+// request pays when a new process is spawned per query.
+//
+// Usage: bench_server [-f map.osm] [-c clients] [-n requests per client]
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include "bench_common.h"
+#include "../src/route_model.h"
+#include "../src/route_server.h"
+#include "../src/search_stats.h"
+
+int main(int argc, const char **argv)
+{
+    int num_clients = 4;
+    int num_requests = 500;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string_view{argv[i]} == "-c")
+            num_clients = std::max(1, std::stoi(argv[i + 1]));
+        else if (std::string_view{argv[i]} == "-n")
+            num_requests = std::stoi(argv[i + 1]);
+    }
+
+    Stopwatch load;
+    MappedFile file{MapFileArgument(argc, argv)};
+    if (!file.Valid()) {
+        std::cout << "Failed to read." << std::endl;
+        return 1;
+    }
+    RouteModel model{std::move(file)};
+    const double load_us = load.ElapsedMicros();
+
+    RouteService service{model, (unsigned)num_clients};
+    const std::string socket_path = "/tmp/bench_server_" + std::to_string(getpid()) + ".sock";
+    RouteServer server{service, socket_path, (unsigned)num_clients};
+    std::string why;
+    if (!server.Listen(&why)) {
+        std::cout << why << std::endl;
+        return 1;
+    }
+    std::thread serving{[&] { server.Serve(); }};
+
+    std::vector<std::vector<double>> latencies(num_clients);
+    std::vector<int> failures(num_clients, 0);
+    Stopwatch total;
+    std::vector<std::thread> clients;
+    for (int c = 0; c < num_clients; ++c)
+        clients.emplace_back([&, c] {
+            RouteClient client;
+            if (!client.Connect(socket_path)) {
+                failures[c] = num_requests;
+                return;
+            }
+            std::mt19937 rng{(unsigned)c + 1};
+            std::uniform_real_distribution<float> coordinate(0.f, 100.f);
+            for (int r = 0; r < num_requests; ++r) {
+                std::ostringstream request;
+                request << "{\"op\":\"route\",\"start\":[" << coordinate(rng) << "," << coordinate(rng) << "],\"end\":["
+                        << coordinate(rng) << "," << coordinate(rng) << "]}";
+                Stopwatch timer;
+                const std::string response = client.Request(request.str());
+                latencies[c].push_back(timer.ElapsedMicros());
+                failures[c] += response.find("\"status\"") == std::string::npos;
+            }
+        });
+    for (auto &client : clients)
+        client.join();
+    const double total_us = total.ElapsedMicros();
+    server.Stop();
+    serving.join();
+
+    std::vector<double> all;
+    int failed = 0;
+    for (int c = 0; c < num_clients; ++c) {
+        all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+        failed += failures[c];
+    }
+    std::sort(all.begin(), all.end());
+
+    std::cout << "Map load:        " << load_us / 1000. << " ms (paid per request when spawning a process)\n"
+              << "Requests:        " << all.size() << " from " << num_clients << " clients, " << failed << " failed\n"
+              << "Throughput:      " << all.size() / (total_us / 1e6) << " requests/s\n"
+              << "Client latency:  p50 " << Percentile(all, 50) << " us, p99 " << Percentile(all, 99) << " us\n"
+              << "Server-side:\n";
+    server.WriteLatencyReport(std::cout);
+    return 0;
+}
@@ -0,0 +1,70 @@
+// Compares snapping query points with the segment R-tree against the linear
+// nearest-vertex scan in RouteModel::FindClosestNode.
+//
+// Usage: bench_snap [-f map.osm] [-n queries]
+
+#include <cmath>
+#include <random>
+#include <thread>
+#include "bench_common.h"
+#include "../src/route_model.h"
+#include "../src/segment_rtree.h"
+
+int main(int argc, const char **argv)
+{
+    int num_queries = 100000;
+    for (int i = 1; i + 1 < argc; ++i)
+        if (std::string_view{argv[i]} == "-n")
+            num_queries = std::stoi(argv[i + 1]);
+
+    MappedFile file{MapFileArgument(argc, argv)};
+    if (!file.Valid()) {
+        std::cout << "Failed to read." << std::endl;
+        return 1;
+    }
+    RouteModel model{std::move(file)};
+    const RouteGraph &graph = model.Graph();
+
+    Stopwatch serial_build;
+    SegmentRTree serial{graph, 1};
+    const double serial_us = serial_build.ElapsedMicros();
+    Stopwatch parallel_build;
+    SegmentRTree tree{graph};
+    const double parallel_us = parallel_build.ElapsedMicros();
+
+    std::mt19937 rng{7};
+    std::uniform_real_distribution<double> coordinate(0., 1.);
+    std::vector<std::pair<double, double>> points(num_queries);
+    for (auto &point : points)
+        point = {coordinate(rng), coordinate(rng)};
+
+    double snap_distance = 0.;
+    Stopwatch tree_timer;
+    for (const auto &[x, y] : points)
+        snap_distance += tree.Nearest(x, y).distance;
+    const double tree_us = tree_timer.ElapsedMicros();
+
+    // The linear scan is slow; time it on a sample.
+    const int scanned = std::min(num_queries, 1000);
+    double vertex_distance = 0.;
+    Stopwatch scan_timer;
+    for (int i = 0; i < scanned; ++i) {
+        const auto &node = model.FindClosestNode(points[i].first, points[i].second);
+        vertex_distance += std::hypot(node.x - points[i].first, node.y - points[i].second);
+    }
+    const double scan_us = scan_timer.ElapsedMicros();
+    double sample_snap_distance = 0.;
+    for (int i = 0; i < scanned; ++i)
+        sample_snap_distance += tree.Nearest(points[i].first, points[i].second).distance;
+
+    const double scale = model.MetricScale();
+    std::cout << "Segments:             " << tree.NumSegments() << " (tree height " << tree.Height() << ")\n";
+    std::cout << "Build, 1 thread:      " << serial_us / 1000. << " ms\n";
+    std::cout << "Build, " << std::thread::hardware_concurrency() << " threads:     " << parallel_us / 1000. << " ms\n";
+    std::cout << "R-tree snap:          " << tree_us / num_queries << " us/query, mean offset "
+              << snap_distance / num_queries * scale << " m\n";
+    std::cout << "Nearest vertex scan:  " << scan_us / scanned << " us/query, mean offset "
+              << vertex_distance / scanned * scale << " m (R-tree on the same points: "
+              << sample_snap_distance / scanned * scale << " m)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,75 @@
+// Splits the map into on-disk tiles and runs queries that load tiles on demand,
+// comparing resident memory and query time against the fully loaded graph.
+//
+// Usage: bench_tiles [-f map.osm] [-d tile_dir] [-g grid] [-b budget_kb] [-n queries]
+
+#include <cmath>
+#include <random>
+#include "bench_common.h"
+#include "../src/graph_search.h"
+#include "../src/route_model.h"
+#include "../src/tiled_graph.h"
+
+int main(int argc, const char **argv)
+{
+    std::string directory = ".";
+    int grid = 16, num_queries = 500;
+    size_t budget_kb = 64;
+    for (int i = 1; i + 1 < argc; ++i) {
+        auto arg = std::string_view{argv[i]};
+        if (arg == "-d")
+            directory = argv[i + 1];
+        else if (arg == "-g")
+            grid = std::stoi(argv[i + 1]);
+        else if (arg == "-b")
+            budget_kb = std::stoul(argv[i + 1]);
+        else if (arg == "-n")
+            num_queries = std::stoi(argv[i + 1]);
+    }
+
+    MappedFile file{MapFileArgument(argc, argv)};
+    if (!file.Valid()) {
+        std::cout << "Failed to read." << std::endl;
+        return 1;
+    }
+    RouteModel model{std::move(file)};
+    RouteGraph graph{model};
+    if (!TiledGraph::Write(graph, directory, grid)) {
+        std::cout << "Failed to write tiles to " << directory << std::endl;
+        return 1;
+    }
+    size_t graph_bytes = graph.NumNodes() * (sizeof(int) + sizeof(Model::Node)) + graph.NumArcs() * (3 * sizeof(int) + 2 * sizeof(float));
+
+    TiledGraph tiles{directory, budget_kb * 1024};
+    SearchWorkspace workspace;
+    std::mt19937 rng{3};
+    std::uniform_int_distribution<size_t> pick(0, model.Nodes().size() - 1);
+    double tiled_us = 0., full_us = 0.;
+    int measured = 0, mismatches = 0;
+    for (int q = 0; q < num_queries; ++q) {
+        const auto &from = model.Nodes()[pick(rng)];
+        const auto &to = model.Nodes()[pick(rng)];
+        Stopwatch tiled_timer;
+        RoutePath path = tiles.ShortestPath(from.x, from.y, to.x, to.y);
+        tiled_us += tiled_timer.ElapsedMicros();
+        if (path.empty())
+            continue;
+
+        Stopwatch full_timer;
+        SearchResult expected = AStar(graph, workspace, {{path.nodes.front(), 0.f}}, {{path.nodes.back(), 0.f}});
+        full_us += full_timer.ElapsedMicros();
+        if (std::abs(expected.cost * graph.MetricScale() - path.Length()) > 0.05f)
+            mismatches++;
+        measured++;
+    }
+
+    std::cout << "Tiles:                " << grid << "x" << grid << ", budget " << budget_kb << " KB\n";
+    std::cout << "In-memory graph:      " << graph_bytes / 1024 << " KB\n";
+    std::cout << "Peak resident tiles:  " << tiles.PeakBytes() / 1024 << " KB\n";
+    std::cout << "Tile loads:           " << tiles.TilesLoaded() << " (" << tiles.Evictions() << " evictions)\n";
+    std::cout << "Queries measured:     " << measured << "\n";
+    std::cout << "Tiled query:          " << tiled_us / num_queries << " us (including nearest node and tile loads)\n";
+    std::cout << "In-memory A*:         " << full_us / std::max(measured, 1) << " us\n";
+    std::cout << "Distance mismatches:  " << mismatches << std::endl;
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+#include "alternative_routes.h"
+#include <algorithm>
+#include <unordered_set>
+#include "graph_search.h"
+
+std::vector<AlternativeRoute> AlternativeRoutes(const RouteGraph &graph, int source, int target,
+                                                const AlternativeOptions &options)
+{
+    static thread_local SearchWorkspace forward, backward, check;
+    std::vector<AlternativeRoute> routes;
+
+    const SearchResult shortest = AStar(graph, forward, {{source, 0.f}}, {{target, 0.f}});
+    if (!shortest.Found())
+        return routes;
+    const float optimal = shortest.cost;
+    const float bound = optimal * options.max_stretch;
+    BoundedDijkstra(graph, forward, {{source, 0.f}}, bound);
+    BoundedDijkstra(graph, backward, {{target, 0.f}}, bound, true);
+
+    // Arcs of a route through `via`: the forward tree to it, the backward tree from it.
+    auto route_arcs = [&](int via) {
+        std::vector<int> arcs = ArcPath(graph, forward, via);
+        for (int node = via; backward.ParentArc(node) >= 0; node = graph.Head(backward.ParentArc(node)))
+            arcs.push_back(backward.ParentArc(node));
+        return arcs;
+    };
+    auto to_path = [&](const std::vector<int> &arcs) {
+        RoutePath path;
+        float distance = 0.f;
+        path.nodes.push_back(source);
+        path.distances.push_back(0.f);
+        for (int arc : arcs) {
+            distance += graph.Length(arc);
+            path.nodes.push_back(graph.Head(arc));
+            path.distances.push_back(distance * (float)graph.MetricScale());
+        }
+        return path;
+    };
+    // Undirected edge id, so driving a segment in either direction counts as sharing it.
+    auto edge = [&](int arc) { return std::min(arc, graph.ReverseArc(arc)); };
+
+    std::unordered_set<int> chosen_edges;
+    std::unordered_set<int> chosen_nodes;
+    auto accept = [&](std::vector<int> arcs, float cost, int via) {
+        for (int arc : arcs)
+            chosen_edges.insert(edge(arc));
+        RoutePath path = to_path(arcs);
+        chosen_nodes.insert(path.nodes.begin(), path.nodes.end());
+        routes.push_back({std::move(path), cost, via});
+    };
+    accept(route_arcs(target), forward.G(target), -1);
+
+    // Plateaus are stretches that both trees share; all via nodes on one plateau
+    // give the same route, so only its first node is a candidate. Long plateaus
+    // make good alternatives, so candidates are ranked by cost minus plateau length.
+    auto in_both_trees = [&](int arc) { return arc >= 0 && forward.ParentArc(graph.Head(arc)) == arc; };
+    struct Candidate {
+        int via;
+        float rank;
+    };
+    std::vector<Candidate> candidates;
+    for (int node = 0; node < graph.NumNodes(); ++node) {
+        if (!forward.Reached(node) || !backward.Reached(node) || forward.G(node) + backward.G(node) > bound ||
+            chosen_nodes.count(node))
+            continue;
+        const int in = forward.ParentArc(node);
+        if (in >= 0 && backward.ParentArc(graph.Head(graph.ReverseArc(in))) == in)
+            continue; // not the first node of its plateau
+        float plateau = 0.f;
+        for (int arc = backward.ParentArc(node); in_both_trees(arc); arc = backward.ParentArc(graph.Head(arc)))
+            plateau += graph.Cost(arc);
+        if (plateau > 0.f)
+            candidates.push_back({node, forward.G(node) + backward.G(node) - plateau});
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) { return a.rank < b.rank; });
+    if ((int)candidates.size() > options.max_candidates)
+        candidates.resize(options.max_candidates);
+
+    std::vector<int> seen(graph.NumNodes(), -1);
+    for (const auto &[via, rank] : candidates) {
+        if ((int)routes.size() > options.max_alternatives)
+            break;
+        if (chosen_nodes.count(via))
+            continue; // lies on a route already taken
+        std::vector<int> arcs = route_arcs(via);
+
+        // Simple: the two halves must not meet before the via node (no U-turns).
+        bool simple = true;
+        seen[source] = via;
+        for (int arc : arcs) {
+            const int head = graph.Head(arc);
+            simple = simple && seen[head] != via;
+            seen[head] = via;
+        }
+        if (!simple)
+            continue;
+
+        // Limited sharing with the routes chosen so far.
+        float shared = 0.f, cost = 0.f;
+        for (int arc : arcs) {
+            cost += graph.Cost(arc);
+            if (chosen_edges.count(edge(arc)))
+                shared += graph.Cost(arc);
+        }
+        if (shared > options.max_sharing * optimal || cost > bound)
+            continue;
+
+        // Local optimality: the stretch of length ~T on both sides of the via node
+        // must not be improvable by a shortest path between its ends.
+        const float window = options.local_optimality * optimal;
+        const float at_via = forward.G(via);
+        int u = source, w = target;
+        float cost_u = 0.f, cost_w = cost, along = 0.f;
+        for (int arc : arcs) {
+            along += graph.Cost(arc);
+            if (along <= at_via - window) {
+                u = graph.Head(arc);
+                cost_u = along;
+            }
+            if (along >= at_via + window) {
+                w = graph.Head(arc);
+                cost_w = along;
+                break;
+            }
+        }
+        const SearchResult direct = AStar(graph, check, {{u, 0.f}}, {{w, 0.f}});
+        if (direct.cost < (cost_w - cost_u) * (1.f - 1e-5f))
+            continue;
+
+        accept(std::move(arcs), cost, via);
+    }
+    return routes;
+}
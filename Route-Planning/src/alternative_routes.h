@@ -0,0 +1,40 @@
+#ifndef ALTERNATIVE_ROUTES_H
+#define ALTERNATIVE_ROUTES_H
+
+#include <vector>
+#include "route_graph.h"
+#include "route_path.h"
+
+struct AlternativeOptions {
+    int max_alternatives = 2;
+    // Alternatives may be at most this factor longer than the shortest route.
+    float max_stretch = 1.3f;
+    // At most this fraction of an alternative may overlap routes already chosen.
+    float max_sharing = 0.7f;
+    // Every stretch of this fraction of the shortest route's length around the
+    // via node must itself be a shortest path, which rules out detours.
+    float local_optimality = 0.2f;
+    // Via node candidates examined, best ranked first.
+    int max_candidates = 100;
+};
+
+struct AlternativeRoute {
+    RoutePath path;
+    float cost;  // map units
+    int via;     // graph node the route was built through; -1 for the shortest route
+};
+
+// Via-node alternatives (Abraham et al., "Alternative routes in road networks").
+// One forward shortest-path tree from the source and one backward tree to the
+// target are grown to max_stretch times the shortest distance; a node both
+// trees reach defines a route source -> via -> target. Via nodes are taken one
+// per plateau (a path the two trees share) and ranked by route cost minus
+// plateau length. Candidates are accepted if they are simple, share little with
+// the routes chosen so far and are locally optimal around the via node.
+//
+// Returns the shortest route first, followed by up to max_alternatives
+// alternatives; empty when the target is unreachable.
+std::vector<AlternativeRoute> AlternativeRoutes(const RouteGraph &graph, int source, int target,
+                                                const AlternativeOptions &options = {});
+
+#endif
@@ -0,0 +1,117 @@
+#include "anytime_search.h"
+#include <algorithm>
+#include <functional>
+
+static constexpr float kInfinity = std::numeric_limits<float>::infinity();
+
+namespace {
+enum NodeState : unsigned char { kUnseen, kOpen, kClosed, kInconsistent };
+}
+
+std::vector<AnytimeSolution> AnytimeAStar(const RouteGraph &graph, SearchWorkspace &workspace, int source, int target,
+                                          std::chrono::steady_clock::time_point deadline,
+                                          float initial_epsilon, float epsilon_step)
+{
+    using Clock = std::chrono::steady_clock;
+    const auto started = Clock::now();
+    std::vector<AnytimeSolution> solutions;
+    workspace.Prepare(graph.NumNodes());
+    auto &heap = workspace.Heap();
+    std::vector<unsigned char> state(graph.NumNodes(), kUnseen);
+    std::vector<int> inconsistent;
+    long expanded = 0;
+    float epsilon = std::max(initial_epsilon, 1.f);
+
+    auto h_value = [&](int node) { return graph.Distance(node, target); };
+    auto push = [&](int node) {
+        state[node] = kOpen;
+        heap.push_back({workspace.G(node) + epsilon * h_value(node), workspace.G(node), node});
+        std::push_heap(heap.begin(), heap.end(), std::greater<SearchWorkspace::HeapEntry>());
+    };
+    auto pop_stale = [&] {
+        while (!heap.empty() && (state[heap.front().node] != kOpen || heap.front().g > workspace.G(heap.front().node))) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<SearchWorkspace::HeapEntry>());
+            heap.pop_back();
+        }
+    };
+
+    // Expands until the target's g is within epsilon of the best open key.
+    // Returns false if the deadline interrupted a refinement.
+    auto improve_path = [&](bool must_finish) {
+        for (;;) {
+            pop_stale();
+            if (heap.empty() || workspace.G(target) <= heap.front().key)
+                return true;
+            if (!must_finish && (expanded & 255) == 0 && Clock::now() >= deadline)
+                return false;
+            const auto top = heap.front();
+            std::pop_heap(heap.begin(), heap.end(), std::greater<SearchWorkspace::HeapEntry>());
+            heap.pop_back();
+            state[top.node] = kClosed;
+            expanded++;
+
+            for (int arc = graph.FirstArc(top.node); arc < graph.LastArc(top.node); ++arc) {
+                const float cost = graph.Cost(arc);
+                if (cost == kInfinity)
+                    continue;
+                const int head = graph.Head(arc);
+                const float g = top.g + cost;
+                if (g >= workspace.G(head))
+                    continue;
+                workspace.Relax(head, g, arc, 0);
+                if (state[head] == kClosed) {
+                    // Closed nodes are not re-expanded within an iteration; they
+                    // are revisited once epsilon has been lowered.
+                    state[head] = kInconsistent;
+                    inconsistent.push_back(head);
+                }
+                else if (state[head] != kInconsistent)
+                    push(head);
+            }
+        }
+    };
+
+    // Lowest unweighted f over all nodes that may still improve the route.
+    auto lower_bound = [&] {
+        float best = kInfinity;
+        for (const auto &entry : heap)
+            if (state[entry.node] == kOpen && entry.g <= workspace.G(entry.node))
+                best = std::min(best, entry.g + h_value(entry.node));
+        for (int node : inconsistent)
+            best = std::min(best, workspace.G(node) + h_value(node));
+        return best;
+    };
+
+    workspace.Relax(source, 0.f, -1, 0);
+    push(source);
+    for (bool first = true;; first = false) {
+        if (!improve_path(first) || !workspace.Reached(target))
+            break;
+
+        const float cost = workspace.G(target);
+        const float bound = std::max(1.f, std::min(epsilon, cost / lower_bound()));
+        const double elapsed = std::chrono::duration<double, std::micro>(Clock::now() - started).count();
+        solutions.push_back({cost, epsilon, bound, elapsed, expanded, ExtractPath(graph, workspace, target)});
+        if (bound <= 1.f || Clock::now() >= deadline)
+            break;
+
+        // Lower epsilon and move the inconsistent nodes back into the rebuilt open list.
+        epsilon = std::max(1.f, std::min(epsilon - epsilon_step, bound));
+        std::vector<int> open;
+        for (const auto &entry : heap)
+            if (state[entry.node] == kOpen && entry.g <= workspace.G(entry.node)) {
+                open.push_back(entry.node);
+                state[entry.node] = kUnseen;
+            }
+        heap.clear();
+        for (int node : open)
+            push(node);
+        for (int node : inconsistent)
+            push(node);
+        inconsistent.clear();
+        for (int node = 0; node < graph.NumNodes(); ++node)
+            if (state[node] == kClosed)
+                state[node] = kUnseen;
+    }
+    return solutions;
+}
@@ -0,0 +1,28 @@
+#ifndef ANYTIME_SEARCH_H
+#define ANYTIME_SEARCH_H
+
+#include <chrono>
+#include <vector>
+#include "graph_search.h"
+
+// One solution published by AnytimeAStar. `bound` is the proven suboptimality
+// bound: cost <= bound * optimal cost.
+struct AnytimeSolution {
+    float cost;          // map units
+    float epsilon;       // heuristic inflation used for this iteration
+    float bound;
+    double elapsed_us;   // since the search started
+    long expanded;       // cumulative expansions
+    RoutePath path;
+};
+
+// ARA* (Likhachev, Gordon & Thrun): a weighted A* with an inflated heuristic
+// returns a first route quickly, then epsilon is lowered step by step, reusing
+// the previous search effort, until the bound reaches 1 or the deadline passes.
+// The first solution is always completed; later iterations are abandoned when
+// the deadline passes. Solutions are returned in the order they were found.
+std::vector<AnytimeSolution> AnytimeAStar(const RouteGraph &graph, SearchWorkspace &workspace, int source, int target,
+                                          std::chrono::steady_clock::time_point deadline,
+                                          float initial_epsilon = 3.f, float epsilon_step = 0.5f);
+
+#endif
@@ -0,0 +1,100 @@
+#include "batch.h"
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include "route_planner.h"
+
+static bool ParseRow(const std::string &line, float (&values)[4])
+{
+    std::istringstream row{line};
+    std::string field;
+    int count = 0;
+    while (std::getline(row, field, ',')) {
+        if (count == 4)
+            return false;
+        try {
+            size_t used = 0;
+            values[count++] = std::stof(field, &used);
+            if (field.find_first_not_of(" \t\r", used) != std::string::npos)
+                return false;
+        } catch (const std::exception &) {
+            return false;
+        }
+    }
+    return count == 4;
+}
+
+std::vector<BatchQuery> ReadBatchQueries(std::istream &is, const Model &model, BatchFormat format, std::ostream &errors)
+{
+    std::vector<BatchQuery> queries;
+    std::string line;
+    for (int line_number = 1; std::getline(is, line); ++line_number) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos || line[0] == '#')
+            continue;
+
+        float values[4];
+        if (!ParseRow(line, values)) {
+            if (queries.empty() && line_number == 1)
+                continue; // header
+            errors << "line " << line_number << ": expected four comma separated numbers\n";
+            continue;
+        }
+
+        if (format == BatchFormat::LatLon) {
+            // Convert to the percentage space expected by RoutePlanner. The longer side of
+            // the map extends past 100%, so coordinates are not range checked here.
+            auto start = model.Project(values[0], values[1]);
+            auto end = model.Project(values[2], values[3]);
+            values[0] = (float)start.x * 100.f;
+            values[1] = (float)start.y * 100.f;
+            values[2] = (float)end.x * 100.f;
+            values[3] = (float)end.y * 100.f;
+        }
+        else {
+            bool in_range = true;
+            for (float value : values)
+                in_range = in_range && value >= 0.f && value <= 100.f;
+            if (!in_range) {
+                errors << "line " << line_number << ": values must be between 0 and 100\n";
+                continue;
+            }
+        }
+        queries.push_back({values[0], values[1], values[2], values[3]});
+    }
+    return queries;
+}
+
+SearchStatsAggregate RunBatch(RouteModel &model, const std::vector<BatchQuery> &queries,
+                              std::ostream &out, std::ostream *json_lines, const BatchSearch &search)
+{
+    SearchStatsAggregate aggregate;
+    out << "query,start_x,start_y,end_x,end_y,distance,path_nodes,nodes_expanded,find_closest_us,search_us,path_us,bound\n";
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const auto &query = queries[i];
+        model.ResetSearchState();
+        RoutePlanner route_planner{model, query.start_x, query.start_y, query.end_x, query.end_y};
+        if (search.anytime_us > 0.) {
+            // --epsilon sets the initial inflation; otherwise ARA*'s default applies.
+            const std::chrono::microseconds budget{(long long)search.anytime_us};
+            if (search.weight > 1.f)
+                route_planner.AnytimeSearch(budget, search.weight);
+            else
+                route_planner.AnytimeSearch(budget);
+        }
+        else {
+            route_planner.SetHeuristicWeight(search.weight);
+            if (search.landmarks)
+                route_planner.SetLandmarks(*search.landmarks);
+            route_planner.AStarSearch();
+        }
+
+        const SearchStats &stats = route_planner.GetStats();
+        out << i << ',' << query.start_x << ',' << query.start_y << ',' << query.end_x << ',' << query.end_y << ','
+            << stats.distance << ',' << stats.path_nodes << ',' << stats.nodes_expanded << ','
+            << stats.find_closest_us << ',' << stats.search_us << ',' << stats.path_us << ',' << stats.suboptimality_bound << '\n';
+        if (json_lines)
+            stats.WriteJsonLine(*json_lines);
+        aggregate.Add(stats);
+    }
+    return aggregate;
+}
@@ -0,0 +1,44 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <istream>
+#include <ostream>
+#include <vector>
+#include "landmarks.h"
+#include "route_model.h"
+#include "search_stats.h"
+
+// Non-interactive query runner used by `OSM_A_star_search --batch`.
+//
+// Input is CSV with one query per line: `start_x,start_y,end_x,end_y` as
+// percentages of the map (the same values the interactive prompt accepts), or
+// `start_lat,start_lon,end_lat,end_lon` when reading coordinates. Blank lines,
+// lines starting with '#' and a non-numeric header line are ignored.
+struct BatchQuery {
+    float start_x;
+    float start_y;
+    float end_x;
+    float end_y;
+};
+
+enum class BatchFormat { Percent, LatLon };
+
+// Search mode for every query of a batch: plain A* by default, weighted A*
+// when `weight` > 1, or ARA* refining for at most `anytime_us` when that is set.
+// With `landmarks`, plain and weighted A* route on the graph guided by them.
+struct BatchSearch {
+    float weight = 1.f;
+    double anytime_us = 0.;
+    const Landmarks *landmarks = nullptr;
+};
+
+// Parses queries, reporting malformed or out-of-range lines to `errors`.
+std::vector<BatchQuery> ReadBatchQueries(std::istream &is, const Model &model, BatchFormat format, std::ostream &errors);
+
+// Runs every query on `model` and writes one CSV result row per query to `out`.
+// When `json_lines` is set, per-query SearchStats are also written there.
+SearchStatsAggregate RunBatch(RouteModel &model, const std::vector<BatchQuery> &queries,
+                              std::ostream &out, std::ostream *json_lines = nullptr,
+                              const BatchSearch &search = {});
+
+#endif
@@ -0,0 +1,239 @@
+#include "chain_graph.h"
+#include <algorithm>
+#include <map>
+
+static constexpr float kInfinity = std::numeric_limits<float>::infinity();
+
+ChainGraph::ChainGraph(const RouteGraph &base) : m_Base(base)
+{
+    ShareCoordinates(base);
+    const int num_nodes = base.NumNodes();
+
+    std::vector<bool> kept(num_nodes);
+    for (int node = 0; node < num_nodes; ++node)
+        kept[node] = base.Degree(node) != 2;
+    auto chains = CollectChains(kept);
+
+    // Loops and parallel chains between the same two junctions would collapse into
+    // one arc, so split them by keeping one or two of their shape points.
+    std::map<std::pair<int, int>, std::vector<int>> by_ends;
+    for (int i = 0; i < (int)chains.size(); ++i) {
+        const auto &chain = chains[i];
+        if (chain.tail == chain.head) {
+            kept[m_Interior[chain.first]] = true;
+            kept[m_Interior[chain.first + chain.count - 1]] = true;
+        }
+        else
+            by_ends[std::minmax(chain.tail, chain.head)].push_back(i);
+    }
+    for (const auto &[ends, group] : by_ends)
+        if (group.size() > 1)
+            for (int i : group)
+                if (chains[i].count > 0)
+                    kept[m_Interior[chains[i].first + chains[i].count / 2]] = true;
+    Init(kept);
+}
+
+ChainGraph::ChainGraph(const RouteGraph &base, std::vector<bool> kept) : m_Base(base)
+{
+    ShareCoordinates(base);
+    Init(kept);
+}
+
+std::vector<bool> ChainGraph::KeptNodes() const
+{
+    std::vector<bool> kept(m_NodeChain.size());
+    for (size_t node = 0; node < kept.size(); ++node)
+        kept[node] = m_NodeChain[node] < 0;
+    return kept;
+}
+
+void ChainGraph::Init(std::vector<bool> &kept)
+{
+    const RouteGraph &base = m_Base;
+    const int num_nodes = base.NumNodes();
+    m_Chains = CollectChains(kept);
+
+    m_NodeChain.assign(num_nodes, -1);
+    m_NodePosition.assign(num_nodes, -1);
+    std::vector<Segment> segments;
+    for (int c = 0; c < (int)m_Chains.size(); ++c) {
+        const auto &chain = m_Chains[c];
+        float length = 0.f;
+        for (int p = -1; p < chain.count; ++p)
+            length += base.Distance(ChainNode(chain, p), ChainNode(chain, p + 1));
+        segments.push_back({chain.tail, chain.head, length});
+        for (int p = 0; p < chain.count; ++p) {
+            m_NodeChain[m_Interior[chain.first + p]] = c;
+            m_NodePosition[m_Interior[chain.first + p]] = p;
+        }
+    }
+    for (int node = 0; node < num_nodes; ++node)
+        m_NumKept += kept[node] && base.Degree(node) > 0;
+
+    Build(num_nodes, segments);
+
+    m_ArcChain.assign(NumArcs(), -1);
+    for (int c = 0; c < (int)m_Chains.size(); ++c) {
+        auto &chain = m_Chains[c];
+        chain.arc = FindArc(chain.tail, chain.head);
+        const int reverse = ReverseArc(chain.arc);
+        m_ArcChain[chain.arc] = m_ArcChain[reverse] = c;
+        m_Costs[chain.arc] = ChainCost(chain, -1, chain.count);
+        m_Costs[reverse] = ChainCost(chain, chain.count, -1);
+    }
+    m_BaseCosts = m_Costs;
+}
+
+std::vector<ChainGraph::Chain> ChainGraph::CollectChains(std::vector<bool> &kept)
+{
+    const RouteGraph &base = m_Base;
+    auto &interior = m_Interior;
+    interior.clear();
+
+    std::vector<Chain> chains;
+    std::vector<bool> visited(base.NumNodes(), false);
+    auto walk = [&](int tail, int arc) {
+        Chain chain{tail, -1, (int)interior.size(), 0, -1};
+        int prev = tail, node = base.Head(arc);
+        while (!kept[node] && !visited[node]) {
+            visited[node] = true;
+            interior.push_back(node);
+            chain.count++;
+            const int first = base.FirstArc(node);
+            const int next = base.Head(first) == prev ? base.Head(first + 1) : base.Head(first);
+            prev = node;
+            node = next;
+        }
+        chain.head = node;
+        chains.push_back(chain);
+    };
+
+    for (int node = 0; node < base.NumNodes(); ++node) {
+        if (!kept[node])
+            continue;
+        for (int arc = base.FirstArc(node); arc < base.LastArc(node); ++arc) {
+            const int head = base.Head(arc);
+            // Each chain is walked once: from its first interior node, or from the lower end of a direct segment.
+            if (kept[head] ? head > node : !visited[head])
+                walk(node, arc);
+        }
+    }
+    // Rings made only of degree-2 nodes have no junction to start from. Keep one of their
+    // nodes so the ring is reported as a loop, which the caller then splits.
+    for (int node = 0; node < base.NumNodes(); ++node)
+        if (!kept[node] && !visited[node] && base.Degree(node) == 2) {
+            kept[node] = true;
+            walk(node, base.FirstArc(node));
+        }
+    return chains;
+}
+
+int ChainGraph::ChainNode(const Chain &chain, int position) const
+{
+    if (position < 0)
+        return chain.tail;
+    if (position >= chain.count)
+        return chain.head;
+    return m_Interior[chain.first + position];
+}
+
+float ChainGraph::ChainCost(const Chain &chain, int from, int to) const
+{
+    const int step = from < to ? 1 : -1;
+    float cost = 0.f;
+    for (int p = from; p != to; p += step)
+        cost += m_Base.Cost(m_Base.FindArc(ChainNode(chain, p), ChainNode(chain, p + step)));
+    return cost;
+}
+
+void ChainGraph::AppendChainNodes(const Chain &chain, int from, int to, std::vector<int> &out) const
+{
+    const int step = from < to ? 1 : -1;
+    for (int p = from; p != to;) {
+        p += step;
+        out.push_back(ChainNode(chain, p));
+    }
+}
+
+void ChainGraph::AppendGeometry(int arc, std::vector<int> &out) const
+{
+    const auto &chain = m_Chains[m_ArcChain[arc]];
+    if (Head(arc) == chain.head)
+        out.insert(out.end(), m_Interior.begin() + chain.first, m_Interior.begin() + chain.first + chain.count);
+    else
+        out.insert(out.end(), m_Interior.rbegin() + (m_Interior.size() - chain.first - chain.count),
+                   m_Interior.rbegin() + (m_Interior.size() - chain.first));
+}
+
+RoutePath ChainGraph::ShortestPath(SearchWorkspace &workspace, int source, int target, SearchResult *result) const
+{
+    RoutePath path;
+    SearchResult search;
+    std::vector<SearchSeed> sources, targets;
+    auto attach = [&](int node, bool is_source, std::vector<SearchSeed> &seeds) {
+        if (IsKept(node)) {
+            seeds.push_back({node, 0.f});
+            return;
+        }
+        const auto &chain = m_Chains[m_NodeChain[node]];
+        const int p = m_NodePosition[node];
+        const float to_tail = is_source ? ChainCost(chain, p, -1) : ChainCost(chain, -1, p);
+        const float to_head = is_source ? ChainCost(chain, p, chain.count) : ChainCost(chain, chain.count, p);
+        if (to_tail < kInfinity)
+            seeds.push_back({chain.tail, to_tail});
+        if (to_head < kInfinity)
+            seeds.push_back({chain.head, to_head});
+    };
+
+    if (source == target) {
+        search.cost = 0.f;
+        search.target = 0;
+        path.nodes.push_back(source);
+    }
+    else {
+        attach(source, true, sources);
+        attach(target, false, targets);
+        search = AStar(*this, workspace, sources, targets);
+
+        // Both ends on the same chain: the direct stretch may beat leaving the chain.
+        float direct = kInfinity;
+        const bool same_chain = !IsKept(source) && m_NodeChain[source] == m_NodeChain[target];
+        if (same_chain)
+            direct = ChainCost(m_Chains[m_NodeChain[source]], m_NodePosition[source], m_NodePosition[target]);
+
+        if (direct < kInfinity && direct <= search.cost) {
+            search.cost = direct;
+            search.target = 0;
+            path.nodes.push_back(source);
+            AppendChainNodes(m_Chains[m_NodeChain[source]], m_NodePosition[source], m_NodePosition[target], path.nodes);
+        }
+        else if (search.Found()) {
+            const int last = targets[search.target].node;
+            const int first = sources[workspace.Source(last)].node;
+            path.nodes.push_back(source);
+            if (!IsKept(source)) {
+                const auto &chain = m_Chains[m_NodeChain[source]];
+                AppendChainNodes(chain, m_NodePosition[source], first == chain.tail ? -1 : chain.count, path.nodes);
+            }
+            for (int arc : ArcPath(*this, workspace, last)) {
+                AppendGeometry(arc, path.nodes);
+                path.nodes.push_back(Head(arc));
+            }
+            if (!IsKept(target)) {
+                const auto &chain = m_Chains[m_NodeChain[target]];
+                AppendChainNodes(chain, last == chain.tail ? -1 : chain.count, m_NodePosition[target], path.nodes);
+            }
+        }
+    }
+
+    float distance = 0.f;
+    for (size_t i = 0; i < path.nodes.size(); ++i) {
+        if (i > 0)
+            distance += m_Base.Distance(path.nodes[i - 1], path.nodes[i]);
+        path.distances.push_back(distance * (float)m_MetricScale);
+    }
+    if (result)
+        *result = search;
+    return path;
+}
@@ -0,0 +1,61 @@
+#ifndef CHAIN_GRAPH_H
+#define CHAIN_GRAPH_H
+
+#include <vector>
+#include "graph_search.h"
+#include "route_graph.h"
+
+// RouteGraph with degree-2 chains collapsed into single arcs. Only junctions
+// and dead ends (degree != 2) keep arcs; the shape points in between are kept
+// as per-arc geometry so routes can be unpacked to full detail. Node ids stay
+// Model node indices, so coordinates and heuristics are shared with the base.
+//
+// Arc costs are the sums of the base costs at construction time; rebuild the
+// compressed graph after changing edge costs on the base graph.
+class ChainGraph : public RouteGraph {
+  public:
+    explicit ChainGraph(const RouteGraph &base);
+    // Rebuilds a compressed graph from the kept nodes of an earlier one (see
+    // KeptNodes()), skipping the selection of which nodes to keep.
+    ChainGraph(const RouteGraph &base, std::vector<bool> kept);
+
+    const RouteGraph &Base() const { return m_Base; }
+    bool IsKept(int node) const { return m_NodeChain[node] < 0; }
+    int NumKeptNodes() const { return m_NumKept; }
+    std::vector<bool> KeptNodes() const;
+
+    // Appends the interior nodes of `arc` in travel order, excluding both ends.
+    void AppendGeometry(int arc, std::vector<int> &out) const;
+
+    // Shortest path between two base graph nodes, unpacked to base nodes.
+    // Shape points are valid endpoints; they are attached to both chain ends.
+    RoutePath ShortestPath(SearchWorkspace &workspace, int source, int target, SearchResult *result = nullptr) const;
+
+  private:
+    struct Chain {
+        int tail;
+        int head;
+        int first;  // index of the first interior node in m_Interior
+        int count;  // number of interior nodes
+        int arc;    // compressed arc tail -> head
+    };
+
+    // Builds the chains and compressed arcs once the kept nodes are final.
+    void Init(std::vector<bool> &kept);
+    // Walks every chain between kept nodes; rings without a junction get one of their nodes kept.
+    std::vector<Chain> CollectChains(std::vector<bool> &kept);
+    // Cost of travelling along the chain between two positions (-1 is the tail, count the head).
+    float ChainCost(const Chain &chain, int from, int to) const;
+    int ChainNode(const Chain &chain, int position) const;
+    void AppendChainNodes(const Chain &chain, int from, int to, std::vector<int> &out) const;
+
+    const RouteGraph &m_Base;
+    std::vector<Chain> m_Chains;
+    std::vector<int> m_Interior;
+    std::vector<int> m_NodeChain;    // chain id of an interior node, -1 for kept nodes
+    std::vector<int> m_NodePosition; // position of an interior node within its chain
+    std::vector<int> m_ArcChain;     // chain id for every compressed arc
+    int m_NumKept = 0;
+};
+
+#endif
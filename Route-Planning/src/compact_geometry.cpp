@@ -0,0 +1,81 @@
+#include "compact_geometry.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+static void AppendVarint(std::vector<uint8_t> &bytes, uint32_t value) {
+    while (value >= 0x80) {
+        bytes.push_back(uint8_t(value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back(uint8_t(value));
+}
+
+CompactGeometry::CompactGeometry(const Model &model) : m_MetricScale(model.MetricScale()) {
+    const auto &nodes = model.Nodes();
+    double min_x = std::numeric_limits<double>::max(), min_y = min_x;
+    double max_x = std::numeric_limits<double>::lowest(), max_y = max_x;
+    for (const auto &node : nodes) {
+        min_x = std::min(min_x, node.x);
+        max_x = std::max(max_x, node.x);
+        min_y = std::min(min_y, node.y);
+        max_y = std::max(max_y, node.y);
+    }
+    if (!nodes.empty()) {
+        constexpr double kSteps = std::numeric_limits<uint32_t>::max();
+        m_MinX = min_x;
+        m_MinY = min_y;
+        m_StepX = (max_x - min_x) / kSteps;
+        m_StepY = (max_y - min_y) / kSteps;
+    }
+    m_Fixed.reserve(nodes.size());
+    auto quantize = [](double value, double min, double step) {
+        return step > 0. ? (uint32_t)std::llround((value - min) / step) : 0u;
+    };
+    for (const auto &node : nodes)
+        m_Fixed.push_back({quantize(node.x, m_MinX, m_StepX), quantize(node.y, m_MinY, m_StepY)});
+
+    // Each road is its node count followed by zigzag encoded deltas between ids.
+    m_RoadOffsets.push_back(0);
+    for (const Model::Road &road : model.Roads()) {
+        if (road.type == Model::Road::Type::Footway)
+            continue;
+        const auto &way = model.Ways()[road.way].nodes;
+        AppendVarint(m_RoadBytes, (uint32_t)way.size());
+        int previous = 0;
+        for (int node : way) {
+            const int delta = node - previous;
+            AppendVarint(m_RoadBytes, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+            previous = node;
+        }
+        m_RoadOffsets.push_back((uint32_t)m_RoadBytes.size());
+    }
+    m_Fixed.shrink_to_fit();
+    m_RoadOffsets.shrink_to_fit();
+    m_RoadBytes.shrink_to_fit();
+}
+
+CompactGeometry::WayNodes CompactGeometry::RoadNodes(int road) const {
+    const uint8_t *data = m_RoadBytes.data() + m_RoadOffsets[road];
+    uint32_t count = 0;
+    for (int shift = 0;; shift += 7) {
+        const uint8_t byte = *data++;
+        count |= uint32_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            break;
+    }
+    return {WayIterator{data, count}, count};
+}
+
+size_t CompactGeometry::MemoryBytes() const {
+    return sizeof(*this) + m_Fixed.capacity() * sizeof(Fixed) + m_RoadOffsets.capacity() * sizeof(uint32_t) +
+           m_RoadBytes.capacity();
+}
+
+size_t CompactGeometry::ModelBytes(const Model &model) {
+    size_t bytes = model.Nodes().capacity() * sizeof(Model::Node);
+    for (const Model::Road &road : model.Roads())
+        if (road.type != Model::Road::Type::Footway)
+            bytes += sizeof(Model::Way) + model.Ways()[road.way].nodes.capacity() * sizeof(int);
+    return bytes;
+}
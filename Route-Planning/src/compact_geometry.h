@@ -0,0 +1,97 @@
+#ifndef COMPACT_GEOMETRY_H
+#define COMPACT_GEOMETRY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+#include "model.h"
+
+// Compact copy of the road geometry of a Model, for running searches on large
+// maps without keeping the Model around.
+//
+// Coordinates are stored as 32-bit fixed point over the bounding box of the
+// nodes (well below a millimetre per step on city-sized maps) instead of two
+// doubles. The node lists of road ways are stored as zigzag varint deltas in one
+// byte buffer and decoded on the fly by WayNodes().
+class CompactGeometry {
+  public:
+    // Decodes the node ids of one way while iterating.
+    class WayIterator {
+      public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const int *;
+        using reference = int;
+
+        WayIterator() = default;
+        WayIterator(const uint8_t *data, uint32_t remaining) : m_Data(data), m_Remaining(remaining) { Decode(); }
+        int operator*() const { return m_Node; }
+        WayIterator &operator++() { --m_Remaining; Decode(); return *this; }
+        bool operator==(const WayIterator &other) const { return m_Remaining == other.m_Remaining; }
+        bool operator!=(const WayIterator &other) const { return m_Remaining != other.m_Remaining; }
+
+      private:
+        void Decode() {
+            if (m_Remaining == 0)
+                return;
+            uint32_t value = 0;
+            for (int shift = 0;; shift += 7) {
+                const uint8_t byte = *m_Data++;
+                value |= uint32_t(byte & 0x7f) << shift;
+                if (!(byte & 0x80))
+                    break;
+            }
+            m_Node += (int)(value >> 1) ^ -(int)(value & 1);
+        }
+
+        const uint8_t *m_Data = nullptr;
+        uint32_t m_Remaining = 0;
+        int m_Node = 0;
+    };
+
+    struct WayNodes {
+        WayIterator first;
+        uint32_t count;
+        WayIterator begin() const { return first; }
+        WayIterator end() const { return {}; }
+        uint32_t size() const { return count; }
+    };
+
+    // Only the routable (non-footway) roads are kept.
+    explicit CompactGeometry(const Model &model);
+
+    int NumNodes() const { return (int)m_Fixed.size(); }
+    Model::Node Coord(int node) const {
+        const Fixed &fixed = m_Fixed[node];
+        return {m_MinX + fixed.x * m_StepX, m_MinY + fixed.y * m_StepY};
+    }
+    double MetricScale() const { return m_MetricScale; }
+    // Largest rounding error of a coordinate, in map units.
+    double Precision() const { return std::max(m_StepX, m_StepY) / 2.; }
+
+    int NumRoads() const { return (int)m_RoadOffsets.size() - 1; }
+    WayNodes RoadNodes(int road) const;
+
+    size_t MemoryBytes() const;
+    // Bytes held by the node coordinates and road way lists of `model`, for comparison.
+    static size_t ModelBytes(const Model &model);
+
+  private:
+    struct Fixed {
+        uint32_t x;
+        uint32_t y;
+    };
+
+    std::vector<Fixed> m_Fixed;
+    std::vector<uint32_t> m_RoadOffsets;
+    std::vector<uint8_t> m_RoadBytes;
+    double m_MinX = 0.;
+    double m_MinY = 0.;
+    double m_StepX = 0.;
+    double m_StepY = 0.;
+    double m_MetricScale = 1.;
+};
+
+#endif
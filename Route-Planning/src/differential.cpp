@@ -0,0 +1,141 @@
+#include "differential.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <numeric>
+#include <random>
+#include "search_stats.h"
+
+// Mismatches kept per engine for the report.
+static constexpr size_t kMaxFailures = 5;
+
+static bool SameCost(float cost, float expected, float tolerance)
+{
+    return std::abs(cost - expected) <= tolerance * std::max(expected, 1e-3f);
+}
+
+// Empty when `path` is a route from source to target over graph arcs whose
+// costs add up to `cost`, otherwise what is wrong with it.
+static std::string CheckPath(const RouteGraph &graph, const DifferentialQuery &query, const RoutePath &path,
+                             float cost, float tolerance)
+{
+    if (path.nodes.front() != query.source || path.nodes.back() != query.target)
+        return "route does not join source and target";
+    float sum = 0.f;
+    for (size_t i = 1; i < path.nodes.size(); ++i) {
+        const int arc = graph.FindArc(path.nodes[i - 1], path.nodes[i]);
+        if (arc < 0)
+            return "no arc " + std::to_string(path.nodes[i - 1]) + " -> " + std::to_string(path.nodes[i]);
+        sum += graph.Cost(arc);
+    }
+    if (!SameCost(sum, cost, tolerance))
+        return "route costs " + std::to_string(sum) + ", reported " + std::to_string(cost);
+    return {};
+}
+
+std::vector<DifferentialQuery> RandomQueries(const RouteGraph &graph, int count, unsigned seed)
+{
+    std::vector<int> routable;
+    for (int node = 0; node < graph.NumNodes(); ++node)
+        if (graph.Degree(node) > 0)
+            routable.push_back(node);
+    std::vector<DifferentialQuery> queries;
+    if (routable.empty())
+        return queries;
+
+    std::mt19937 rng{seed};
+    std::uniform_int_distribution<size_t> pick(0, routable.size() - 1);
+    queries.reserve(count);
+    for (int q = 0; q < count; ++q) {
+        const int source = routable[pick(rng)];
+        queries.push_back({source, routable[pick(rng)]});
+    }
+    return queries;
+}
+
+DifferentialReport RunDifferential(const RouteGraph &graph, const std::vector<DifferentialEngine> &engines,
+                                   const std::vector<DifferentialQuery> &queries, float tolerance)
+{
+    DifferentialReport report;
+    for (const auto &engine : engines) {
+        EngineReport &engine_report = report.engines.emplace_back();
+        engine_report.name = engine.name;
+        engine_report.exact = engine.exact;
+        engine_report.micros.reserve(queries.size());
+    }
+
+    // Query-major order, so slow drifts of the machine (clock, cache, other
+    // load) spread over all engines alike.
+    RoutePath path;
+    for (const auto &query : queries) {
+        SearchResult expected;
+        for (size_t e = 0; e < engines.size(); ++e) {
+            EngineReport &engine = report.engines[e];
+            path.clear();
+            const auto start = std::chrono::steady_clock::now();
+            const SearchResult result = engines[e].query(query.source, query.target, path);
+            engine.micros.push_back(
+                std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+            if (e == 0)
+                expected = result;
+            if (result.Found())
+                engine.found++;
+            if (!engine.exact)
+                continue;
+
+            std::string failure;
+            if (e > 0 && result.Found() != expected.Found()) {
+                engine.cost_mismatches++;
+                failure = result.Found() ? "found a route the reference did not" : "found no route";
+            } else if (e > 0 && result.Found() && !SameCost(result.cost, expected.cost, tolerance)) {
+                engine.cost_mismatches++;
+                failure = "cost " + std::to_string(result.cost) + ", reference " + std::to_string(expected.cost);
+            } else if (result.Found() && !path.empty()) {
+                failure = CheckPath(graph, query, path, result.cost, tolerance);
+                if (!failure.empty())
+                    engine.invalid_paths++;
+            }
+            if (!failure.empty() && engine.failures.size() < kMaxFailures)
+                engine.failures.push_back(std::to_string(query.source) + " -> " + std::to_string(query.target) +
+                                          ": " + failure);
+        }
+    }
+    return report;
+}
+
+bool DifferentialReport::Passed() const
+{
+    return std::all_of(engines.begin(), engines.end(),
+                       [](const EngineReport &engine) { return !engine.exact || engine.Failures() == 0; });
+}
+
+void DifferentialReport::Write(std::ostream &os) const
+{
+    double reference_p50 = 0.;
+    for (size_t e = 0; e < engines.size(); ++e) {
+        const EngineReport &engine = engines[e];
+        std::vector<double> sorted = engine.micros;
+        std::sort(sorted.begin(), sorted.end());
+        const double p50 = Percentile(sorted, 50);
+        if (e == 0)
+            reference_p50 = p50;
+        const double mean = sorted.empty() ? 0. : std::accumulate(sorted.begin(), sorted.end(), 0.) / sorted.size();
+        os << std::left << std::setw(18) << engine.name << std::right << std::fixed << std::setprecision(1)
+           << " mean " << std::setw(9) << mean
+           << "  p50 " << std::setw(9) << p50
+           << "  p90 " << std::setw(9) << Percentile(sorted, 90)
+           << "  p99 " << std::setw(9) << Percentile(sorted, 99)
+           << "  max " << std::setw(9) << (sorted.empty() ? 0. : sorted.back()) << " us"
+           << std::setprecision(2) << "  " << std::setw(6) << (p50 > 0. ? reference_p50 / p50 : 0.) << "x";
+        os.unsetf(std::ios::floatfield);
+        os << std::setprecision(6) << "  found " << engine.found << "/" << engine.micros.size();
+        if (!engine.exact)
+            os << "  (not checked)\n";
+        else
+            os << "  cost mismatches " << engine.cost_mismatches << "  invalid routes " << engine.invalid_paths
+               << "\n";
+        for (const auto &failure : engine.failures)
+            os << "    " << failure << "\n";
+    }
+}
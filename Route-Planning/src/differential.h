@@ -0,0 +1,63 @@
+#ifndef DIFFERENTIAL_H
+#define DIFFERENTIAL_H
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "graph_search.h"
+#include "route_graph.h"
+#include "route_path.h"
+
+// Differential check of shortest-path engines: random queries between graph
+// nodes are answered by a reference engine and by every engine under test,
+// their costs are compared and each engine's per-query latency is kept, so an
+// engine cannot get faster by getting wrong without the report showing it.
+
+struct DifferentialQuery {
+    int source;
+    int target;
+};
+
+struct DifferentialEngine {
+    std::string name;
+    // Answers a query between two graph nodes; the cost is in map units of the
+    // graph's arc costs. The route may be left empty if the engine has none.
+    std::function<SearchResult(int source, int target, RoutePath &path)> query;
+    // Engines that do not promise shortest routes (e.g. greedy or weighted
+    // searches) are timed but not checked.
+    bool exact = true;
+};
+
+struct EngineReport {
+    std::string name;
+    bool exact = true;
+    std::vector<double> micros;        // per query, in query order
+    int found = 0;
+    int cost_mismatches = 0;           // found/not found or cost differs from the reference
+    int invalid_paths = 0;             // route not joining source and target over graph arcs at its cost
+    std::vector<std::string> failures; // the first few mismatches, for diagnostics
+
+    int Failures() const { return cost_mismatches + invalid_paths; }
+};
+
+struct DifferentialReport {
+    std::vector<EngineReport> engines; // in the order given, the reference first
+
+    // True when no exact engine disagrees with the reference.
+    bool Passed() const;
+    // One line per engine: latency mean, p50, p90, p99 and max in microseconds,
+    // median speedup over the reference and the failure counts.
+    void Write(std::ostream &os) const;
+};
+
+// `count` queries between uniformly drawn nodes that have arcs.
+std::vector<DifferentialQuery> RandomQueries(const RouteGraph &graph, int count, unsigned seed);
+
+// Runs every query through engines[0] (the reference) and then through each
+// other engine in turn. Costs agree when they differ by at most `tolerance`
+// relative to the reference cost.
+DifferentialReport RunDifferential(const RouteGraph &graph, const std::vector<DifferentialEngine> &engines,
+                                   const std::vector<DifferentialQuery> &queries, float tolerance = 1e-4f);
+
+#endif
@@ -0,0 +1,92 @@
+#include "facilities.h"
+#include <algorithm>
+#include <functional>
+
+static bool CheaperFirst(const FacilityMatch &a, const FacilityMatch &b)
+{
+    return a.cost > b.cost; // for a min-heap with the std heap functions
+}
+
+FacilitySet::FacilitySet(const RouteGraph &graph) : m_First(graph.NumNodes(), -1) {}
+
+int FacilitySet::Add(const std::vector<SearchSeed> &attachments)
+{
+    const int facility = Count();
+    for (const auto &attachment : attachments) {
+        m_Attachments.push_back({facility, attachment.cost, m_First[attachment.node]});
+        m_First[attachment.node] = (int)m_Attachments.size() - 1;
+    }
+    m_Snaps.emplace_back();
+    return facility;
+}
+
+int FacilitySet::Add(const SegmentRTree &segments, const SegmentSnap &snap)
+{
+    const int facility = Add(segments.TargetSeeds(snap));
+    m_Snaps[facility] = snap;
+    return facility;
+}
+
+std::vector<FacilityMatch> NearestFacilities(const RouteGraph &graph, SearchWorkspace &workspace,
+                                             const std::vector<SearchSeed> &sources, const FacilitySet &facilities,
+                                             int k)
+{
+    std::vector<FacilityMatch> nearest;
+    if (k <= 0)
+        return nearest;
+    workspace.Prepare(graph.NumNodes());
+    auto &heap = workspace.Heap();
+    auto push = [&](float g, int node) {
+        heap.push_back({g, g, node});
+        std::push_heap(heap.begin(), heap.end(), std::greater<SearchWorkspace::HeapEntry>());
+    };
+    for (int i = 0; i < (int)sources.size(); ++i)
+        if (sources[i].cost < workspace.G(sources[i].node)) {
+            workspace.Relax(sources[i].node, sources[i].cost, -1, i);
+            push(sources[i].cost, sources[i].node);
+        }
+
+    // Facilities reached so far, with their attachment cost added. One is final
+    // once no unsettled node is cheaper; one reached through several
+    // attachments counts at its cheapest.
+    std::vector<FacilityMatch> reached;
+    auto settle_up_to = [&](float cost) {
+        while (!reached.empty() && reached.front().cost <= cost && (int)nearest.size() < k) {
+            const FacilityMatch match = reached.front();
+            std::pop_heap(reached.begin(), reached.end(), CheaperFirst);
+            reached.pop_back();
+            if (std::none_of(nearest.begin(), nearest.end(),
+                             [&](const FacilityMatch &found) { return found.facility == match.facility; }))
+                nearest.push_back(match);
+        }
+    };
+
+    while (!heap.empty() && (int)nearest.size() < k) {
+        const auto top = heap.front();
+        std::pop_heap(heap.begin(), heap.end(), std::greater<SearchWorkspace::HeapEntry>());
+        heap.pop_back();
+        if (top.g > workspace.G(top.node))
+            continue; // stale entry
+        settle_up_to(top.g);
+        if ((int)nearest.size() == k)
+            break;
+
+        facilities.ForEachAt(top.node, [&](int facility, float cost) {
+            reached.push_back({facility, top.g + cost});
+            std::push_heap(reached.begin(), reached.end(), CheaperFirst);
+        });
+        for (int arc = graph.FirstArc(top.node); arc < graph.LastArc(top.node); ++arc) {
+            const float cost = graph.Cost(arc);
+            if (cost == RouteGraph::kClosed)
+                continue;
+            const int head = graph.Head(arc);
+            const float g = top.g + cost;
+            if (g < workspace.G(head)) {
+                workspace.Relax(head, g, arc, workspace.Source(top.node));
+                push(g, head);
+            }
+        }
+    }
+    settle_up_to(RouteGraph::kClosed);
+    return nearest;
+}
@@ -0,0 +1,60 @@
+#ifndef FACILITIES_H
+#define FACILITIES_H
+
+#include <vector>
+#include "graph_search.h"
+#include "route_graph.h"
+#include "segment_rtree.h"
+
+// Facilities such as depots or stations, attached to nodes of a RouteGraph and
+// indexed by node, so a search can tell in constant time which facilities it
+// reaches when it settles a node.
+class FacilitySet {
+  public:
+    explicit FacilitySet(const RouteGraph &graph);
+
+    // Adds a facility reached through any of `attachments`: a graph node and
+    // the extra cost from there to the facility. Returns its index.
+    int Add(const std::vector<SearchSeed> &attachments);
+    int Add(int node) { return Add({{node, 0.f}}); }
+    // Adds a facility at a point snapped onto a segment of `segments`, reached
+    // through the ends of that segment.
+    int Add(const SegmentRTree &segments, const SegmentSnap &snap);
+
+    int Count() const { return (int)m_Snaps.size(); }
+    // Where a facility added at a point lies; invalid for the others.
+    const SegmentSnap &Snap(int facility) const { return m_Snaps[facility]; }
+
+    // Calls f(facility, cost) for the facilities attached at `node`.
+    template <typename F>
+    void ForEachAt(int node, F &&f) const {
+        for (int a = m_First[node]; a >= 0; a = m_Attachments[a].next)
+            f(m_Attachments[a].facility, m_Attachments[a].cost);
+    }
+
+  private:
+    struct Attachment {
+        int facility;
+        float cost;
+        int next; // next attachment at the same node, or -1
+    };
+
+    std::vector<int> m_First; // per node: first attachment, or -1
+    std::vector<Attachment> m_Attachments;
+    std::vector<SegmentSnap> m_Snaps;
+};
+
+struct FacilityMatch {
+    int facility;
+    float cost; // map units, from the sources to the facility
+};
+
+// One-to-many Dijkstra from `sources` that stops as soon as `k` facilities
+// are settled. Returns them cheapest first; fewer when fewer are reachable.
+// The workspace is reused across queries, one per thread; afterwards
+// ExtractPath() leads to the attachment nodes of the returned facilities.
+std::vector<FacilityMatch> NearestFacilities(const RouteGraph &graph, SearchWorkspace &workspace,
+                                             const std::vector<SearchSeed> &sources, const FacilitySet &facilities,
+                                             int k);
+
+#endif
@@ -0,0 +1,100 @@
+#include "graph_search.h"
+#include <algorithm>
+#include <functional>
+
+static constexpr float kInfinity = std::numeric_limits<float>::infinity();
+
+void SearchWorkspace::Prepare(int num_nodes)
+{
+    if ((int)m_Stamp.size() != num_nodes) {
+        m_Stamp.assign(num_nodes, 0);
+        m_G.resize(num_nodes);
+        m_ParentArc.resize(num_nodes);
+        m_Source.resize(num_nodes);
+        m_Generation = 0;
+    }
+    if (++m_Generation == 0) {
+        std::fill(m_Stamp.begin(), m_Stamp.end(), 0);
+        m_Generation = 1;
+    }
+    m_Heap.clear();
+}
+
+SearchResult AStar(const RouteGraph &graph, SearchWorkspace &workspace,
+                   const std::vector<SearchSeed> &sources, const std::vector<SearchSeed> &targets,
+                   const SearchLimits *limits)
+{
+    // Minimum over the targets stays consistent when every target is.
+    auto h_value = [&](int node) {
+        float h = kInfinity;
+        for (const auto &target : targets)
+            h = std::min(h, graph.Distance(node, target.node) + target.cost);
+        return h;
+    };
+    return HeuristicAStar(graph, workspace, sources, targets, h_value, limits);
+}
+
+long BoundedDijkstra(const RouteGraph &graph, SearchWorkspace &workspace,
+                     const std::vector<SearchSeed> &sources, float max_cost, bool reverse)
+{
+    workspace.Prepare(graph.NumNodes());
+    auto &heap = workspace.Heap();
+    auto push = [&](float g, int node) {
+        heap.push_back({g, g, node});
+        std::push_heap(heap.begin(), heap.end(), std::greater<SearchWorkspace::HeapEntry>());
+    };
+    for (int i = 0; i < (int)sources.size(); ++i)
+        if (sources[i].cost <= max_cost && sources[i].cost < workspace.G(sources[i].node)) {
+            workspace.Relax(sources[i].node, sources[i].cost, -1, i);
+            push(sources[i].cost, sources[i].node);
+        }
+
+    long settled = 0;
+    while (!heap.empty()) {
+        const auto top = heap.front();
+        std::pop_heap(heap.begin(), heap.end(), std::greater<SearchWorkspace::HeapEntry>());
+        heap.pop_back();
+        if (top.g > workspace.G(top.node))
+            continue;
+        settled++;
+        for (int arc = graph.FirstArc(top.node); arc < graph.LastArc(top.node); ++arc) {
+            const int head = graph.Head(arc);
+            const float g = top.g + graph.Cost(reverse ? graph.ReverseArc(arc) : arc);
+            if (g <= max_cost && g < workspace.G(head)) {
+                workspace.Relax(head, g, reverse ? graph.ReverseArc(arc) : arc, workspace.Source(top.node));
+                push(g, head);
+            }
+        }
+    }
+    return settled;
+}
+
+std::vector<int> ArcPath(const RouteGraph &graph, const SearchWorkspace &workspace, int node)
+{
+    std::vector<int> arcs;
+    while (workspace.ParentArc(node) >= 0) {
+        const int arc = workspace.ParentArc(node);
+        arcs.push_back(arc);
+        node = graph.Head(graph.ReverseArc(arc));
+    }
+    std::reverse(arcs.begin(), arcs.end());
+    return arcs;
+}
+
+RoutePath ExtractPath(const RouteGraph &graph, const SearchWorkspace &workspace, int node)
+{
+    RoutePath path;
+    if (!workspace.Reached(node))
+        return path;
+    auto arcs = ArcPath(graph, workspace, node);
+    int first = arcs.empty() ? node : graph.Head(graph.ReverseArc(arcs.front()));
+    float distance = 0.f;
+    path.nodes.push_back(first);
+    path.distances.push_back(0.f);
+    for (int arc : arcs) {
+        distance += graph.Length(arc);
+        path.nodes.push_back(graph.Head(arc));
+        path.distances.push_back(distance * (float)graph.MetricScale());
+    }
+    return path;
+}
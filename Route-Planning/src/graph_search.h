@@ -0,0 +1,159 @@
+#ifndef GRAPH_SEARCH_H
+#define GRAPH_SEARCH_H
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <vector>
+#include "route_graph.h"
+#include "route_path.h"
+#include "search_limits.h"
+
+// A source or target attached to the graph at `node` with an extra `cost`
+// (map units), e.g. the remaining distance along a compressed chain.
+struct SearchSeed {
+    int node;
+    float cost;
+};
+
+// Per-query search state over a RouteGraph. Entries are stamped with a query
+// generation so a workspace can be reused without clearing it, and one
+// workspace per thread allows concurrent searches over a shared graph.
+class SearchWorkspace {
+  public:
+    struct HeapEntry {
+        float key;
+        float g;
+        int node;
+        bool operator>(const HeapEntry &other) const { return key > other.key; }
+    };
+
+    // Starts a new query over a graph with `num_nodes` nodes.
+    void Prepare(int num_nodes);
+
+    bool Reached(int node) const { return m_Stamp[node] == m_Generation; }
+    float G(int node) const { return Reached(node) ? m_G[node] : std::numeric_limits<float>::infinity(); }
+    // Arc used to reach `node`, or -1 for sources.
+    int ParentArc(int node) const { return m_ParentArc[node]; }
+    int Source(int node) const { return m_Source[node]; }
+
+    void Relax(int node, float g, int parent_arc, int source) {
+        m_Stamp[node] = m_Generation;
+        m_G[node] = g;
+        m_ParentArc[node] = parent_arc;
+        m_Source[node] = source;
+    }
+
+    std::vector<HeapEntry> &Heap() { return m_Heap; }
+
+  private:
+    std::vector<unsigned> m_Stamp;
+    std::vector<float> m_G;
+    std::vector<int> m_ParentArc;
+    std::vector<int> m_Source;
+    std::vector<HeapEntry> m_Heap;
+    unsigned m_Generation = 0;
+};
+
+struct SearchResult {
+    float cost = std::numeric_limits<float>::infinity(); // map units, including seed costs
+    int target = -1;                                       // index into the targets
+    long expanded = 0;
+    long relaxed = 0;   // arcs scanned from expanded nodes, closed ones excluded
+    long heap_peak = 0; // most entries on the heap at once
+    SearchStatus status = SearchStatus::NoRoute;
+    int closest = -1;                                      // expanded node nearest to the targets
+    bool Found() const { return target >= 0; }
+    bool Interrupted() const { return status == SearchStatus::Cancelled || status == SearchStatus::TimedOut; }
+};
+
+// A* from any of `sources` to the cheapest of `targets` using the Euclidean
+// distance to the targets as heuristic. With `limits`, the search gives up when
+// cancelled or past the deadline; `closest` then leads to a partial route.
+SearchResult AStar(const RouteGraph &graph, SearchWorkspace &workspace,
+                   const std::vector<SearchSeed> &sources, const std::vector<SearchSeed> &targets,
+                   const SearchLimits *limits = nullptr);
+
+// A* with a caller supplied heuristic h(node), which must be consistent and
+// must not overestimate the cost to the cheapest target including its seed cost.
+template <typename Heuristic>
+SearchResult HeuristicAStar(const RouteGraph &graph, SearchWorkspace &workspace,
+                            const std::vector<SearchSeed> &sources, const std::vector<SearchSeed> &targets,
+                            Heuristic &&h_value, const SearchLimits *limits = nullptr)
+{
+    constexpr float kInfinity = std::numeric_limits<float>::infinity();
+    SearchResult result;
+    workspace.Prepare(graph.NumNodes());
+    auto &heap = workspace.Heap();
+    auto push = [&](float key, float g, int node) {
+        heap.push_back({key, g, node});
+        std::push_heap(heap.begin(), heap.end(), std::greater<SearchWorkspace::HeapEntry>());
+    };
+
+    for (int i = 0; i < (int)sources.size(); ++i) {
+        const auto &source = sources[i];
+        if (source.cost < workspace.G(source.node)) {
+            workspace.Relax(source.node, source.cost, -1, i);
+            push(source.cost + h_value(source.node), source.cost, source.node);
+        }
+    }
+    result.heap_peak = (long)heap.size();
+
+    float closest_h = kInfinity;
+    while (!heap.empty()) {
+        const auto top = heap.front();
+        std::pop_heap(heap.begin(), heap.end(), std::greater<SearchWorkspace::HeapEntry>());
+        heap.pop_back();
+        if (top.g > workspace.G(top.node))
+            continue; // stale entry
+        if (top.key >= result.cost)
+            break;
+        if (limits && result.expanded % SearchLimits::kCheckInterval == 0) {
+            result.status = limits->Check();
+            if (result.Interrupted())
+                return result;
+        }
+        result.expanded++;
+        if (top.key - top.g < closest_h) {
+            closest_h = top.key - top.g;
+            result.closest = top.node;
+        }
+
+        for (int i = 0; i < (int)targets.size(); ++i)
+            if (targets[i].node == top.node && top.g + targets[i].cost < result.cost) {
+                result.cost = top.g + targets[i].cost;
+                result.target = i;
+            }
+
+        for (int arc = graph.FirstArc(top.node); arc < graph.LastArc(top.node); ++arc) {
+            const float cost = graph.Cost(arc);
+            if (cost == kInfinity)
+                continue;
+            result.relaxed++;
+            const int head = graph.Head(arc);
+            const float g = top.g + cost;
+            if (g < workspace.G(head)) {
+                workspace.Relax(head, g, arc, workspace.Source(top.node));
+                push(g + h_value(head), g, head);
+            }
+        }
+        result.heap_peak = std::max(result.heap_peak, (long)heap.size());
+    }
+    result.status = result.Found() ? SearchStatus::Found : SearchStatus::NoRoute;
+    return result;
+}
+
+// Dijkstra from `sources` that settles every node within `max_cost` (map units);
+// afterwards workspace.G() is exact for all of them. Returns the settled count.
+// With `reverse`, arcs are followed backwards, so G() is the cost *to* the
+// sources and ParentArc(node) is the arc leaving `node` towards them.
+long BoundedDijkstra(const RouteGraph &graph, SearchWorkspace &workspace,
+                     const std::vector<SearchSeed> &sources, float max_cost, bool reverse = false);
+
+// Arcs from the source seed to `node`, in travel order.
+std::vector<int> ArcPath(const RouteGraph &graph, const SearchWorkspace &workspace, int node);
+
+// Node path from the source seed to `node` with cumulative distances in meters.
+RoutePath ExtractPath(const RouteGraph &graph, const SearchWorkspace &workspace, int node);
+
+#endif
@@ -0,0 +1,114 @@
+#include "landmarks.h"
+#include <cmath>
+#include "worker_pool.h"
+
+static constexpr float kInfinity = std::numeric_limits<float>::infinity();
+
+Landmarks Landmarks::Compute(const RouteGraph &graph, int count, unsigned threads)
+{
+    Landmarks landmarks;
+    const int num_nodes = graph.NumNodes();
+    landmarks.m_NumNodes = num_nodes;
+
+    // Restrict the choice to the component of the node nearest the centre, so no
+    // landmark is stranded on a disconnected fragment.
+    double min_x = kInfinity, min_y = kInfinity, max_x = -kInfinity, max_y = -kInfinity;
+    for (int node = 0; node < num_nodes; ++node)
+        if (graph.Degree(node) > 0) {
+            min_x = std::min(min_x, graph.Coord(node).x);
+            max_x = std::max(max_x, graph.Coord(node).x);
+            min_y = std::min(min_y, graph.Coord(node).y);
+            max_y = std::max(max_y, graph.Coord(node).y);
+        }
+    const double cx = (min_x + max_x) / 2., cy = (min_y + max_y) / 2.;
+    int center = -1;
+    double center_distance = kInfinity;
+    for (int node = 0; node < num_nodes; ++node) {
+        const double d = std::hypot(graph.Coord(node).x - cx, graph.Coord(node).y - cy);
+        if (graph.Degree(node) > 0 && d < center_distance) {
+            center = node;
+            center_distance = d;
+        }
+    }
+    if (center < 0 || count <= 0)
+        return landmarks;
+    SearchWorkspace component;
+    BoundedDijkstra(graph, component, {{center, 0.f}}, kInfinity);
+
+    // Planar selection: the node farthest from the centre in each of `count` sectors.
+    std::vector<int> best(count, -1);
+    std::vector<double> best_distance(count, -1.);
+    const double pi = std::acos(-1.);
+    for (int node = 0; node < num_nodes; ++node) {
+        if (!component.Reached(node))
+            continue;
+        const double dx = graph.Coord(node).x - cx, dy = graph.Coord(node).y - cy;
+        const int sector = std::min(count - 1, (int)((std::atan2(dy, dx) + pi) / (2. * pi) * count));
+        const double d = dx * dx + dy * dy;
+        if (d > best_distance[sector]) {
+            best[sector] = node;
+            best_distance[sector] = d;
+        }
+    }
+    for (int node : best)
+        if (node >= 0)
+            landmarks.m_Ids.push_back(node);
+
+    const int num_landmarks = landmarks.Count();
+    landmarks.m_FromStorage.resize((size_t)num_landmarks * num_nodes);
+    landmarks.m_ToStorage.resize((size_t)num_landmarks * num_nodes);
+    // One search per landmark and direction, independent of each other.
+    ParallelFor(2 * num_landmarks, [&](size_t begin, size_t end) {
+        SearchWorkspace workspace;
+        for (size_t job = begin; job < end; ++job) {
+            const int l = (int)(job / 2);
+            const bool reverse = job % 2 == 1;
+            BoundedDijkstra(graph, workspace, {{landmarks.m_Ids[l], 0.f}}, kInfinity, reverse);
+            float *row = (reverse ? landmarks.m_ToStorage : landmarks.m_FromStorage).data() + (size_t)l * num_nodes;
+            for (int node = 0; node < num_nodes; ++node)
+                row[node] = workspace.G(node);
+        }
+    }, threads);
+    landmarks.m_From = landmarks.m_FromStorage.data();
+    landmarks.m_To = landmarks.m_ToStorage.data();
+    return landmarks;
+}
+
+Landmarks::Landmarks(std::vector<int> ids, int num_nodes, const float *from, const float *to, std::shared_ptr<const void> owner)
+    : m_Ids(std::move(ids)), m_NumNodes(num_nodes), m_From(from), m_To(to), m_Owner(std::move(owner))
+{
+}
+
+float Landmarks::LowerBound(int node, int target) const
+{
+    float bound = 0.f;
+    for (int l = 0; l < Count(); ++l) {
+        const size_t row = (size_t)l * m_NumNodes;
+        // d(L, t) <= d(L, v) + d(v, t) and d(v, L) <= d(v, t) + d(t, L).
+        const float from_node = m_From[row + node], from_target = m_From[row + target];
+        if (from_node < kInfinity && from_target < kInfinity)
+            bound = std::max(bound, from_target - from_node);
+        const float to_node = m_To[row + node], to_target = m_To[row + target];
+        if (to_node < kInfinity && to_target < kInfinity)
+            bound = std::max(bound, to_node - to_target);
+    }
+    return bound;
+}
+
+SearchResult Landmarks::Search(const RouteGraph &graph, SearchWorkspace &workspace, int source, int target) const
+{
+    return Search(graph, workspace, {{source, 0.f}}, {{target, 0.f}});
+}
+
+SearchResult Landmarks::Search(const RouteGraph &graph, SearchWorkspace &workspace, const std::vector<SearchSeed> &sources,
+                               const std::vector<SearchSeed> &targets, const SearchLimits *limits) const
+{
+    // Minimum over the targets stays consistent when every target is.
+    auto h_value = [&](int node) {
+        float h = kInfinity;
+        for (const auto &target : targets)
+            h = std::min(h, std::max(graph.Distance(node, target.node), LowerBound(node, target.node)) + target.cost);
+        return h;
+    };
+    return HeuristicAStar(graph, workspace, sources, targets, h_value, limits);
+}
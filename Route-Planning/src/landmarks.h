@@ -0,0 +1,54 @@
+#ifndef LANDMARKS_H
+#define LANDMARKS_H
+
+#include <memory>
+#include <thread>
+#include <vector>
+#include "graph_search.h"
+#include "route_graph.h"
+
+// ALT heuristic (A*, landmarks, triangle inequality; Goldberg & Harrelson).
+// Distances from and to a few landmarks near the edge of the map give lower
+// bounds on the distance between any two nodes that are much tighter than the
+// straight line. Bounds stay valid while edge costs only grow above the costs
+// the tables were computed with, e.g. after closures.
+class Landmarks {
+  public:
+    Landmarks() = default;
+    Landmarks(Landmarks &&) = default;
+    Landmarks &operator=(Landmarks &&) = default;
+
+    // Picks `count` landmarks spread around the map boundary and computes their
+    // tables, running the per-landmark searches on up to `threads` threads.
+    static Landmarks Compute(const RouteGraph &graph, int count, unsigned threads = std::thread::hardware_concurrency());
+    // Uses tables stored elsewhere, e.g. in a mapped file kept alive by `owner`.
+    // Both tables hold Count() rows of `num_nodes` distances.
+    Landmarks(std::vector<int> ids, int num_nodes, const float *from, const float *to, std::shared_ptr<const void> owner);
+
+    int Count() const { return (int)m_Ids.size(); }
+    int NumNodes() const { return m_NumNodes; }
+    const std::vector<int> &Ids() const { return m_Ids; }
+    // Row-major tables: From()[l * NumNodes() + n] is the distance from landmark l
+    // to node n, To() the distance from node n to landmark l (map units).
+    const float *From() const { return m_From; }
+    const float *To() const { return m_To; }
+
+    // Lower bound on the distance from `node` to `target`.
+    float LowerBound(int node, int target) const;
+    // A* from source to target guided by the landmark bounds.
+    SearchResult Search(const RouteGraph &graph, SearchWorkspace &workspace, int source, int target) const;
+    // Same between seeds and with limits, as AStar().
+    SearchResult Search(const RouteGraph &graph, SearchWorkspace &workspace, const std::vector<SearchSeed> &sources,
+                        const std::vector<SearchSeed> &targets, const SearchLimits *limits = nullptr) const;
+
+  private:
+    std::vector<int> m_Ids;
+    int m_NumNodes = 0;
+    std::vector<float> m_FromStorage;
+    std::vector<float> m_ToStorage;
+    const float *m_From = nullptr;
+    const float *m_To = nullptr;
+    std::shared_ptr<const void> m_Owner;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#include "lpa_star.h"
+#include <algorithm>
+#include <functional>
+
+static constexpr float kInfinity = std::numeric_limits<float>::infinity();
+
+LPAStar::LPAStar(const RouteGraph &graph, int start, int goal)
+    : m_Graph(graph), m_Start(start), m_Goal(goal),
+      m_G(graph.NumNodes(), kInfinity), m_Rhs(graph.NumNodes(), kInfinity),
+      m_ChangesSeen(graph.Changes().size())
+{
+    m_Rhs[m_Start] = 0.f;
+    Push(m_Start);
+}
+
+LPAStar::Key LPAStar::CalculateKey(int node) const
+{
+    const float k2 = std::min(m_G[node], m_Rhs[node]);
+    return {k2 + CalculateHValue(node), k2};
+}
+
+void LPAStar::Push(int node)
+{
+    m_Open.push_back({CalculateKey(node), node});
+    std::push_heap(m_Open.begin(), m_Open.end(), std::greater<Entry>());
+}
+
+void LPAStar::UpdateVertex(int node)
+{
+    if (node != m_Start) {
+        float rhs = kInfinity;
+        for (int arc = m_Graph.FirstArc(node); arc < m_Graph.LastArc(node); ++arc)
+            rhs = std::min(rhs, m_G[m_Graph.Head(arc)] + m_Graph.Cost(m_Graph.ReverseArc(arc)));
+        m_Rhs[node] = rhs;
+    }
+    // Stale heap entries are skipped lazily when popped.
+    if (m_G[node] != m_Rhs[node])
+        Push(node);
+}
+
+bool LPAStar::ComputeShortestPath()
+{
+    for (;;) {
+        while (!m_Open.empty()) {
+            const auto &top = m_Open.front();
+            if (m_G[top.node] != m_Rhs[top.node] && top.key == CalculateKey(top.node))
+                break;
+            std::pop_heap(m_Open.begin(), m_Open.end(), std::greater<Entry>());
+            m_Open.pop_back();
+        }
+        if (m_Open.empty())
+            break;
+        if (!(m_Open.front().key < CalculateKey(m_Goal)) && m_Rhs[m_Goal] == m_G[m_Goal])
+            break;
+
+        const int node = m_Open.front().node;
+        std::pop_heap(m_Open.begin(), m_Open.end(), std::greater<Entry>());
+        m_Open.pop_back();
+        m_Expansions++;
+
+        if (m_G[node] > m_Rhs[node])
+            m_G[node] = m_Rhs[node];
+        else {
+            m_G[node] = kInfinity;
+            UpdateVertex(node);
+        }
+        for (int arc = m_Graph.FirstArc(node); arc < m_Graph.LastArc(node); ++arc)
+            UpdateVertex(m_Graph.Head(arc));
+    }
+    return m_G[m_Goal] < kInfinity;
+}
+
+bool LPAStar::Replan()
+{
+    const auto &changes = m_Graph.Changes();
+    for (; m_ChangesSeen < changes.size(); ++m_ChangesSeen)
+        UpdateVertex(m_Graph.Head(changes[m_ChangesSeen].arc));
+    return ComputeShortestPath();
+}
+
+float LPAStar::GetDistance() const
+{
+    return m_G[m_Goal] * (float)m_Graph.MetricScale();
+}
+
+RoutePath LPAStar::Path() const
+{
+    RoutePath path;
+    if (m_G[m_Goal] == kInfinity)
+        return path;
+
+    int node = m_Goal;
+    path.nodes.push_back(node);
+    while (node != m_Start && (int)path.size() <= m_Graph.NumNodes()) {
+        int best = -1;
+        float best_g = kInfinity;
+        for (int arc = m_Graph.FirstArc(node); arc < m_Graph.LastArc(node); ++arc) {
+            const int pred = m_Graph.Head(arc);
+            const float g = m_G[pred] + m_Graph.Cost(m_Graph.ReverseArc(arc));
+            if (g < best_g) {
+                best_g = g;
+                best = pred;
+            }
+        }
+        if (best < 0)
+            return {};
+        node = best;
+        path.nodes.push_back(node);
+    }
+    std::reverse(path.nodes.begin(), path.nodes.end());
+    for (int node : path.nodes)
+        path.distances.push_back(m_G[node] * (float)m_Graph.MetricScale());
+    return path;
+}
@@ -0,0 +1,51 @@
+#ifndef LPA_STAR_H
+#define LPA_STAR_H
+
+#include <utility>
+#include <vector>
+#include "route_graph.h"
+#include "route_path.h"
+
+// Lifelong Planning A* (Koenig & Likhachev) over a RouteGraph. After the first
+// ComputeShortestPath(), edge cost changes made on the graph are picked up by
+// Replan(), which only re-expands the part of the search tree they affect.
+class LPAStar {
+  public:
+    LPAStar(const RouteGraph &graph, int start, int goal);
+
+    // Returns false when the goal is unreachable.
+    bool ComputeShortestPath();
+    // Applies graph changes made since the last call and repairs the search.
+    bool Replan();
+
+    // Distance in meters; infinity when unreachable.
+    float GetDistance() const;
+    RoutePath Path() const;
+    int Expansions() const { return m_Expansions; }
+
+  private:
+    using Key = std::pair<float, float>;
+    struct Entry {
+        Key key;
+        int node;
+        bool operator>(const Entry &other) const { return key > other.key; }
+    };
+
+    Key CalculateKey(int node) const;
+    // Slightly deflated so float rounding can never make the heuristic inconsistent,
+    // which would let the repair stop before the goal is reached.
+    float CalculateHValue(int node) const { return m_Graph.Distance(node, m_Goal) * 0.999f; }
+    void UpdateVertex(int node);
+    void Push(int node);
+
+    const RouteGraph &m_Graph;
+    int m_Start;
+    int m_Goal;
+    std::vector<float> m_G;
+    std::vector<float> m_Rhs;
+    std::vector<Entry> m_Open;
+    size_t m_ChangesSeen = 0;
+    int m_Expansions = 0;
+};
+
+#endif
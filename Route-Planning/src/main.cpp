@@ -1,58 +1,168 @@
-#include <optional>
 #include <fstream>
 #include <iostream>
 #include <vector>
 #include <string>
+#include <chrono>
+#include <thread>
 #include <io2d.h>
+#include "batch.h"
+#include "mapped_file.h"
+#include "path_channel.h"
+#include "preprocess.h"
 #include "route_model.h"
+#include "route_graph.h"
+#include "tiled_graph.h"
+#include "trace.h"
 #include "render.h"
 #include "route_planner.h"
 
 using namespace std::experimental;
 
-static std::optional<std::vector<std::byte>> ReadFile(const std::string &path)
+static void PrintUsage()
 {
-    std::ifstream is{path, std::ios::binary | std::ios::ate};
-    if (!is)
-        return std::nullopt;
+    std::cout << "To specify a map file use the following format: " << std::endl;
+    std::cout << "Usage: [executable] [-f filename.osm]" << std::endl;
+    std::cout << "To run queries without a window: " << std::endl;
+    std::cout << "Usage: [executable] [-f filename.osm] --batch <queries.csv | -> [--latlon] [--stats stats.jsonl]" << std::endl;
+    std::cout << "       [--epsilon E] for weighted A*, [--anytime ms] for ARA* within a time budget" << std::endl;
+    std::cout << "Add --alternatives N to also show up to N alternative routes." << std::endl;
+    std::cout << "Add --progressive to open the map right away and draw the route while it is searched." << std::endl;
+    std::cout << "Add --trace trace.json to record a Chrome trace (needs -DROUTE_PLANNING_TRACING=ON)." << std::endl;
+    std::cout << "To split the map into tiles for on-demand loading: " << std::endl;
+    std::cout << "Usage: [executable] [-f filename.osm] --write-tiles <existing directory> [--tile-grid N]" << std::endl;
+}
+
+// Runs the queries from `batch_file` (or stdin for "-") and prints one CSV row per query.
+static int RunBatchMode(MappedFile &&osm_file, const std::string &osm_data_file, const std::string &batch_file,
+                        BatchFormat format, const std::string &stats_file, BatchSearch search)
+{
+    // Checked before the map is loaded, so a bad path fails right away.
+    std::ofstream stats_out;
+    if (!stats_file.empty())
+    {
+        stats_out.open(stats_file);
+        if (!stats_out)
+        {
+            std::cerr << "Failed to open " << stats_file << " for writing stats" << std::endl;
+            return 1;
+        }
+    }
 
-    auto size = is.tellg();
-    std::vector<std::byte> contents(size);
+    auto load_start = std::chrono::steady_clock::now();
+    RouteModel model{std::move(osm_file)};
+    const Preprocessed preprocessed = LoadOrPreprocess(model.Graph(), osm_data_file, {}, std::cerr);
+    search.landmarks = &preprocessed.landmarks;
+    auto load_end = std::chrono::steady_clock::now();
 
-    is.seekg(0);
-    is.read((char *)contents.data(), size);
+    std::vector<BatchQuery> queries;
+    if (batch_file == "-")
+        queries = ReadBatchQueries(std::cin, model, format, std::cerr);
+    else
+    {
+        std::ifstream is{batch_file};
+        if (!is)
+        {
+            std::cerr << "Failed to read queries from " << batch_file << std::endl;
+            return 1;
+        }
+        queries = ReadBatchQueries(is, model, format, std::cerr);
+    }
 
-    if (contents.empty())
-        return std::nullopt;
-    return std::move(contents);
+    auto run_start = std::chrono::steady_clock::now();
+    auto aggregate = RunBatch(model, queries, std::cout, stats_out.is_open() ? &stats_out : nullptr, search);
+    auto run_end = std::chrono::steady_clock::now();
+
+    double load_s = std::chrono::duration<double>(load_end - load_start).count();
+    double run_s = std::chrono::duration<double>(run_end - run_start).count();
+    std::cerr << "Model and preprocessing load: " << load_s << " s" << std::endl;
+    std::cerr << "Ran " << queries.size() << " queries in " << run_s << " s ("
+              << (run_s > 0 ? queries.size() / run_s : 0.) << " queries/s)" << std::endl;
+    aggregate.WriteReport(std::cerr);
+    return 0;
 }
 
 int main(int argc, const char **argv)
 {
-    std::string osm_data_file = "";
+    std::string osm_data_file = "../map.osm";
+    std::string batch_file = "";
+    std::string stats_file = "";
+    BatchFormat batch_format = BatchFormat::Percent;
+    std::string tiles_dir = "";
+    int tile_grid = 16;
+    BatchSearch batch_search;
+    std::string trace_file = "";
+    int alternatives = 0;
+    bool progressive = false;
     if (argc > 1)
     {
         for (int i = 1; i < argc; ++i)
-            if (std::string_view{argv[i]} == "-f" && ++i < argc)
+        {
+            auto arg = std::string_view{argv[i]};
+            if (arg == "-f" && ++i < argc)
                 osm_data_file = argv[i];
+            else if (arg == "--batch" && ++i < argc)
+                batch_file = argv[i];
+            else if (arg == "--stats" && ++i < argc)
+                stats_file = argv[i];
+            else if (arg == "--latlon")
+                batch_format = BatchFormat::LatLon;
+            else if (arg == "--epsilon" && ++i < argc)
+                batch_search.weight = std::stof(argv[i]);
+            else if (arg == "--anytime" && ++i < argc)
+                batch_search.anytime_us = std::stod(argv[i]) * 1000.;
+            else if (arg == "--alternatives" && ++i < argc)
+                alternatives = std::stoi(argv[i]);
+            else if (arg == "--progressive")
+                progressive = true;
+            else if (arg == "--trace" && ++i < argc)
+                trace_file = argv[i];
+            else if (arg == "--write-tiles" && ++i < argc)
+                tiles_dir = argv[i];
+            else if (arg == "--tile-grid" && ++i < argc)
+                tile_grid = std::stoi(argv[i]);
+        }
     }
     else
+        PrintUsage();
+
+    // Keep stdout clean for the CSV results in batch mode.
+    std::ostream &log = batch_file.empty() ? std::cout : std::cerr;
+
+    if (!trace_file.empty())
     {
-        std::cout << "To specify a map file use the following format: " << std::endl;
-        std::cout << "Usage: [executable] [-f filename.osm]" << std::endl;
-        osm_data_file = "../map.osm";
+        if (!Tracer::CompiledIn())
+            log << "Tracing is not compiled in; rebuild with -DROUTE_PLANNING_TRACING=ON." << std::endl;
+        Tracer::Start(trace_file);
     }
+    // Writes the trace, if any, when main returns.
+    struct TraceWriter {
+        ~TraceWriter() { Tracer::Stop(); }
+    } trace_writer;
+    MappedFile osm_file;
 
-    std::vector<std::byte> osm_data;
+    if (!osm_data_file.empty())
+    {
+        log << "Reading OpenStreetMap data from the following file: " << osm_data_file << std::endl;
+        // The map is parsed straight from the mapping, without a copy on the heap.
+        osm_file = MappedFile{osm_data_file};
+        if (!osm_file.Valid())
+            log << "Failed to read." << std::endl;
+    }
 
-    if (osm_data.empty() && !osm_data_file.empty())
+    if (!batch_file.empty())
+        return RunBatchMode(std::move(osm_file), osm_data_file, batch_file, batch_format, stats_file, batch_search);
+
+    if (!tiles_dir.empty())
     {
-        std::cout << "Reading OpenStreetMap data from the following file: " << osm_data_file << std::endl;
-        auto data = ReadFile(osm_data_file);
-        if (!data)
-            std::cout << "Failed to read." << std::endl;
-        else
-            osm_data = std::move(*data);
+        RouteModel model{std::move(osm_file)};
+        RouteGraph graph{model};
+        if (!TiledGraph::Write(graph, tiles_dir, tile_grid))
+        {
+            std::cout << "Failed to write tiles to " << tiles_dir << std::endl;
+            return 1;
+        }
+        std::cout << "Wrote " << tile_grid << "x" << tile_grid << " tiles to " << tiles_dir << std::endl;
+        return 0;
     }
 
     // TODO 1: Declare floats `start_x`, `start_y`, `end_x`, and `end_y` and get
@@ -89,21 +199,60 @@ int main(int argc, const char **argv)
     }
 
     // Build Model.
-    RouteModel model{osm_data};
+    RouteModel model{std::move(osm_file)};
+    const Preprocessed preprocessed = LoadOrPreprocess(model.Graph(), osm_data_file, {}, std::cout);
 
     // Create RoutePlanner object and perform A* search.
     RoutePlanner route_planner{model, start_x, start_y, end_x, end_y};
-    route_planner.AStarSearch();
+    if (!progressive) // the original search publishes partial routes, the graph search only its result
+        route_planner.SetLandmarks(preprocessed.landmarks);
+    auto search = [&]()
+    {
+        route_planner.AStarSearch();
 
-    std::cout << "Distance: " << route_planner.GetDistance() << " meters. \n";
+        std::cout << "Distance: " << route_planner.GetDistance() << " meters. \n";
+
+        if (alternatives > 0)
+        {
+            // Replaces the model's path with the shortest route on the routing graph, which the
+            // original search does not always find, so the drawn route's distance is printed too.
+            AlternativeOptions options;
+            options.max_alternatives = alternatives;
+            route_planner.AlternativeSearch(options);
+            std::cout << "Main route: " << model.path.Length() << " meters. \n";
+            for (const auto &alternative : model.alternatives)
+                std::cout << "Alternative: " << alternative.Length() << " meters. \n";
+        }
+    };
 
     // Render results of search.
     Render render{model};
 
+    // With --progressive the search runs next to the display, which draws the
+    // partial routes it publishes.
+    PathChannel progress;
+    std::thread search_thread;
+    if (progressive)
+    {
+        route_planner.SetProgress(progress);
+        render.Follow(progress);
+        search_thread = std::thread{[&]()
+                                    {
+                                        search();
+                                        if (alternatives > 0)
+                                            progress.Publish(model.path, true);
+                                        progress.Close();
+                                    }};
+    }
+    else
+        search();
+
     auto display = io2d::output_surface{400, 400, io2d::format::argb32, io2d::scaling::none, io2d::refresh_style::fixed, 30};
     display.size_change_callback([](io2d::output_surface &surface)
                                  { surface.dimensions(surface.display_dimensions()); });
     display.draw_callback([&](io2d::output_surface &surface)
                           { render.Display(surface); });
     display.begin_show();
+    if (search_thread.joinable())
+        search_thread.join();
 }
@@ -0,0 +1,120 @@
+#include "map_matcher.h"
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include "graph_search.h"
+#include "worker_pool.h"
+
+static constexpr double kImpossible = -std::numeric_limits<double>::infinity();
+
+MapMatcher::MapMatcher(const RouteGraph &graph, const SegmentRTree &segments) : MapMatcher(graph, segments, Options{})
+{
+}
+
+MapMatcher::MapMatcher(const RouteGraph &graph, const SegmentRTree &segments, const Options &options)
+    : m_Graph(graph), m_Segments(segments), m_Options(options)
+{
+}
+
+MapMatcher::Match MapMatcher::MatchTrace(const std::vector<TracePoint> &trace) const
+{
+    static thread_local SearchWorkspace workspace;
+    const double scale = m_Graph.MetricScale();
+    const double sigma = m_Options.gps_sigma_m / scale;
+    const double beta = m_Options.transition_beta_m / scale;
+    const double radius = m_Options.search_radius_m / scale;
+
+    Match match;
+    match.points.resize(trace.size());
+
+    // Viterbi state for the current fix: candidates, log probabilities, and for
+    // every fix the index of each candidate's predecessor.
+    std::vector<std::vector<SegmentSnap>> candidates(trace.size());
+    std::vector<std::vector<int>> previous(trace.size());
+    std::vector<double> score, next_score;
+    int last = -1; // last fix with candidates in the current run
+
+    // Picks the best final candidate of a run and walks its predecessors back.
+    auto finish_run = [&](int end) {
+        if (end < 0)
+            return;
+        int best = 0;
+        for (int i = 1; i < (int)score.size(); ++i)
+            if (score[i] > score[best])
+                best = i;
+        for (int t = end; t >= 0 && best >= 0; --t) {
+            if (candidates[t].empty())
+                continue;
+            match.points[t] = candidates[t][best];
+            best = previous[t][best];
+        }
+    };
+
+    for (int t = 0; t < (int)trace.size(); ++t) {
+        candidates[t] = m_Segments.Candidates(trace[t].x, trace[t].y, radius, m_Options.max_candidates);
+        const auto &current = candidates[t];
+        if (current.empty())
+            continue;
+        previous[t].assign(current.size(), -1);
+
+        auto emission = [&](const SegmentSnap &snap) { return -0.5 * (snap.distance / sigma) * (snap.distance / sigma); };
+        next_score.assign(current.size(), kImpossible);
+        if (last >= 0) {
+            const double straight = std::hypot(trace[t].x - trace[last].x, trace[t].y - trace[last].y);
+            const float max_cost = (float)(straight * m_Options.max_detour + 2. * radius);
+            std::vector<std::vector<SearchSeed>> targets;
+            for (const auto &snap : current)
+                targets.push_back(m_Segments.TargetSeeds(snap));
+
+            for (int i = 0; i < (int)candidates[last].size(); ++i) {
+                if (score[i] == kImpossible)
+                    continue;
+                const auto &from = candidates[last][i];
+                BoundedDijkstra(m_Graph, workspace, m_Segments.SourceSeeds(from), max_cost);
+                for (int j = 0; j < (int)current.size(); ++j) {
+                    double route = m_Segments.DirectCost(from, current[j]);
+                    for (const auto &seed : targets[j])
+                        route = std::min(route, (double)workspace.G(seed.node) + seed.cost);
+                    if (route > max_cost)
+                        continue;
+                    const double probability = score[i] - std::abs(route - straight) / beta + emission(current[j]);
+                    if (probability > next_score[j]) {
+                        next_score[j] = probability;
+                        previous[t][j] = i;
+                    }
+                }
+            }
+        }
+
+        bool reachable = false;
+        for (double value : next_score)
+            reachable = reachable || value != kImpossible;
+        if (!reachable) {
+            // Start a new run: the previous fixes are decided independently.
+            if (last >= 0) {
+                finish_run(last);
+                match.breaks++;
+            }
+            for (int j = 0; j < (int)current.size(); ++j) {
+                next_score[j] = emission(current[j]);
+                previous[t][j] = -1;
+            }
+        }
+        score.swap(next_score);
+        last = t;
+    }
+    finish_run(last);
+    return match;
+}
+
+std::vector<MapMatcher::Match> MapMatcher::MatchTraces(const std::vector<std::vector<TracePoint>> &traces, unsigned threads) const
+{
+    std::vector<Match> matches(traces.size());
+    // Traces differ in length, so threads take them one at a time.
+    std::atomic<size_t> next{0};
+    ParallelFor(threads, [&](size_t, size_t) {
+        for (size_t i = next++; i < traces.size(); i = next++)
+            matches[i] = MatchTrace(traces[i]);
+    }, threads);
+    return matches;
+}
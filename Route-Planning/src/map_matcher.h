@@ -0,0 +1,59 @@
+#ifndef MAP_MATCHER_H
+#define MAP_MATCHER_H
+
+#include <thread>
+#include <vector>
+#include "route_graph.h"
+#include "segment_rtree.h"
+
+// A GPS fix in map coordinates (see Model::Project for latitude/longitude).
+struct TracePoint {
+    double x;
+    double y;
+};
+
+// Hidden Markov model map matching (Newson & Krumm, 2009). Every fix gets up to
+// `max_candidates` road positions within `search_radius_m` as hidden states.
+// Emission probabilities fall off with the distance from the fix (Gaussian GPS
+// noise), transition probabilities with the difference between the route
+// distance and the straight-line distance of consecutive fixes. Route distances
+// come from Dijkstra searches bounded to a multiple of the straight-line
+// distance, and the Viterbi algorithm picks the most likely candidate sequence.
+//
+// MatchTrace() is const and keeps its search state per thread, so many traces
+// can be matched over one graph at once.
+class MapMatcher {
+  public:
+    struct Options {
+        double gps_sigma_m = 10.;
+        double transition_beta_m = 5.;
+        double search_radius_m = 50.;
+        size_t max_candidates = 8;
+        // Route distances longer than this factor times the straight-line
+        // distance (plus twice the search radius) are treated as impossible.
+        double max_detour = 3.;
+    };
+
+    struct Match {
+        // One entry per fix; invalid where no road was in range.
+        std::vector<SegmentSnap> points;
+        // Number of times the sequence had to restart because no candidate of a
+        // fix could be reached from the previous one.
+        int breaks = 0;
+    };
+
+    MapMatcher(const RouteGraph &graph, const SegmentRTree &segments);
+    MapMatcher(const RouteGraph &graph, const SegmentRTree &segments, const Options &options);
+
+    Match MatchTrace(const std::vector<TracePoint> &trace) const;
+    // Matches traces on up to `threads` threads; results are in input order.
+    std::vector<Match> MatchTraces(const std::vector<std::vector<TracePoint>> &traces,
+                                   unsigned threads = std::thread::hardware_concurrency()) const;
+
+  private:
+    const RouteGraph &m_Graph;
+    const SegmentRTree &m_Segments;
+    Options m_Options;
+};
+
+#endif
@@ -0,0 +1,85 @@
+#include "mapped_file.h"
+#include <fstream>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MAPPED_FILE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string &path)
+{
+#ifdef MAPPED_FILE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat info;
+    if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+        // MAP_PRIVATE allows writes to the pages without opening the file for writing.
+        void *data = ::mmap(nullptr, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            ::madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+            m_Data = static_cast<std::byte *>(data);
+            m_Size = (size_t)info.st_size;
+            m_Mapped = true;
+        }
+    }
+    ::close(fd);
+    if (m_Mapped)
+        return;
+#endif
+
+    std::ifstream is{path, std::ios::binary | std::ios::ate};
+    if (!is)
+        return;
+    auto size = is.tellg();
+    if (size <= 0)
+        return;
+    m_Fallback.resize((size_t)size);
+    is.seekg(0);
+    if (!is.read((char *)m_Fallback.data(), size)) {
+        m_Fallback.clear();
+        return;
+    }
+    m_Data = m_Fallback.data();
+    m_Size = m_Fallback.size();
+}
+
+MappedFile::~MappedFile()
+{
+    Release();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+{
+    *this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other) {
+        Release();
+        m_Data = std::exchange(other.m_Data, nullptr);
+        m_Size = std::exchange(other.m_Size, 0);
+        m_Mapped = std::exchange(other.m_Mapped, false);
+        m_Fallback = std::move(other.m_Fallback);
+        other.m_Fallback.clear();
+    }
+    return *this;
+}
+
+void MappedFile::Release()
+{
+#ifdef MAPPED_FILE_MMAP
+    if (m_Mapped)
+        ::munmap(m_Data, m_Size);
+#endif
+    m_Data = nullptr;
+    m_Size = 0;
+    m_Mapped = false;
+    m_Fallback.clear();
+    m_Fallback.shrink_to_fit();
+}
@@ -0,0 +1,38 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Private, copy-on-write memory mapping of a whole file. Pages are read from
+// the page cache on first access instead of being copied into a heap buffer,
+// and writes (such as in-place XML parsing) never reach the file.
+//
+// Where mapping is unavailable the file is read into an owned buffer instead.
+class MappedFile {
+  public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // False when the file could not be opened or is empty.
+    bool Valid() const { return m_Data != nullptr; }
+    std::byte *Data() const { return m_Data; }
+    size_t Size() const { return m_Size; }
+    bool IsMapped() const { return m_Mapped; }
+
+  private:
+    void Release();
+
+    std::byte *m_Data = nullptr;
+    size_t m_Size = 0;
+    bool m_Mapped = false;
+    std::vector<std::byte> m_Fallback;
+};
+
+#endif
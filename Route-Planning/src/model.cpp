@@ -1,5 +1,8 @@
 #include "model.h"
+#include "osm_pbf.h"
+#include "projection.h"
 #include "pugixml.hpp"
+#include "trace.h"
 #include <iostream>
 #include <string_view>
 #include <cmath>
@@ -39,8 +42,38 @@ static Model::Landuse::Type String2LanduseType(std::string_view type)
 
 Model::Model( const std::vector<std::byte> &xml )
 {
-    LoadData(xml);
+    if( IsOsmPbf(xml.data(), xml.size()) ) {
+        LoadPbf(xml.data(), xml.size());
+        return;
+    }
+    pugi::xml_document doc;
+    if( !doc.load_buffer(xml.data(), xml.size()) )
+        throw std::logic_error("failed to parse the xml file");
+    Load(doc);
+}
+
+Model::Model( MappedFile &&xml )
+{
+    // Declared before the document, which points into the mapping, so it outlives it.
+    MappedFile mapped = std::move(xml);
+    if( mapped.Valid() && IsOsmPbf(mapped.Data(), mapped.Size()) ) {
+        LoadPbf(mapped.Data(), mapped.Size());
+        return;
+    }
+    pugi::xml_document doc;
+    if( !mapped.Valid() || !doc.load_buffer_inplace(mapped.Data(), mapped.Size()) )
+        throw std::logic_error("failed to parse the xml file");
+    Load(doc);
+}
+
+void Model::Load( const pugi::xml_document &doc )
+{
+    LoadData(doc);
+    FinishLoading();
+}
 
+void Model::FinishLoading()
+{
     AdjustCoordinates();
 
     std::sort(m_Roads.begin(), m_Roads.end(), [](const auto &_1st, const auto &_2nd){
@@ -48,14 +81,11 @@ Model::Model( const std::vector<std::byte> &xml )
     });
 }
 
-void Model::LoadData(const std::vector<std::byte> &xml)
+void Model::LoadData(const pugi::xml_document &doc)
 {
+    TRACE_SCOPE("Model::LoadData");
     using namespace pugi;
     
-    xml_document doc;
-    if( !doc.load_buffer(xml.data(), xml.size()) )
-        throw std::logic_error("failed to parse the xml file");
-    
     if( auto bounds = doc.select_nodes("/osm/bounds"); !bounds.empty() ) {
         auto node = bounds.first().node();
         m_MinLat = atof(node.attribute("minlat").as_string());
@@ -91,40 +121,9 @@ void Model::LoadData(const std::vector<std::byte> &xml)
                     new_way.nodes.emplace_back(it->second);
             }
             else if( name == "tag" ) {
-                auto category = std::string_view{child.attribute("k").as_string()};
-                auto type = std::string_view{child.attribute("v").as_string()};
-                if( category == "highway" ) {
-                    if( auto road_type = String2RoadType(type); road_type != Road::Invalid ) {
-                        m_Roads.emplace_back();
-                        m_Roads.back().way = way_num;
-                        m_Roads.back().type = road_type;
-                    }
-                }
-                if( category == "railway" ) {
-                    m_Railways.emplace_back();
-                    m_Railways.back().way = way_num;
-                }                
-                else if( category == "building" ) {
-                    m_Buildings.emplace_back();
-                    m_Buildings.back().outer = {way_num};
-                }
-                else if( category == "leisure" ||
-                        (category == "natural" && (type == "wood"  || type == "tree_row" || type == "scrub" || type == "grassland")) ||
-                        (category == "landcover" && type == "grass" ) ) {
-                    m_Leisures.emplace_back();
-                    m_Leisures.back().outer = {way_num};
-                }
-                else if( category == "natural" && type == "water" ) {
-                    m_Waters.emplace_back();
-                    m_Waters.back().outer = {way_num};
-                }
-                else if( category == "landuse" ) {
-                    if( auto landuse_type = String2LanduseType(type); landuse_type != Landuse::Invalid ) {
-                        m_Landuses.emplace_back();
-                        m_Landuses.back().outer = {way_num};
-                        m_Landuses.back().type = landuse_type;
-                    }                    
-                }
+                AddWayTag(way_num,
+                          std::string_view{child.attribute("k").as_string()},
+                          std::string_view{child.attribute("v").as_string()});
             }
         }
     }
@@ -133,10 +132,6 @@ void Model::LoadData(const std::vector<std::byte> &xml)
         auto node = relation.node();
         auto noode_id = std::string_view{node.attribute("id").as_string()};
         std::vector<int> outer, inner;
-        auto commit = [&](Multipolygon &mp) {
-            mp.outer = std::move(outer);
-            mp.inner = std::move(inner);
-        };
         for( auto child: node.children() ) {
             auto name = std::string_view{child.name()}; 
             if( name == "member" ) {
@@ -153,44 +148,154 @@ void Model::LoadData(const std::vector<std::byte> &xml)
             else if( name == "tag" ) { 
                 auto category = std::string_view{child.attribute("k").as_string()};
                 auto type = std::string_view{child.attribute("v").as_string()};
-                if( category == "building" ) {
-                    commit( m_Buildings.emplace_back() );
-                    break;
-                }
-                if( category == "natural" && type == "water" ) {
-                    commit( m_Waters.emplace_back() );
-                    BuildRings(m_Waters.back());
-                    break;
-                }
-                if( category == "landuse" ) {
-                    if( auto landuse_type = String2LanduseType(type); landuse_type != Landuse::Invalid ) {
-                        commit( m_Landuses.emplace_back() );
-                        m_Landuses.back().type = landuse_type;
-                        BuildRings(m_Landuses.back());
-                    }
+                if( AddRelationTag(outer, inner, category, type) )
                     break;
+            }
+        }
+    }
+}
+
+void Model::LoadPbf( const std::byte *data, std::size_t size )
+{
+    TRACE_SCOPE("Model::LoadPbf");
+    const PbfFile file = ReadOsmPbf(data, size);
+    if( !file.has_bounds )
+        throw std::logic_error("map's bounds are not defined");
+    m_MinLat = file.min_lat;
+    m_MaxLat = file.max_lat;
+    m_MinLon = file.min_lon;
+    m_MaxLon = file.max_lon;
+
+    // Same passes as for XML: nodes, then ways, then relations, in file order.
+    size_t num_nodes = 0, num_ways = 0;
+    for( const auto &block: file.blocks ) {
+        num_nodes += block.nodes.size();
+        num_ways += block.ways.size();
+    }
+    m_Nodes.reserve(num_nodes);
+    m_Ways.reserve(num_ways);
+    std::unordered_map<int64_t, int> node_id_to_num;
+    node_id_to_num.reserve(num_nodes);
+    for( const auto &block: file.blocks )
+        for( const auto &node: block.nodes ) {
+            node_id_to_num[node.id] = (int)m_Nodes.size();
+            m_Nodes.emplace_back();
+            m_Nodes.back().y = node.lat;
+            m_Nodes.back().x = node.lon;
+        }
+
+    std::unordered_map<int64_t, int> way_id_to_num;
+    way_id_to_num.reserve(num_ways);
+    for( const auto &block: file.blocks )
+        for( const auto &way: block.ways ) {
+            const auto way_num = (int)m_Ways.size();
+            way_id_to_num[way.id] = way_num;
+            auto &new_way = m_Ways.emplace_back();
+            new_way.nodes.reserve(way.refs.size());
+            for( auto ref: way.refs )
+                if( auto it = node_id_to_num.find(ref); it != end(node_id_to_num) )
+                    new_way.nodes.emplace_back(it->second);
+            for( const auto &tag: way.tags )
+                AddWayTag(way_num, tag.key, tag.value);
+        }
+
+    for( const auto &block: file.blocks )
+        for( const auto &relation: block.relations ) {
+            std::vector<int> outer, inner;
+            for( const auto &member: relation.members ) {
+                if( member.type != PbfBlock::Member::Way )
+                    continue;
+                if( auto it = way_id_to_num.find(member.ref); it != end(way_id_to_num) ) {
+                    if( member.role == "outer" )
+                        outer.emplace_back(it->second);
+                    else
+                        inner.emplace_back(it->second);
                 }
             }
+            for( const auto &tag: relation.tags )
+                if( AddRelationTag(outer, inner, tag.key, tag.value) )
+                    break;
+        }
+    FinishLoading();
+}
+
+void Model::AddWayTag( int way_num, std::string_view category, std::string_view type )
+{
+    if( category == "highway" ) {
+        if( auto road_type = String2RoadType(type); road_type != Road::Invalid ) {
+            m_Roads.emplace_back();
+            m_Roads.back().way = way_num;
+            m_Roads.back().type = road_type;
         }
     }
+    if( category == "railway" ) {
+        m_Railways.emplace_back();
+        m_Railways.back().way = way_num;
+    }                
+    else if( category == "building" ) {
+        m_Buildings.emplace_back();
+        m_Buildings.back().outer = {way_num};
+    }
+    else if( category == "leisure" ||
+            (category == "natural" && (type == "wood"  || type == "tree_row" || type == "scrub" || type == "grassland")) ||
+            (category == "landcover" && type == "grass" ) ) {
+        m_Leisures.emplace_back();
+        m_Leisures.back().outer = {way_num};
+    }
+    else if( category == "natural" && type == "water" ) {
+        m_Waters.emplace_back();
+        m_Waters.back().outer = {way_num};
+    }
+    else if( category == "landuse" ) {
+        if( auto landuse_type = String2LanduseType(type); landuse_type != Landuse::Invalid ) {
+            m_Landuses.emplace_back();
+            m_Landuses.back().outer = {way_num};
+            m_Landuses.back().type = landuse_type;
+        }                    
+    }
+}
+
+bool Model::AddRelationTag( std::vector<int> &outer, std::vector<int> &inner, std::string_view category, std::string_view type )
+{
+    auto commit = [&](Multipolygon &mp) {
+        mp.outer = std::move(outer);
+        mp.inner = std::move(inner);
+    };
+    if( category == "building" ) {
+        commit( m_Buildings.emplace_back() );
+        return true;
+    }
+    if( category == "natural" && type == "water" ) {
+        commit( m_Waters.emplace_back() );
+        BuildRings(m_Waters.back());
+        return true;
+    }
+    if( category == "landuse" ) {
+        if( auto landuse_type = String2LanduseType(type); landuse_type != Landuse::Invalid ) {
+            commit( m_Landuses.emplace_back() );
+            m_Landuses.back().type = landuse_type;
+            BuildRings(m_Landuses.back());
+        }
+        return true;
+    }
+    return false;
 }
 
 void Model::AdjustCoordinates()
 {    
-    const auto pi = 3.14159265358979323846264338327950288;
-    const auto deg_to_rad = 2. * pi / 360.;
-    const auto earth_radius = 6378137.;
-    const auto lat2ym = [&](double lat) { return log(tan(lat * deg_to_rad / 2 +  pi/4)) / 2 * earth_radius; };
-    const auto lon2xm = [&](double lon) { return lon * deg_to_rad / 2 * earth_radius; };     
-    const auto dx = lon2xm(m_MaxLon) - lon2xm(m_MinLon);
-    const auto dy = lat2ym(m_MaxLat) - lat2ym(m_MinLat);
-    const auto min_y = lat2ym(m_MinLat);
-    const auto min_x = lon2xm(m_MinLon);
+    TRACE_SCOPE("Model::AdjustCoordinates");
+    const auto dx = MercatorX(m_MaxLon) - MercatorX(m_MinLon);
+    const auto dy = MercatorY(m_MaxLat) - MercatorY(m_MinLat);
     m_MetricScale = std::min(dx, dy);
-    for( auto &node: m_Nodes ) {
-        node.x = (lon2xm(node.x) - min_x) / m_MetricScale;
-        node.y = (lat2ym(node.y) - min_y) / m_MetricScale;        
-    }
+    ProjectMercator( m_Nodes.data(), m_Nodes.size(), MercatorX(m_MinLon), MercatorY(m_MinLat), m_MetricScale );
+}
+
+Model::Node Model::Project( double lat, double lon ) const noexcept
+{
+    Node node;
+    node.x = (MercatorX(lon) - MercatorX(m_MinLon)) / m_MetricScale;
+    node.y = (MercatorY(lat) - MercatorY(m_MinLat)) / m_MetricScale;
+    return node;
 }
 
 static bool TrackRec(const std::vector<int> &open_ways,
@@ -252,6 +357,7 @@ static std::vector<int> Track(std::vector<int> &open_ways, const Model::Way *way
 
 void Model::BuildRings( Multipolygon &mp )
 {
+    TRACE_SCOPE("Model::BuildRings");
     auto is_closed = []( const Model::Way &way ) {
         return way.nodes.size() > 1 && way.nodes.front() == way.nodes.back();    
     };
@@ -3,7 +3,11 @@
 #include <vector>
 #include <unordered_map>
 #include <string>
+#include <string_view>
 #include <cstddef>
+#include "mapped_file.h"
+
+namespace pugi { class xml_document; }
 
 class Model
 {
@@ -44,10 +48,17 @@ public:
         Type type;
     };
     
+    // Both constructors accept OSM XML or, detected from its first bytes, OSM PBF.
     Model( const std::vector<std::byte> &xml );
+    // Parses the mapped file in place, without copying it, and releases the
+    // mapping once the model is built.
+    Model( MappedFile &&xml );
     
     auto MetricScale() const noexcept { return m_MetricScale; }    
     
+    // Projects WGS84 coordinates into the normalized map space used by Nodes().
+    Node Project( double lat, double lon ) const noexcept;
+    
     auto &Nodes() const noexcept { return m_Nodes; }
     auto &Ways() const noexcept { return m_Ways; }
     auto &Roads() const noexcept { return m_Roads; }
@@ -60,7 +71,12 @@ public:
 private:
     void AdjustCoordinates();
     void BuildRings( Multipolygon &mp );
-    void LoadData(const std::vector<std::byte> &xml);
+    void Load( const pugi::xml_document &doc );
+    void LoadData(const pugi::xml_document &doc);
+    void LoadPbf( const std::byte *data, std::size_t size );
+    void FinishLoading();
+    void AddWayTag( int way_num, std::string_view category, std::string_view type );
+    bool AddRelationTag( std::vector<int> &outer, std::vector<int> &inner, std::string_view category, std::string_view type );
     
     std::vector<Node> m_Nodes;
     std::vector<Way> m_Ways;
@@ -0,0 +1,589 @@
+#include "osm_pbf.h"
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <zlib.h>
+#include "pugixml.hpp"
+#include "trace.h"
+#include "worker_pool.h"
+
+namespace {
+
+// Limits from the format specification, checked before allocating anything.
+constexpr uint32_t kMaxBlobHeaderSize = 64 * 1024;
+constexpr uint64_t kMaxBlobSize = 32 * 1024 * 1024;
+constexpr int kEntitiesPerBlock = 8000;
+
+[[noreturn]] void Fail(const char *what = "malformed PBF data")
+{
+    throw std::logic_error(what);
+}
+
+int64_t ZigZagDecode(uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+uint64_t ZigZagEncode(int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+// Minimal protobuf wire format reader over one message.
+class ProtoReader {
+  public:
+    ProtoReader(const void *data, size_t size)
+        : m_Data(static_cast<const uint8_t *>(data)), m_End(m_Data + size) {}
+    explicit ProtoReader(std::string_view bytes) : ProtoReader(bytes.data(), bytes.size()) {}
+
+    // Advances to the next field; false at the end of the message.
+    bool Next() {
+        if (m_Data == m_End)
+            return false;
+        const uint64_t key = Varint();
+        m_Field = (uint32_t)(key >> 3);
+        m_Wire = (int)(key & 7);
+        return true;
+    }
+    uint32_t Field() const { return m_Field; }
+
+    uint64_t Varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (m_Data == m_End)
+                Fail();
+            const uint8_t byte = *m_Data++;
+            value |= uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        Fail();
+    }
+    int64_t SVarint() { return ZigZagDecode(Varint()); }
+    std::string_view Bytes() {
+        const uint64_t size = Varint();
+        if (size > (uint64_t)(m_End - m_Data))
+            Fail();
+        std::string_view bytes{reinterpret_cast<const char *>(m_Data), (size_t)size};
+        m_Data += size;
+        return bytes;
+    }
+    ProtoReader Message() { return ProtoReader{Bytes()}; }
+
+    // Calls f(value) for every value of a packed repeated varint field, also
+    // accepting the unpacked encoding of a single value.
+    template <typename F>
+    void Packed(F &&f) {
+        if (m_Wire == 0) {
+            f(Varint());
+            return;
+        }
+        ProtoReader packed = Message();
+        while (packed.m_Data != packed.m_End)
+            f(packed.Varint());
+    }
+
+    void Skip() {
+        switch (m_Wire) {
+        case 0: Varint(); break;
+        case 1: Advance(8); break;
+        case 2: Bytes(); break;
+        case 5: Advance(4); break;
+        default: Fail();
+        }
+    }
+
+  private:
+    void Advance(size_t size) {
+        if (size > (size_t)(m_End - m_Data))
+            Fail();
+        m_Data += size;
+    }
+
+    const uint8_t *m_Data;
+    const uint8_t *m_End;
+    uint32_t m_Field = 0;
+    int m_Wire = 0;
+};
+
+class ProtoWriter {
+  public:
+    void Varint(uint32_t field, uint64_t value) {
+        Key(field, 0);
+        Raw(value);
+    }
+    void SVarint(uint32_t field, int64_t value) { Varint(field, ZigZagEncode(value)); }
+    void Bytes(uint32_t field, std::string_view bytes) {
+        Key(field, 2);
+        Raw(bytes.size());
+        m_Data.append(bytes);
+    }
+    void Packed(uint32_t field, const std::vector<uint64_t> &values) {
+        if (values.empty())
+            return;
+        ProtoWriter packed;
+        for (uint64_t value : values)
+            packed.Raw(value);
+        Bytes(field, packed.Data());
+    }
+    const std::string &Data() const { return m_Data; }
+
+  private:
+    void Key(uint32_t field, int wire) { Raw((uint64_t)field << 3 | wire); }
+    void Raw(uint64_t value) {
+        while (value >= 0x80) {
+            m_Data.push_back(char(value | 0x80));
+            value >>= 7;
+        }
+        m_Data.push_back(char(value));
+    }
+
+    std::string m_Data;
+};
+
+// Uncompressed content of a Blob message.
+std::vector<std::byte> Inflate(std::string_view blob)
+{
+    ProtoReader reader{blob};
+    std::string_view raw, compressed;
+    bool has_raw = false, has_zlib = false;
+    uint64_t raw_size = 0;
+    while (reader.Next()) {
+        switch (reader.Field()) {
+        case 1: raw = reader.Bytes(); has_raw = true; break;
+        case 2: raw_size = reader.Varint(); break;
+        case 3: compressed = reader.Bytes(); has_zlib = true; break;
+        case 4: case 5: case 6: case 7: Fail("unsupported PBF compression (only zlib is supported)");
+        default: reader.Skip();
+        }
+    }
+    if (has_raw) {
+        auto bytes = reinterpret_cast<const std::byte *>(raw.data());
+        return std::vector<std::byte>(bytes, bytes + raw.size());
+    }
+    if (!has_zlib || raw_size > kMaxBlobSize)
+        Fail();
+    std::vector<std::byte> data(raw_size);
+    uLongf size = (uLongf)raw_size;
+    if (uncompress(reinterpret_cast<Bytef *>(data.data()), &size, reinterpret_cast<const Bytef *>(compressed.data()),
+                   (uLong)compressed.size()) != Z_OK || size != raw_size)
+        Fail("corrupt zlib data in PBF blob");
+    return data;
+}
+
+void ReadHeaderBlock(const std::vector<std::byte> &data, PbfFile &file)
+{
+    ProtoReader reader{data.data(), data.size()};
+    while (reader.Next()) {
+        if (reader.Field() == 1) {
+            // HeaderBBox, in nanodegrees.
+            ProtoReader bbox = reader.Message();
+            while (bbox.Next()) {
+                switch (bbox.Field()) {
+                case 1: file.min_lon = bbox.SVarint() / 1e9; break;
+                case 2: file.max_lon = bbox.SVarint() / 1e9; break;
+                case 3: file.max_lat = bbox.SVarint() / 1e9; break;
+                case 4: file.min_lat = bbox.SVarint() / 1e9; break;
+                default: bbox.Skip();
+                }
+            }
+            file.has_bounds = true;
+        }
+        else if (reader.Field() == 4) {
+            const auto feature = reader.Bytes();
+            if (feature != "OsmSchema-V0.6" && feature != "DenseNodes")
+                throw std::logic_error("unsupported PBF feature: " + std::string{feature});
+        }
+        else
+            reader.Skip();
+    }
+}
+
+PbfBlock DecodeBlock(std::vector<std::byte> data)
+{
+    PbfBlock block;
+    block.strings = std::move(data);
+
+    // Fields may come in any order, so the groups are decoded once the string
+    // table and the coordinate scaling are known.
+    ProtoReader reader{block.strings.data(), block.strings.size()};
+    std::vector<std::string_view> strings, groups;
+    int64_t granularity = 100, lat_offset = 0, lon_offset = 0;
+    while (reader.Next()) {
+        switch (reader.Field()) {
+        case 1: {
+            ProtoReader table = reader.Message();
+            while (table.Next())
+                if (table.Field() == 1)
+                    strings.push_back(table.Bytes());
+                else
+                    table.Skip();
+            break;
+        }
+        case 2: groups.push_back(reader.Bytes()); break;
+        case 17: granularity = (int64_t)reader.Varint(); break;
+        case 19: lat_offset = (int64_t)reader.Varint(); break;
+        case 20: lon_offset = (int64_t)reader.Varint(); break;
+        default: reader.Skip();
+        }
+    }
+    auto string = [&](uint64_t index) {
+        if (index >= strings.size())
+            Fail();
+        return strings[index];
+    };
+    // Dividing the exact integer keeps coordinates identical to parsing the XML decimals.
+    auto lat = [&](int64_t value) { return (lat_offset + granularity * value) / 1e9; };
+    auto lon = [&](int64_t value) { return (lon_offset + granularity * value) / 1e9; };
+    // Keys and values are parallel lists of string table indices.
+    auto tags = [&](const std::vector<uint32_t> &keys, const std::vector<uint32_t> &values) {
+        if (keys.size() != values.size())
+            Fail();
+        std::vector<PbfTag> result;
+        result.reserve(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i)
+            result.push_back({string(keys[i]), string(values[i])});
+        return result;
+    };
+
+    std::vector<uint32_t> keys, values, roles;
+    std::vector<int64_t> ids, lats, lons;
+    std::vector<PbfBlock::Member::Type> types;
+    for (std::string_view bytes : groups) {
+        ProtoReader group{bytes};
+        while (group.Next()) {
+            switch (group.Field()) {
+            case 1: {
+                ProtoReader node = group.Message();
+                PbfBlock::Node &decoded = block.nodes.emplace_back();
+                while (node.Next()) {
+                    switch (node.Field()) {
+                    case 1: decoded.id = node.SVarint(); break;
+                    case 8: decoded.lat = lat(node.SVarint()); break;
+                    case 9: decoded.lon = lon(node.SVarint()); break;
+                    default: node.Skip();
+                    }
+                }
+                break;
+            }
+            case 2: {
+                ProtoReader dense = group.Message();
+                ids.clear();
+                lats.clear();
+                lons.clear();
+                while (dense.Next()) {
+                    if (dense.Field() == 1 || dense.Field() == 8 || dense.Field() == 9) {
+                        auto &target = dense.Field() == 1 ? ids : dense.Field() == 8 ? lats : lons;
+                        int64_t previous = 0;
+                        dense.Packed([&](uint64_t value) { target.push_back(previous += ZigZagDecode(value)); });
+                    }
+                    else
+                        dense.Skip();
+                }
+                if (lats.size() != ids.size() || lons.size() != ids.size())
+                    Fail();
+                for (size_t i = 0; i < ids.size(); ++i)
+                    block.nodes.push_back({ids[i], lat(lats[i]), lon(lons[i])});
+                break;
+            }
+            case 3: {
+                ProtoReader way = group.Message();
+                PbfBlock::Way &decoded = block.ways.emplace_back();
+                keys.clear();
+                values.clear();
+                while (way.Next()) {
+                    switch (way.Field()) {
+                    case 1: decoded.id = (int64_t)way.Varint(); break;
+                    case 2: way.Packed([&](uint64_t index) { keys.push_back((uint32_t)index); }); break;
+                    case 3: way.Packed([&](uint64_t index) { values.push_back((uint32_t)index); }); break;
+                    case 8: {
+                        int64_t previous = 0;
+                        way.Packed([&](uint64_t value) { decoded.refs.push_back(previous += ZigZagDecode(value)); });
+                        break;
+                    }
+                    default: way.Skip();
+                    }
+                }
+                decoded.tags = tags(keys, values);
+                break;
+            }
+            case 4: {
+                ProtoReader relation = group.Message();
+                PbfBlock::Relation &decoded = block.relations.emplace_back();
+                keys.clear();
+                values.clear();
+                roles.clear();
+                ids.clear();
+                types.clear();
+                while (relation.Next()) {
+                    switch (relation.Field()) {
+                    case 1: decoded.id = (int64_t)relation.Varint(); break;
+                    case 2: relation.Packed([&](uint64_t index) { keys.push_back((uint32_t)index); }); break;
+                    case 3: relation.Packed([&](uint64_t index) { values.push_back((uint32_t)index); }); break;
+                    case 8: relation.Packed([&](uint64_t index) { roles.push_back((uint32_t)index); }); break;
+                    case 9: {
+                        int64_t previous = 0;
+                        relation.Packed([&](uint64_t value) { ids.push_back(previous += ZigZagDecode(value)); });
+                        break;
+                    }
+                    case 10:
+                        relation.Packed([&](uint64_t type) {
+                            if (type > PbfBlock::Member::Relation)
+                                Fail();
+                            types.push_back((PbfBlock::Member::Type)type);
+                        });
+                        break;
+                    default: relation.Skip();
+                    }
+                }
+                if (roles.size() != ids.size() || types.size() != ids.size())
+                    Fail();
+                for (size_t i = 0; i < ids.size(); ++i)
+                    decoded.members.push_back({ids[i], types[i], string(roles[i])});
+                decoded.tags = tags(keys, values);
+                break;
+            }
+            default: group.Skip();
+            }
+        }
+    }
+    return block;
+}
+
+// Per block string table; index 0 is reserved for the empty string, which
+// separates the nodes in DenseNodes::keys_vals.
+class StringTable {
+  public:
+    uint32_t Add(std::string_view string) {
+        auto [it, inserted] = m_Index.emplace(string, (uint32_t)m_Strings.size() + 1);
+        if (inserted)
+            m_Strings.push_back(string);
+        return it->second;
+    }
+    void Write(ProtoWriter &block) const {
+        ProtoWriter table;
+        table.Bytes(1, "");
+        for (std::string_view string : m_Strings)
+            table.Bytes(1, string);
+        block.Bytes(1, table.Data());
+    }
+
+  private:
+    std::vector<std::string_view> m_Strings;
+    std::unordered_map<std::string_view, uint32_t> m_Index;
+};
+
+} // namespace
+
+bool IsOsmPbf(const std::byte *data, size_t size)
+{
+    // The first blob header starts with field 1, "OSMHeader".
+    static const char kFirstHeader[] = "\x0a\x09OSMHeader";
+    return size >= 4 + sizeof(kFirstHeader) - 1 && std::memcmp(data + 4, kFirstHeader, sizeof(kFirstHeader) - 1) == 0;
+}
+
+PbfFile ReadOsmPbf(const std::byte *data, size_t size, unsigned threads)
+{
+    TRACE_SCOPE("ReadOsmPbf");
+    PbfFile file;
+    std::vector<std::string_view> blobs;
+    size_t position = 0;
+    while (position < size) {
+        if (size - position < 4)
+            Fail();
+        uint32_t header_size = 0;
+        for (int i = 0; i < 4; ++i)
+            header_size = header_size << 8 | (uint32_t)data[position++];
+        if (header_size > kMaxBlobHeaderSize || header_size > size - position)
+            Fail();
+        ProtoReader header{data + position, header_size};
+        position += header_size;
+        std::string_view type;
+        uint64_t blob_size = 0;
+        while (header.Next()) {
+            if (header.Field() == 1)
+                type = header.Bytes();
+            else if (header.Field() == 3)
+                blob_size = header.Varint();
+            else
+                header.Skip();
+        }
+        if (blob_size > kMaxBlobSize || blob_size > size - position)
+            Fail();
+        std::string_view blob{reinterpret_cast<const char *>(data + position), (size_t)blob_size};
+        position += blob_size;
+        if (type == "OSMHeader")
+            ReadHeaderBlock(Inflate(blob), file);
+        else if (type == "OSMData")
+            blobs.push_back(blob);
+        // Other blob types are skipped, as the format requires.
+    }
+
+    // Blocks differ a lot in size, so threads take the next block as they finish.
+    file.blocks.resize(blobs.size());
+    std::atomic<size_t> next{0};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    threads = std::max(threads, 1u);
+    ParallelFor(threads, [&](size_t, size_t) {
+        for (size_t i; (i = next++) < blobs.size();) {
+            try {
+                file.blocks[i] = DecodeBlock(Inflate(blobs[i]));
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock{error_mutex};
+                if (!error)
+                    error = std::current_exception();
+            }
+        }
+    }, threads);
+    if (error)
+        std::rethrow_exception(error);
+    return file;
+}
+
+std::vector<std::byte> ConvertOsmXmlToPbf(const std::byte *xml, size_t size)
+{
+    pugi::xml_document doc;
+    if (!doc.load_buffer(xml, size))
+        throw std::logic_error("failed to parse the xml file");
+    auto id = [](const pugi::xml_node &node, const char *name = "id") {
+        return (int64_t)std::strtoll(node.attribute(name).as_string(), nullptr, 10);
+    };
+    auto scaled = [](const pugi::xml_node &node, const char *name, double scale) {
+        return (int64_t)std::llround(std::atof(node.attribute(name).as_string()) * scale);
+    };
+
+    std::string out;
+    auto write_blob = [&](std::string_view type, const std::string &content) {
+        uLongf compressed_size = compressBound((uLong)content.size());
+        std::string compressed(compressed_size, '\0');
+        if (compress2(reinterpret_cast<Bytef *>(compressed.data()), &compressed_size,
+                      reinterpret_cast<const Bytef *>(content.data()), (uLong)content.size(), Z_DEFAULT_COMPRESSION) != Z_OK)
+            throw std::logic_error("zlib compression failed");
+        compressed.resize(compressed_size);
+        ProtoWriter blob;
+        blob.Varint(2, content.size());
+        blob.Bytes(3, compressed);
+        ProtoWriter header;
+        header.Bytes(1, type);
+        header.Varint(3, blob.Data().size());
+        const uint32_t header_size = (uint32_t)header.Data().size();
+        for (int shift = 24; shift >= 0; shift -= 8)
+            out.push_back(char(header_size >> shift));
+        out += header.Data();
+        out += blob.Data();
+    };
+
+    ProtoWriter header;
+    if (auto nodes = doc.select_nodes("/osm/bounds"); !nodes.empty()) {
+        const auto bounds = nodes.first().node();
+        ProtoWriter bbox;
+        bbox.SVarint(1, scaled(bounds, "minlon", 1e9));
+        bbox.SVarint(2, scaled(bounds, "maxlon", 1e9));
+        bbox.SVarint(3, scaled(bounds, "maxlat", 1e9));
+        bbox.SVarint(4, scaled(bounds, "minlat", 1e9));
+        header.Bytes(1, bbox.Data());
+    }
+    header.Bytes(4, "OsmSchema-V0.6");
+    header.Bytes(4, "DenseNodes");
+    header.Bytes(16, "route_planning");
+    write_blob("OSMHeader", header.Data());
+
+    // Blocks of up to kEntitiesPerBlock elements of one type, in document order.
+    std::vector<pugi::xml_node> elements;
+    auto flush = [&](const char *type) {
+        if (elements.empty())
+            return;
+        StringTable strings;
+        ProtoWriter group;
+        if (std::strcmp(type, "node") == 0) {
+            std::vector<uint64_t> ids, lats, lons, keys_vals;
+            int64_t last_id = 0, last_lat = 0, last_lon = 0;
+            bool tagged = false;
+            for (const auto &node : elements) {
+                const int64_t node_id = id(node), lat = scaled(node, "lat", 1e7), lon = scaled(node, "lon", 1e7);
+                ids.push_back(ZigZagEncode(node_id - last_id));
+                lats.push_back(ZigZagEncode(lat - last_lat));
+                lons.push_back(ZigZagEncode(lon - last_lon));
+                last_id = node_id;
+                last_lat = lat;
+                last_lon = lon;
+                for (auto tag : node.children()) {
+                    if (std::string_view{tag.name()} != "tag")
+                        continue;
+                    keys_vals.push_back(strings.Add(tag.attribute("k").as_string()));
+                    keys_vals.push_back(strings.Add(tag.attribute("v").as_string()));
+                    tagged = true;
+                }
+                keys_vals.push_back(0);
+            }
+            ProtoWriter dense;
+            dense.Packed(1, ids);
+            dense.Packed(8, lats);
+            dense.Packed(9, lons);
+            if (tagged)
+                dense.Packed(10, keys_vals);
+            group.Bytes(2, dense.Data());
+        }
+        else {
+            const bool is_way = std::strcmp(type, "way") == 0;
+            for (const auto &element : elements) {
+                ProtoWriter message;
+                message.Varint(1, (uint64_t)id(element));
+                std::vector<uint64_t> keys, values, roles, refs, member_types;
+                for (auto tag : element.children()) {
+                    if (std::string_view{tag.name()} != "tag")
+                        continue;
+                    keys.push_back(strings.Add(tag.attribute("k").as_string()));
+                    values.push_back(strings.Add(tag.attribute("v").as_string()));
+                }
+                message.Packed(2, keys);
+                message.Packed(3, values);
+                int64_t last_ref = 0;
+                for (auto child : element.children()) {
+                    if (std::string_view{child.name()} != (is_way ? "nd" : "member"))
+                        continue;
+                    const int64_t ref = id(child, "ref");
+                    refs.push_back(ZigZagEncode(ref - last_ref));
+                    last_ref = ref;
+                    if (!is_way) {
+                        roles.push_back(strings.Add(child.attribute("role").as_string()));
+                        const std::string_view member_type = child.attribute("type").as_string();
+                        member_types.push_back(member_type == "node" ? 0 : member_type == "way" ? 1 : 2);
+                    }
+                }
+                if (is_way)
+                    message.Packed(8, refs);
+                else {
+                    message.Packed(8, roles);
+                    message.Packed(9, refs);
+                    message.Packed(10, member_types);
+                }
+                group.Bytes(is_way ? 3 : 4, message.Data());
+            }
+        }
+        ProtoWriter block;
+        strings.Write(block);
+        block.Bytes(2, group.Data());
+        write_blob("OSMData", block.Data());
+        elements.clear();
+    };
+    for (const char *type : {"node", "way", "relation"}) {
+        for (const auto &element : doc.select_nodes((std::string{"/osm/"} + type).c_str())) {
+            elements.push_back(element.node());
+            if ((int)elements.size() == kEntitiesPerBlock)
+                flush(type);
+        }
+        flush(type);
+    }
+
+    auto bytes = reinterpret_cast<const std::byte *>(out.data());
+    return std::vector<std::byte>(bytes, bytes + out.size());
+}
@@ -0,0 +1,71 @@
+#ifndef OSM_PBF_H
+#define OSM_PBF_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Reader for the OpenStreetMap PBF format: a sequence of blobs, each holding a
+// zlib-compressed protobuf block (https://wiki.openstreetmap.org/wiki/PBF_Format).
+// Blocks are independent, so they are inflated and decoded in parallel; the
+// Model then consumes them in file order, exactly like the XML elements.
+
+struct PbfTag {
+    std::string_view key;
+    std::string_view value;
+};
+
+// One decoded PrimitiveBlock. Strings point into `strings`.
+struct PbfBlock {
+    struct Node {
+        int64_t id;
+        double lat;
+        double lon;
+    };
+    struct Way {
+        int64_t id;
+        std::vector<int64_t> refs;
+        std::vector<PbfTag> tags;
+    };
+    struct Member {
+        enum Type { Node, Way, Relation };
+        int64_t ref;
+        Type type;
+        std::string_view role;
+    };
+    struct Relation {
+        int64_t id;
+        std::vector<Member> members;
+        std::vector<PbfTag> tags;
+    };
+
+    std::vector<std::byte> strings;
+    std::vector<Node> nodes;
+    std::vector<Way> ways;
+    std::vector<Relation> relations;
+};
+
+struct PbfFile {
+    bool has_bounds = false;
+    double min_lat = 0.;
+    double max_lat = 0.;
+    double min_lon = 0.;
+    double max_lon = 0.;
+    std::vector<PbfBlock> blocks; // in file order
+};
+
+// True if `data` starts like a PBF file (a blob header) rather than XML.
+bool IsOsmPbf(const std::byte *data, size_t size);
+
+// Decodes every data block on up to `threads` threads. Throws std::logic_error
+// on malformed input or on features this reader doesn't support (compression
+// other than zlib, history files).
+PbfFile ReadOsmPbf(const std::byte *data, size_t size, unsigned threads = std::thread::hardware_concurrency());
+
+// Converts an OSM XML file to PBF with dense nodes and without metadata, so the
+// tests and benchmarks can compare both formats on the same extract.
+std::vector<std::byte> ConvertOsmXmlToPbf(const std::byte *xml, size_t size);
+
+#endif
@@ -0,0 +1,251 @@
+#include "partition_overlay.h"
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include "trace.h"
+#include "worker_pool.h"
+
+static constexpr float kInfinity = std::numeric_limits<float>::infinity();
+
+PartitionOverlay::PartitionOverlay(const RouteGraph &graph, const std::vector<int> &cell_sizes) : m_Graph(graph)
+{
+    TRACE_SCOPE("PartitionOverlay::PartitionOverlay");
+    const int num_nodes = graph.NumNodes();
+    const int num_levels = (int)cell_sizes.size();
+    m_Levels.resize(num_levels);
+    for (auto &level : m_Levels)
+        level.cell.assign(num_nodes, -1);
+
+    std::vector<int> nodes;
+    for (int node = 0; node < num_nodes; ++node)
+        if (graph.Degree(node) > 0)
+            nodes.push_back(node);
+
+    // Top-down bisection at the median of the longer side of the bounding box.
+    // A range becomes a cell of every level whose size limit it fits, which
+    // nests the cells of each level inside those of the level above.
+    std::function<void(std::vector<int>::iterator, std::vector<int>::iterator, int)> split =
+        [&](std::vector<int>::iterator first, std::vector<int>::iterator last, int level) {
+            if (level < 0 || first == last)
+                return;
+            if (last - first <= cell_sizes[level]) {
+                const int cell = m_Levels[level].num_cells++;
+                for (auto it = first; it != last; ++it)
+                    m_Levels[level].cell[*it] = cell;
+                split(first, last, level - 1);
+                return;
+            }
+            double min_x = kInfinity, min_y = kInfinity, max_x = -kInfinity, max_y = -kInfinity;
+            for (auto it = first; it != last; ++it) {
+                const auto coord = graph.Coord(*it);
+                min_x = std::min(min_x, coord.x);
+                max_x = std::max(max_x, coord.x);
+                min_y = std::min(min_y, coord.y);
+                max_y = std::max(max_y, coord.y);
+            }
+            const bool by_x = max_x - min_x >= max_y - min_y;
+            const auto middle = first + (last - first) / 2;
+            std::nth_element(first, middle, last, [&](int a, int b) {
+                return by_x ? graph.Coord(a).x < graph.Coord(b).x : graph.Coord(a).y < graph.Coord(b).y;
+            });
+            split(first, middle, level);
+            split(middle, last, level);
+        };
+    split(nodes.begin(), nodes.end(), num_levels - 1);
+    while (!m_Levels.empty() && m_Levels.back().num_cells <= 1)
+        m_Levels.pop_back();
+
+    // Boundary nodes have an arc into another cell of the same level.
+    for (auto &level : m_Levels) {
+        level.boundary_index.assign(num_nodes, -1);
+        std::vector<std::vector<int>> boundary(level.num_cells);
+        for (int node : nodes)
+            for (int arc = graph.FirstArc(node); arc < graph.LastArc(node); ++arc)
+                if (level.cell[graph.Head(arc)] != level.cell[node]) {
+                    auto &cell_boundary = boundary[level.cell[node]];
+                    level.boundary_index[node] = (int)cell_boundary.size();
+                    cell_boundary.push_back(node);
+                    break;
+                }
+        level.boundary_offsets.push_back(0);
+        level.matrix_offsets.push_back(0);
+        for (const auto &cell_boundary : boundary) {
+            level.boundary.insert(level.boundary.end(), cell_boundary.begin(), cell_boundary.end());
+            level.boundary_offsets.push_back((int)level.boundary.size());
+            level.matrix_offsets.push_back(level.matrix_offsets.back() + cell_boundary.size() * cell_boundary.size());
+        }
+    }
+}
+
+size_t PartitionOverlay::NumShortcuts() const
+{
+    size_t shortcuts = 0;
+    for (const auto &level : m_Levels)
+        shortcuts += level.matrix_offsets.back();
+    return shortcuts;
+}
+
+template <typename F>
+void PartitionOverlay::ForEachArc(int level, int node, F &&f) const
+{
+    if (level >= 0) {
+        const Level &overlay = m_Levels[level];
+        const int row = overlay.boundary_index[node];
+        if (row >= 0) {
+            const int cell = overlay.cell[node];
+            const int first = overlay.boundary_offsets[cell], size = overlay.boundary_offsets[cell + 1] - first;
+            const float *costs = overlay.matrices.data() + overlay.matrix_offsets[cell] + (size_t)row * size;
+            for (int j = 0; j < size; ++j)
+                if (j != row && costs[j] < kInfinity)
+                    f(overlay.boundary[first + j], costs[j], -1);
+        }
+    }
+    for (int arc = m_Graph.FirstArc(node); arc < m_Graph.LastArc(node); ++arc) {
+        const float cost = m_Graph.Cost(arc);
+        const int head = m_Graph.Head(arc);
+        if (cost == kInfinity || (level >= 0 && m_Levels[level].cell[head] == m_Levels[level].cell[node]))
+            continue;
+        f(head, cost, arc);
+    }
+}
+
+int PartitionOverlay::QueryLevel(int node, int source, int target) const
+{
+    for (int level = NumLevels() - 1; level >= 0; --level) {
+        const auto &cell = m_Levels[level].cell;
+        if (cell[node] != cell[source] && cell[node] != cell[target])
+            return level;
+    }
+    return -1;
+}
+
+void PartitionOverlay::CellSearch(SearchWorkspace &workspace, int level, int source, int target) const
+{
+    const auto &cell = m_Levels[level].cell;
+    const int source_cell = cell[source];
+    workspace.Prepare(m_Graph.NumNodes());
+    auto &heap = workspace.Heap();
+    workspace.Relax(source, 0.f, -1, 0);
+    heap.push_back({0.f, 0.f, source});
+    while (!heap.empty()) {
+        const auto top = heap.front();
+        std::pop_heap(heap.begin(), heap.end(), std::greater<SearchWorkspace::HeapEntry>());
+        heap.pop_back();
+        if (top.g > workspace.G(top.node))
+            continue;
+        if (top.node == target)
+            return;
+        ForEachArc(level - 1, top.node, [&](int head, float cost, int arc) {
+            const float g = top.g + cost;
+            if (cell[head] == source_cell && g < workspace.G(head)) {
+                // Shortcuts store the node they leave from, encoded below -1.
+                workspace.Relax(head, g, arc >= 0 ? arc : -2 - top.node, 0);
+                heap.push_back({g, g, head});
+                std::push_heap(heap.begin(), heap.end(), std::greater<SearchWorkspace::HeapEntry>());
+            }
+        });
+    }
+}
+
+void PartitionOverlay::Customize(unsigned threads)
+{
+    TRACE_SCOPE("PartitionOverlay::Customize");
+    // Every level needs the matrices of the level below; cells of one level are independent.
+    for (int l = 0; l < NumLevels(); ++l) {
+        Level &level = m_Levels[l];
+        level.matrices.assign(level.matrix_offsets.back(), kInfinity);
+        std::atomic<int> next{0};
+        ParallelFor(std::max(threads, 1u), [&](size_t, size_t) {
+            SearchWorkspace workspace;
+            for (int cell; (cell = next++) < level.num_cells;) {
+                const int first = level.boundary_offsets[cell], size = level.boundary_offsets[cell + 1] - first;
+                float *matrix = level.matrices.data() + level.matrix_offsets[cell];
+                for (int i = 0; i < size; ++i) {
+                    CellSearch(workspace, l, level.boundary[first + i]);
+                    for (int j = 0; j < size; ++j)
+                        matrix[(size_t)i * size + j] = workspace.G(level.boundary[first + j]);
+                }
+            }
+        }, std::max(threads, 1u));
+    }
+    m_Customized = true;
+    m_CustomizedChanges = m_Graph.Changes().size();
+}
+
+std::vector<PartitionOverlay::Hop> PartitionOverlay::Hops(const SearchWorkspace &workspace, int node) const
+{
+    std::vector<Hop> hops;
+    for (int parent; (parent = workspace.ParentArc(node)) != -1;) {
+        const int from = parent >= 0 ? m_Graph.Head(m_Graph.ReverseArc(parent)) : -2 - parent;
+        hops.push_back({from, node, parent >= 0 ? parent : -1});
+        node = from;
+    }
+    std::reverse(hops.begin(), hops.end());
+    return hops;
+}
+
+void PartitionOverlay::AppendShortcut(SearchWorkspace &workspace, int level, int from, int to, std::vector<int> &out) const
+{
+    // Repeats the search that computed the shortcut and unpacks the shortcuts it used in turn.
+    CellSearch(workspace, level, from, to);
+    for (const Hop &hop : Hops(workspace, to)) {
+        if (hop.arc >= 0)
+            out.push_back(hop.to);
+        else
+            AppendShortcut(workspace, level - 1, hop.from, hop.to, out);
+    }
+}
+
+RoutePath PartitionOverlay::ShortestPath(SearchWorkspace &workspace, int source, int target, SearchResult *result) const
+{
+    SearchResult search;
+    workspace.Prepare(m_Graph.NumNodes());
+    auto &heap = workspace.Heap();
+    auto push = [&](float g, int node) {
+        heap.push_back({g + m_Graph.Distance(node, target), g, node});
+        std::push_heap(heap.begin(), heap.end(), std::greater<SearchWorkspace::HeapEntry>());
+    };
+    workspace.Relax(source, 0.f, -1, 0);
+    push(0.f, source);
+    while (!heap.empty()) {
+        const auto top = heap.front();
+        std::pop_heap(heap.begin(), heap.end(), std::greater<SearchWorkspace::HeapEntry>());
+        heap.pop_back();
+        if (top.g > workspace.G(top.node))
+            continue;
+        if (top.node == target) {
+            search.cost = top.g;
+            search.target = 0;
+            break;
+        }
+        search.expanded++;
+        ForEachArc(QueryLevel(top.node, source, target), top.node, [&](int head, float cost, int arc) {
+            const float g = top.g + cost;
+            if (g < workspace.G(head)) {
+                workspace.Relax(head, g, arc >= 0 ? arc : -2 - top.node, 0);
+                push(g, head);
+            }
+        });
+    }
+    search.status = search.Found() ? SearchStatus::Found : SearchStatus::NoRoute;
+
+    RoutePath path;
+    if (search.Found()) {
+        path.nodes.push_back(source);
+        for (const Hop &hop : Hops(workspace, target)) {
+            if (hop.arc >= 0)
+                path.nodes.push_back(hop.to);
+            else
+                AppendShortcut(workspace, QueryLevel(hop.from, source, target), hop.from, hop.to, path.nodes);
+        }
+        float distance = 0.f;
+        for (size_t i = 0; i < path.nodes.size(); ++i) {
+            if (i > 0)
+                distance += m_Graph.Distance(path.nodes[i - 1], path.nodes[i]);
+            path.distances.push_back(distance * (float)m_Graph.MetricScale());
+        }
+    }
+    if (result)
+        *result = search;
+    return path;
+}
@@ -0,0 +1,80 @@
+#ifndef PARTITION_OVERLAY_H
+#define PARTITION_OVERLAY_H
+
+#include <thread>
+#include <vector>
+#include "graph_search.h"
+#include "route_graph.h"
+
+// Customizable route planning (Delling, Goldberg, Pajor & Werneck) over a
+// RouteGraph.
+//
+// The routable nodes are split once into nested cells by recursive coordinate
+// bisection: every level-0 cell holds at most cell_sizes[0] nodes and lies
+// inside one level-1 cell, and so on. The partition only depends on the
+// topology. Customize() then computes, for the current arc costs, the shortest
+// distances between the boundary nodes of every cell, each level on top of the
+// one below and the cells of one level in parallel. Queries run A* over the
+// overlay: base arcs in the cells of the source and target, and the shortcuts of
+// the largest cells containing neither everywhere else.
+//
+// After edge costs change, Current() turns false and Customize() must run
+// again before querying; the partition is kept.
+class PartitionOverlay {
+  public:
+    explicit PartitionOverlay(const RouteGraph &graph, const std::vector<int> &cell_sizes = {256, 4096, 65536});
+
+    // Levels with a single cell are dropped, so this can be less than requested.
+    int NumLevels() const { return (int)m_Levels.size(); }
+    int NumCells(int level) const { return m_Levels[level].num_cells; }
+    // Cell of `node` at `level`, or -1 for nodes without arcs.
+    int Cell(int level, int node) const { return m_Levels[level].cell[node]; }
+    int NumBoundaryNodes(int level) const { return (int)m_Levels[level].boundary.size(); }
+    size_t NumShortcuts() const;
+
+    // Computes the shortcut matrices for the current arc costs of the graph.
+    void Customize(unsigned threads = std::thread::hardware_concurrency());
+    // True once customized and no arc cost changed since.
+    bool Current() const { return m_Customized && m_Graph.Changes().size() == m_CustomizedChanges; }
+
+    // Shortest path between two graph nodes, unpacked to graph nodes.
+    RoutePath ShortestPath(SearchWorkspace &workspace, int source, int target, SearchResult *result = nullptr) const;
+
+  private:
+    struct Level {
+        int num_cells = 0;
+        std::vector<int> cell;              // per node
+        std::vector<int> boundary_index;    // per node: row in the matrix of its cell, or -1
+        std::vector<int> boundary_offsets;  // per cell, into boundary
+        std::vector<int> boundary;          // boundary nodes grouped by cell
+        std::vector<size_t> matrix_offsets; // per cell, into matrices
+        std::vector<float> matrices;        // one row-major square matrix per cell
+    };
+
+    struct Hop {
+        int from;
+        int to;
+        int arc; // graph arc, or -1 for a shortcut
+    };
+
+    // Calls f(head, cost, arc) for the arcs leaving `node` in the overlay of
+    // `level`: the shortcuts of its cell and the graph arcs leaving that cell.
+    // Level -1 is the graph itself; shortcuts pass -1 as arc.
+    template <typename F>
+    void ForEachArc(int level, int node, F &&f) const;
+    // Highest level at which `node` is in neither the cell of `source` nor of `target`, or -1.
+    int QueryLevel(int node, int source, int target) const;
+    // Dijkstra from `source` within its cell at `level`, over the overlay of the
+    // level below; stops once `target` is settled, if given.
+    void CellSearch(SearchWorkspace &workspace, int level, int source, int target = -1) const;
+    // Hops from the search source to `node`, in travel order.
+    std::vector<Hop> Hops(const SearchWorkspace &workspace, int node) const;
+    void AppendShortcut(SearchWorkspace &workspace, int level, int from, int to, std::vector<int> &out) const;
+
+    const RouteGraph &m_Graph;
+    std::vector<Level> m_Levels;
+    bool m_Customized = false;
+    size_t m_CustomizedChanges = 0;
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef PATH_CHANNEL_H
+#define PATH_CHANNEL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include "route_path.h"
+
+// Hands routes from a running search to a consumer on another thread, e.g.
+// partial routes for drawing while the search goes on. Only the latest route
+// is kept: a consumer slower than the search skips the ones in between, and
+// the search never waits for the consumer.
+class PathChannel {
+  public:
+    virtual ~PathChannel() = default;
+
+    // Replaces the pending route. `complete` marks a route that reaches the
+    // destination. Runs on the producer's thread; overriders see every route,
+    // e.g. to record them in tests.
+    virtual void Publish(const RoutePath &path, bool complete) {
+        {
+            std::lock_guard<std::mutex> lock{m_Mutex};
+            m_Pending.nodes.assign(path.nodes.begin(), path.nodes.end());
+            m_Pending.distances.assign(path.distances.begin(), path.distances.end());
+            m_Complete = complete;
+            m_HasPending = true;
+        }
+        m_Condition.notify_all();
+    }
+
+    // Called by the producer once it publishes nothing more.
+    void Close() {
+        {
+            std::lock_guard<std::mutex> lock{m_Mutex};
+            m_Closed = true;
+        }
+        m_Condition.notify_all();
+    }
+
+    // Closed and every route taken.
+    bool Done() const {
+        std::lock_guard<std::mutex> lock{m_Mutex};
+        return m_Closed && !m_HasPending;
+    }
+
+    // Takes the route published since the last call, if any; the storage of
+    // `path` is reused for later routes.
+    bool TryReceive(RoutePath &path, bool &complete) {
+        std::lock_guard<std::mutex> lock{m_Mutex};
+        return Take(path, complete);
+    }
+
+    // Same, waiting up to `timeout` for a route; returns false on timeout or
+    // once the channel is closed and drained.
+    template <typename Rep, typename Period>
+    bool Receive(RoutePath &path, bool &complete, std::chrono::duration<Rep, Period> timeout) {
+        std::unique_lock<std::mutex> lock{m_Mutex};
+        m_Condition.wait_for(lock, timeout, [this] { return m_HasPending || m_Closed; });
+        return Take(path, complete);
+    }
+
+  private:
+    bool Take(RoutePath &path, bool &complete) {
+        if (!m_HasPending)
+            return false;
+        std::swap(path, m_Pending);
+        complete = m_Complete;
+        m_HasPending = false;
+        return true;
+    }
+
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    RoutePath m_Pending;
+    bool m_Complete = false;
+    bool m_HasPending = false;
+    bool m_Closed = false;
+};
+
+#endif
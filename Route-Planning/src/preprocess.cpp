@@ -0,0 +1,259 @@
+#include "preprocess.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <tuple>
+#include "mapped_file.h"
+#include "worker_pool.h"
+
+namespace {
+
+const char kMagic[8] = {'R', 'P', 'P', 'R', 'E', 'P', '0', '1'};
+constexpr uint32_t kVersion = 1;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t section_count;
+    uint64_t source_size;
+    uint64_t source_checksum;
+    uint32_t num_nodes;
+    uint32_t num_arcs;
+};
+
+struct SectionEntry {
+    char name[16];
+    uint64_t offset;
+    uint64_t size;
+    uint64_t checksum;
+};
+
+// 64-bit FNV-1a.
+uint64_t Checksum(const void *data, size_t size)
+{
+    auto bytes = static_cast<const unsigned char *>(data);
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+struct Section {
+    std::string name;
+    const void *data;
+    size_t size;
+};
+
+double Millis(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+std::string PreprocessedPath(const std::string &osm_path)
+{
+    return osm_path + ".prep";
+}
+
+// Results of the preprocessing stages with what the header records about the source.
+struct Computed {
+    Preprocessed preprocessed;
+    uint64_t source_size = 0;
+    uint64_t source_checksum = 0;
+};
+
+// Runs the preprocessing stages concurrently.
+static Computed Compute(const RouteGraph &graph, const std::string &osm_path, const PreprocessOptions &options,
+                        std::ostream &log)
+{
+    const auto started = std::chrono::steady_clock::now();
+    // The stages are independent; the landmark stage also fans out internally.
+    WorkerPool pool{3};
+    std::mutex log_mutex;
+    auto report = [&](const std::string &stage, std::chrono::steady_clock::time_point start) {
+        const double ms = Millis(start);
+        std::lock_guard<std::mutex> lock{log_mutex};
+        log << "  " << stage << ": " << ms << " ms\n";
+    };
+    auto source = pool.Submit([&] {
+        const auto start = std::chrono::steady_clock::now();
+        MappedFile file{osm_path};
+        std::pair<uint64_t, uint64_t> result{file.Size(), file.Valid() ? Checksum(file.Data(), file.Size()) : 0};
+        report("source checksum", start);
+        return result;
+    });
+    auto landmarks = pool.Submit([&] {
+        const auto start = std::chrono::steady_clock::now();
+        Landmarks result = Landmarks::Compute(graph, options.landmarks, options.threads);
+        report("landmarks (" + std::to_string(result.Count()) + ")", start);
+        return result;
+    });
+    auto chains = pool.Submit([&] {
+        const auto start = std::chrono::steady_clock::now();
+        auto result = std::make_unique<ChainGraph>(graph);
+        report("chain compression", start);
+        return result;
+    });
+
+    Computed result;
+    std::tie(result.source_size, result.source_checksum) = source.get();
+    result.preprocessed.landmarks = landmarks.get();
+    result.preprocessed.chains = chains.get();
+    log << "Preprocessing took " << Millis(started) << " ms" << std::endl;
+    return result;
+}
+
+// Stores computed results in the artifact for `osm_path`; false, with the
+// reason in `log`, when it can't be written.
+static bool Write(const RouteGraph &graph, const std::string &osm_path, const Computed &computed, std::ostream &log)
+{
+    const Landmarks &l = computed.preprocessed.landmarks;
+    const std::vector<bool> kept_flags = computed.preprocessed.chains->KeptNodes();
+    std::vector<uint8_t> kept(kept_flags.begin(), kept_flags.end());
+    const size_t table_size = (size_t)l.Count() * l.NumNodes() * sizeof(float);
+    const std::vector<Section> sections = {
+        {"landmark_ids", l.Ids().data(), l.Ids().size() * sizeof(int)},
+        {"landmark_from", l.From(), table_size},
+        {"landmark_to", l.To(), table_size},
+        {"chain_kept", kept.data(), kept.size()},
+    };
+
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.section_count = (uint32_t)sections.size();
+    header.source_size = computed.source_size;
+    header.source_checksum = computed.source_checksum;
+    header.num_nodes = (uint32_t)graph.NumNodes();
+    header.num_arcs = (uint32_t)graph.NumArcs();
+
+    std::vector<SectionEntry> entries(sections.size());
+    uint64_t offset = sizeof(Header) + entries.size() * sizeof(SectionEntry);
+    for (size_t i = 0; i < sections.size(); ++i) {
+        offset = (offset + 7) & ~uint64_t{7}; // keep the tables aligned for in-place use
+        std::strncpy(entries[i].name, sections[i].name.c_str(), sizeof(entries[i].name) - 1);
+        entries[i].offset = offset;
+        entries[i].size = sections[i].size;
+        entries[i].checksum = Checksum(sections[i].data, sections[i].size);
+        offset += sections[i].size;
+    }
+
+    // Write to a temporary file first so a crash never leaves a half written artifact.
+    const std::string path = PreprocessedPath(osm_path), temporary = path + ".tmp";
+    {
+        std::ofstream os{temporary, std::ios::binary | std::ios::trunc};
+        os.write((const char *)&header, sizeof(header));
+        os.write((const char *)entries.data(), entries.size() * sizeof(SectionEntry));
+        uint64_t written = sizeof(Header) + entries.size() * sizeof(SectionEntry);
+        for (size_t i = 0; i < sections.size(); ++i) {
+            static const char padding[8] = {};
+            os.write(padding, entries[i].offset - written);
+            os.write((const char *)sections[i].data, sections[i].size);
+            written = entries[i].offset + sections[i].size;
+        }
+        if (!os) {
+            log << "Failed to write " << temporary << std::endl;
+            return false;
+        }
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        log << "Failed to replace " << path << std::endl;
+        return false;
+    }
+    log << "Wrote " << path << " (" << offset / 1024 << " KB)" << std::endl;
+    return true;
+}
+
+std::optional<Preprocessed> Preprocess(const RouteGraph &graph, const std::string &osm_path,
+                                       const PreprocessOptions &options, std::ostream &log)
+{
+    Computed computed = Compute(graph, osm_path, options, log);
+    if (!Write(graph, osm_path, computed, log))
+        return std::nullopt;
+    return std::move(computed.preprocessed);
+}
+
+std::optional<Preprocessed> LoadPreprocessed(const RouteGraph &graph, const std::string &osm_path, std::string *why)
+{
+    auto fail = [&](const char *reason) -> std::optional<Preprocessed> {
+        if (why)
+            *why = reason;
+        return std::nullopt;
+    };
+
+    auto file = std::make_shared<MappedFile>(PreprocessedPath(osm_path));
+    if (!file->Valid())
+        return fail("missing");
+    if (file->Size() < sizeof(Header))
+        return fail("truncated");
+    Header header;
+    std::memcpy(&header, file->Data(), sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion)
+        return fail("unknown format");
+    if (header.num_nodes != (uint32_t)graph.NumNodes() || header.num_arcs != (uint32_t)graph.NumArcs())
+        return fail("stale: routing graph changed");
+    {
+        MappedFile source{osm_path};
+        if (!source.Valid() || source.Size() != header.source_size ||
+            Checksum(source.Data(), source.Size()) != header.source_checksum)
+            return fail("stale: map file changed");
+    }
+
+    const uint64_t table_end = sizeof(Header) + (uint64_t)header.section_count * sizeof(SectionEntry);
+    if (file->Size() < table_end)
+        return fail("truncated");
+    auto entries = reinterpret_cast<const SectionEntry *>(file->Data() + sizeof(Header));
+    auto find = [&](const char *name, size_t size, size_t alignment) -> const std::byte * {
+        for (uint32_t i = 0; i < header.section_count; ++i) {
+            const SectionEntry &entry = entries[i];
+            if (std::strncmp(entry.name, name, sizeof(entry.name)) != 0)
+                continue;
+            if (entry.size != size || entry.offset % alignment != 0 || entry.offset + entry.size > file->Size() ||
+                Checksum(file->Data() + entry.offset, entry.size) != entry.checksum)
+                return nullptr;
+            return file->Data() + entry.offset;
+        }
+        return nullptr;
+    };
+
+    const int num_nodes = graph.NumNodes();
+    const SectionEntry *ids_entry = nullptr;
+    for (uint32_t i = 0; i < header.section_count; ++i)
+        if (std::strncmp(entries[i].name, "landmark_ids", sizeof(entries[i].name)) == 0)
+            ids_entry = &entries[i];
+    if (!ids_entry)
+        return fail("corrupt: no landmarks");
+    const size_t count = ids_entry->size / sizeof(int);
+    const size_t table_size = count * num_nodes * sizeof(float);
+    auto ids = reinterpret_cast<const int *>(find("landmark_ids", count * sizeof(int), alignof(int)));
+    auto from = reinterpret_cast<const float *>(find("landmark_from", table_size, alignof(float)));
+    auto to = reinterpret_cast<const float *>(find("landmark_to", table_size, alignof(float)));
+    auto kept = reinterpret_cast<const uint8_t *>(find("chain_kept", num_nodes, 1));
+    if (!ids || !from || !to || !kept)
+        return fail("corrupt: checksum mismatch");
+
+    Preprocessed result;
+    result.landmarks = Landmarks{std::vector<int>(ids, ids + count), num_nodes, from, to, file};
+    result.chains = std::make_unique<ChainGraph>(graph, std::vector<bool>(kept, kept + num_nodes));
+    result.loaded = true;
+    return result;
+}
+
+Preprocessed LoadOrPreprocess(const RouteGraph &graph, const std::string &osm_path,
+                              const PreprocessOptions &options, std::ostream &log)
+{
+    std::string why;
+    if (auto loaded = LoadPreprocessed(graph, osm_path, &why))
+        return std::move(*loaded);
+    log << "Preprocessed data for " << osm_path << " is " << why << "; recomputing." << std::endl;
+    // Computed once; without a writable location the results are used from memory.
+    Computed computed = Compute(graph, osm_path, options, log);
+    Write(graph, osm_path, computed, log);
+    return std::move(computed.preprocessed);
+}
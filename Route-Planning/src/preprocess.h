@@ -0,0 +1,49 @@
+#ifndef PREPROCESS_H
+#define PREPROCESS_H
+
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <thread>
+#include "chain_graph.h"
+#include "landmarks.h"
+#include "route_graph.h"
+
+// Routing preprocessing that is computed once per map and persisted next to the
+// .osm file as `<map>.osm.prep`.
+//
+// The artifact starts with a header recording the size and checksum of the
+// source map and the size of the routing graph, followed by a table of named
+// sections, each with its own checksum. Loading maps the file and uses the
+// landmark tables in place; any mismatch marks the artifact as stale.
+struct PreprocessOptions {
+    int landmarks = 16;
+    unsigned threads = std::thread::hardware_concurrency();
+};
+
+struct Preprocessed {
+    Landmarks landmarks;
+    std::unique_ptr<ChainGraph> chains;
+    // True when read from the artifact, false when computed in this process.
+    bool loaded = false;
+};
+
+std::string PreprocessedPath(const std::string &osm_path);
+
+// Runs the preprocessing stages concurrently and writes the artifact. Stage
+// timings are reported to `log`. Returns nullopt if the artifact can't be written.
+std::optional<Preprocessed> Preprocess(const RouteGraph &graph, const std::string &osm_path,
+                                       const PreprocessOptions &options, std::ostream &log);
+
+// Maps and validates the artifact for `osm_path`. Returns nullopt, with the
+// reason in `why`, when it is missing, stale or corrupt.
+std::optional<Preprocessed> LoadPreprocessed(const RouteGraph &graph, const std::string &osm_path,
+                                             std::string *why = nullptr);
+
+// Loads the artifact, or recomputes and rewrites it when that fails. Without a
+// writable location the results are still returned.
+Preprocessed LoadOrPreprocess(const RouteGraph &graph, const std::string &osm_path,
+                              const PreprocessOptions &options, std::ostream &log);
+
+#endif
@@ -0,0 +1,65 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include "mapped_file.h"
+#include "preprocess.h"
+#include "route_model.h"
+
+// rp_preprocess: computes the routing preprocessing for a map once and stores
+// it next to the .osm file, where LoadPreprocessed() picks it up.
+
+static void PrintUsage()
+{
+    std::cout << "Usage: rp_preprocess [-f filename.osm] [-l landmarks] [-j threads] [--check]" << std::endl;
+    std::cout << "Writes filename.osm.prep; --check only validates an existing artifact." << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+    std::string osm_data_file = "../map.osm";
+    PreprocessOptions options;
+    bool check = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg{argv[i]};
+        if (arg == "-f" && i + 1 < argc)
+            osm_data_file = argv[++i];
+        else if (arg == "-l" && i + 1 < argc)
+            options.landmarks = std::atoi(argv[++i]);
+        else if (arg == "-j" && i + 1 < argc)
+            options.threads = (unsigned)std::atoi(argv[++i]);
+        else if (arg == "--check")
+            check = true;
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    MappedFile file{osm_data_file};
+    if (!file.Valid())
+    {
+        std::cerr << "Failed to read " << osm_data_file << std::endl;
+        return 1;
+    }
+    RouteModel model{std::move(file)};
+    const RouteGraph &graph = model.Graph();
+    std::cout << "Map: " << graph.NumNodes() << " nodes, " << graph.NumArcs() << " arcs" << std::endl;
+
+    if (check)
+    {
+        std::string why;
+        if (LoadPreprocessed(graph, osm_data_file, &why))
+        {
+            std::cout << PreprocessedPath(osm_data_file) << " is up to date" << std::endl;
+            return 0;
+        }
+        std::cout << PreprocessedPath(osm_data_file) << " is " << why << std::endl;
+        return 2;
+    }
+
+    auto result = Preprocess(graph, osm_data_file, options, std::cout);
+    return result ? 0 : 1;
+}
@@ -0,0 +1,182 @@
+#include "projection.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "worker_pool.h"
+
+static const auto pi = 3.14159265358979323846264338327950288;
+static const auto deg_to_rad = 2. * pi / 360.;
+static const auto earth_radius = 6378137.;
+
+// The latitude range is split into pieces of at most kPieceDegrees, each fitted
+// with a polynomial of kDegree; for a piece of one degree this is accurate to
+// well below a micrometer outside polar regions.
+static constexpr int kDegree = 6;
+static constexpr double kPieceDegrees = 1.;
+// Largest accepted deviation of the fit from MercatorY, in meters.
+static constexpr double kTolerance = 1e-6;
+// Below this many nodes threads cost more than they save.
+static constexpr size_t kMinNodesPerThread = 1 << 15;
+
+double MercatorX(double lon)
+{
+    return lon * deg_to_rad / 2 * earth_radius;
+}
+
+double MercatorY(double lat)
+{
+    return std::log(std::tan(lat * deg_to_rad / 2 + pi / 4)) / 2 * earth_radius;
+}
+
+namespace {
+
+// Piecewise polynomial fit of (MercatorY(lat) - origin) / scale on [low, high]:
+// Chebyshev interpolation per piece, evaluated in powers of t.
+class LatitudeFit {
+  public:
+    LatitudeFit(double low, double high, double origin, double scale)
+        : m_Low(low), m_Pieces(std::max(1, (int)std::ceil((high - low) / kPieceDegrees)))
+    {
+        m_PieceWidth = (high - low) / m_Pieces;
+        m_InversePieceWidth = 1 / m_PieceWidth;
+        m_InverseHalfWidth = 2 / m_PieceWidth;
+        m_Coefficients.resize(m_Pieces);
+        for (int piece = 0; piece < m_Pieces; ++piece) {
+            const double center = low + (piece + 0.5) * m_PieceWidth;
+            std::array<double, kDegree + 1> values;
+            for (int j = 0; j <= kDegree; ++j) {
+                const double theta = pi * (j + 0.5) / (kDegree + 1);
+                values[j] = (MercatorY(center + std::cos(theta) / m_InverseHalfWidth) - origin) / scale;
+            }
+            auto &coefficients = m_Coefficients[piece];
+            for (int k = 0; k <= kDegree; ++k) {
+                double sum = 0.;
+                for (int j = 0; j <= kDegree; ++j)
+                    sum += values[j] * std::cos(pi * k * (j + 0.5) / (kDegree + 1));
+                coefficients[k] = sum * 2 / (kDegree + 1);
+            }
+            coefficients[0] /= 2;
+            coefficients = ToMonomial(coefficients);
+        }
+    }
+
+    double operator()(double lat) const
+    {
+        return Evaluate(lat, m_Low, m_InversePieceWidth, m_Pieces - 1, m_Coefficients.data());
+    }
+
+    // Projects nodes[0, count), x affine and y through the fit.
+    void Project(Model::Node *nodes, size_t count, double x_factor, double x_offset) const
+    {
+        const double low = m_Low, inverse_width = m_InversePieceWidth;
+        const int last = m_Pieces - 1;
+        const auto *coefficients = m_Coefficients.data();
+        for (size_t i = 0; i < count; ++i) {
+            const double x = nodes[i].x * x_factor + x_offset;
+            const double y = Evaluate(nodes[i].y, low, inverse_width, last, coefficients);
+            nodes[i].x = x;
+            nodes[i].y = y;
+        }
+    }
+
+    // Sample points spread over every piece, for checking the fit.
+    template <typename F>
+    bool All(F &&predicate) const
+    {
+        for (int piece = 0; piece < m_Pieces; ++piece)
+            for (int i = 0; i <= 4 * kDegree; ++i)
+                if (!predicate(m_Low + (piece + (double)i / (4 * kDegree)) * m_PieceWidth))
+                    return false;
+        return true;
+    }
+
+  private:
+    using Coefficients = std::array<double, kDegree + 1>;
+
+    // Rewrites a Chebyshev series in powers of t; well conditioned at this degree.
+    static Coefficients ToMonomial(const Coefficients &chebyshev)
+    {
+        Coefficients monomial{}, previous{}, current{};
+        previous[0] = 1.;  // T0
+        current[1] = 1.;   // T1
+        for (int k = 0; k <= kDegree; ++k) {
+            const Coefficients &term = k == 0 ? previous : current;
+            for (int j = 0; j <= kDegree; ++j)
+                monomial[j] += chebyshev[k] * term[j];
+            if (k == 0)
+                continue;
+            // T(k+1) = 2t T(k) - T(k-1)
+            Coefficients next{};
+            for (int j = 0; j < kDegree; ++j)
+                next[j + 1] = 2 * current[j];
+            for (int j = 0; j <= kDegree; ++j)
+                next[j] -= previous[j];
+            previous = current;
+            current = next;
+        }
+        return monomial;
+    }
+
+    // Horner's scheme with a fixed trip count, so it unrolls completely.
+    static double Evaluate(double lat, double low, double inverse_width, int last, const Coefficients *coefficients)
+    {
+        const double position = (lat - low) * inverse_width;
+        const int piece = std::clamp((int)position, 0, last);
+        const double t = (position - piece) * 2 - 1;
+        const Coefficients &c = coefficients[piece];
+        double y = c[kDegree];
+        for (int k = kDegree - 1; k >= 0; --k)
+            y = y * t + c[k];
+        return y;
+    }
+
+    double m_Low;
+    int m_Pieces;
+    double m_PieceWidth;
+    double m_InversePieceWidth;
+    double m_InverseHalfWidth;
+    std::vector<Coefficients> m_Coefficients;
+};
+
+} // namespace
+
+void ProjectMercatorExact(Model::Node *nodes, size_t count, double origin_x, double origin_y, double scale)
+{
+    for (size_t i = 0; i < count; ++i) {
+        nodes[i].x = (MercatorX(nodes[i].x) - origin_x) / scale;
+        nodes[i].y = (MercatorY(nodes[i].y) - origin_y) / scale;
+    }
+}
+
+void ProjectMercator(Model::Node *nodes, size_t count, double origin_x, double origin_y, double scale,
+                     unsigned threads)
+{
+    if (count == 0)
+        return;
+    double low = std::numeric_limits<double>::infinity(), high = -low;
+    for (size_t i = 0; i < count; ++i) {
+        low = std::min(low, nodes[i].y);
+        high = std::max(high, nodes[i].y);
+    }
+    // Widen a degenerate range so the fit stays well defined.
+    if (high - low < 1e-9) {
+        low -= 1e-6;
+        high += 1e-6;
+    }
+
+    const LatitudeFit fit{low, high, origin_y, scale};
+    const bool accurate = fit.All([&](double lat) {
+        return std::abs(fit(lat) - (MercatorY(lat) - origin_y) / scale) * scale <= kTolerance;
+    });
+
+    const double x_factor = MercatorX(1.) / scale, x_offset = -origin_x / scale;
+    threads = (unsigned)std::clamp<size_t>(count / kMinNodesPerThread, 1, std::max(threads, 1u));
+    ParallelFor(count, [&](size_t begin, size_t end) {
+        if (accurate)
+            fit.Project(nodes + begin, end - begin, x_factor, x_offset);
+        else
+            ProjectMercatorExact(nodes + begin, end - begin, origin_x, origin_y, scale);
+    }, threads);
+}
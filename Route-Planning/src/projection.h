@@ -0,0 +1,27 @@
+#ifndef PROJECTION_H
+#define PROJECTION_H
+
+#include <cstddef>
+#include <thread>
+#include "model.h"
+
+// Spherical Mercator as used by Model, in meters.
+double MercatorX(double lon);
+double MercatorY(double lat);
+
+// Projects nodes holding longitude in x and latitude in y (degrees) to map
+// coordinates: ((MercatorX(lon) - origin_x) / scale, (MercatorY(lat) - origin_y) / scale).
+//
+// x is affine in the longitude. For y, MercatorY is fitted with piecewise
+// Chebyshev polynomials over the latitude range of the nodes, so the per-node
+// loop is a fixed sequence of multiply-adds without log/tan calls, split across
+// threads for large maps. The fit is checked against MercatorY and only used
+// when it is within a micrometer everywhere in the range; otherwise (near the
+// poles) every node is projected exactly.
+void ProjectMercator(Model::Node *nodes, size_t count, double origin_x, double origin_y, double scale,
+                     unsigned threads = std::thread::hardware_concurrency());
+
+// The same projection calling MercatorX/MercatorY for every node.
+void ProjectMercatorExact(Model::Node *nodes, size_t count, double origin_x, double origin_y, double scale);
+
+#endif
@@ -1,13 +1,20 @@
 #include "render.h"
+#include <algorithm>
 #include <iostream>
+#include "trace.h"
 
 static float RoadMetricWidth(Model::Road::Type type);
 static io2d::rgba_color RoadColor(Model::Road::Type type);
 static io2d::dashes RoadDashes(Model::Road::Type type);
 static io2d::point_2d ToPoint2D( const Model::Node &node ) noexcept; 
 
-Render::Render( RouteModel &model ):
-    m_Model(model)
+// Features per path building task; small enough to balance the large layers
+// (buildings, highways) over the pool.
+static constexpr size_t kFeaturesPerTask = 1024;
+
+Render::Render( RouteModel &model, unsigned threads ):
+    m_Model(model),
+    m_Pool(std::max(threads, 1u))
 {
     BuildRoadReps();
     BuildLanduseBrushes();
@@ -15,10 +22,23 @@ Render::Render( RouteModel &model ):
 
 void Render::Display( io2d::output_surface &surface )
 {
-    m_Scale = static_cast<float>(std::min(surface.dimensions().x(), surface.dimensions().y()));    
+    TRACE_SCOPE("Render::Display");
+    const auto dimensions = surface.dimensions();
+    m_Scale = static_cast<float>(std::min(dimensions.x(), dimensions.y()));    
     m_PixelsInMeter = static_cast<float>(m_Scale / m_Model.MetricScale()); 
     m_Matrix = io2d::matrix_2d::create_scale({m_Scale, -m_Scale}) *
-               io2d::matrix_2d::create_translate({0.f, static_cast<float>(surface.dimensions().y())});
+               io2d::matrix_2d::create_translate({0.f, static_cast<float>(dimensions.y())});
+    m_Frame++;
+    if( m_Progress && !m_StreamDone ) {
+        m_StreamDone = m_Progress->Done();
+        m_Progress->TryReceive(m_Streamed, m_StreamComplete);
+    }
+    if( !m_Layers || m_Layers->width != dimensions.x() || m_Layers->height != dimensions.y() ) {
+        m_Layers.emplace();
+        m_Layers->width = dimensions.x();
+        m_Layers->height = dimensions.y();
+        BuildLayers(*m_Layers);
+    }
     
     surface.paint(m_BackgroundFillBrush);        
     DrawLanduses(surface);
@@ -32,23 +52,42 @@ void Render::Display( io2d::output_surface &surface )
     DrawEndPosition(surface);
 }
 
+void Render::Follow( PathChannel &channel )
+{
+    m_Progress = &channel;
+    m_Streamed.clear();
+    m_StreamComplete = false;
+    m_StreamDone = false;
+}
+
 void Render::DrawPath(io2d::output_surface &surface) const{
     io2d::render_props aliased{ io2d::antialias::none };
     io2d::brush foreBrush{ io2d::rgba_color::orange}; 
     float width = 5.0f;
-    surface.stroke(foreBrush, PathLine(), std::nullopt, io2d::stroke_props{width});
+    if( Searching() ) {
+        // Search still running: dashes marching towards the search frontier.
+        io2d::dashes marching{ -static_cast<float>(m_Frame % 12), {8.f, 4.f} };
+        surface.stroke(foreBrush, PathLine(m_Streamed), std::nullopt, io2d::stroke_props{width}, marching);
+        return;
+    }
+    // Alternatives go underneath the main route; they are final once a followed search is done.
+    io2d::brush alternativeBrush{ io2d::rgba_color{70, 130, 180} };
+    if( !m_Progress || m_StreamDone )
+        for (const RoutePath &alternative : m_Model.alternatives)
+            surface.stroke(alternativeBrush, PathLine(alternative), std::nullopt, io2d::stroke_props{width * 0.8f});
+    surface.stroke(foreBrush, PathLine(Route()), std::nullopt, io2d::stroke_props{width});
 
 }
 
 void Render::DrawEndPosition(io2d::output_surface &surface) const{
-    if (m_Model.path.empty()) return;
+    if (Route().empty() || Searching()) return;
     io2d::render_props aliased{ io2d::antialias::none };
     io2d::brush foreBrush{ io2d::rgba_color::red };
 
     auto pb = io2d::path_builder{}; 
     pb.matrix(m_Matrix);
 
-    pb.new_figure({(float) m_Model.path.back().x, (float) m_Model.path.back().y});
+    pb.new_figure(ToPoint2D(m_Model.SNodes()[Route().nodes.back()]));
     float constexpr l_marker = 0.01f;
     pb.rel_line({l_marker, 0.f});
     pb.rel_line({0.f, l_marker});
@@ -61,7 +100,7 @@ void Render::DrawEndPosition(io2d::output_surface &surface) const{
 }
 
 void Render::DrawStartPosition(io2d::output_surface &surface) const{
-    if (m_Model.path.empty()) return;
+    if (Route().empty()) return;
 
     io2d::render_props aliased{ io2d::antialias::none };
     io2d::brush foreBrush{ io2d::rgba_color::green };
@@ -69,7 +108,7 @@ void Render::DrawStartPosition(io2d::output_surface &surface) const{
     auto pb = io2d::path_builder{}; 
     pb.matrix(m_Matrix);
 
-    pb.new_figure({(float) m_Model.path.front().x, (float) m_Model.path.front().y});
+    pb.new_figure(ToPoint2D(m_Model.SNodes()[Route().nodes.front()]));
     float constexpr l_marker = 0.01f;
     pb.rel_line({l_marker, 0.f});
     pb.rel_line({0.f, l_marker});
@@ -81,74 +120,114 @@ void Render::DrawStartPosition(io2d::output_surface &surface) const{
     surface.stroke(foreBrush, io2d::interpreted_path{pb}, std::nullopt, std::nullopt, std::nullopt, aliased);
 }
 
+template <typename Item, typename F>
+void Render::BuildLayer( const std::vector<Item> &items, std::vector<Feature> &features, F &&make,
+                         std::vector<std::future<void>> &tasks )
+{
+    // Every task fills its own range of the pre-sized vector.
+    features.resize(items.size());
+    for( size_t begin = 0; begin < items.size(); begin += kFeaturesPerTask ) {
+        const size_t end = std::min(begin + kFeaturesPerTask, items.size());
+        tasks.push_back(m_Pool.Submit([&items, &features, &make, begin, end] {
+            for( size_t i = begin; i < end; ++i )
+                make(items[i], features[i]);
+        }));
+    }
+}
+
+void Render::BuildLayers( Layers &layers )
+{
+    TRACE_SCOPE("Render::BuildLayers");
+    // The tasks only read the model, the styles and m_Matrix.
+    std::vector<std::future<void>> tasks;
+    auto polygon = [this](const Model::Multipolygon &mp, Feature &feature) { feature.path = PathFromMP(mp); };
+    auto line = [this](const Model::Railway &railway, Feature &feature) {
+        feature.path = PathFromWay(m_Model.Ways()[railway.way]);
+    };
+    auto landuse = [this](const Model::Landuse &landuse, Feature &feature) {
+        if( auto br = m_LanduseBrushes.find(landuse.type); br != m_LanduseBrushes.end() ) {
+            feature.brush = &br->second;
+            feature.path = PathFromMP(landuse);
+        }
+    };
+    auto highway = [this](const Model::Road &road, Feature &feature) {
+        if( auto rep_it = m_RoadReps.find(road.type); rep_it != m_RoadReps.end() ) {
+            feature.rep = &rep_it->second;
+            feature.path = PathFromWay(m_Model.Ways()[road.way]);
+        }
+    };
+    BuildLayer(m_Model.Landuses(), layers.landuses, landuse, tasks);
+    BuildLayer(m_Model.Leisures(), layers.leisures, polygon, tasks);
+    BuildLayer(m_Model.Waters(), layers.waters, polygon, tasks);
+    BuildLayer(m_Model.Railways(), layers.railways, line, tasks);
+    BuildLayer(m_Model.Roads(), layers.highways, highway, tasks);
+    BuildLayer(m_Model.Buildings(), layers.buildings, polygon, tasks);
+    for( auto &task: tasks )
+        task.get();
+}
+
 void Render::DrawBuildings(io2d::output_surface &surface) const
 {
-    for( auto &building: m_Model.Buildings() ) {
-        auto path = PathFromMP(building);
-        surface.fill(m_BuildingFillBrush, path);        
-        surface.stroke(m_BuildingOutlineBrush, path, std::nullopt, m_BuildingOutlineStrokeProps);
+    for( auto &building: m_Layers->buildings ) {
+        surface.fill(m_BuildingFillBrush, building.path);        
+        surface.stroke(m_BuildingOutlineBrush, building.path, std::nullopt, m_BuildingOutlineStrokeProps);
     }
 }
 
 void Render::DrawLeisure(io2d::output_surface &surface) const
 {
-    for( auto &leisure: m_Model.Leisures()) {
-        auto path = PathFromMP(leisure);
-        surface.fill(m_LeisureFillBrush, path);        
-        surface.stroke(m_LeisureOutlineBrush, path, std::nullopt, m_LeisureOutlineStrokeProps);
+    for( auto &leisure: m_Layers->leisures ) {
+        surface.fill(m_LeisureFillBrush, leisure.path);        
+        surface.stroke(m_LeisureOutlineBrush, leisure.path, std::nullopt, m_LeisureOutlineStrokeProps);
     }
 }
 
 void Render::DrawWater(io2d::output_surface &surface) const
 {
-    for( auto &water: m_Model.Waters())
-        surface.fill(m_WaterFillBrush, PathFromMP(water));
+    for( auto &water: m_Layers->waters )
+        surface.fill(m_WaterFillBrush, water.path);
 }
 
 void Render::DrawLanduses(io2d::output_surface &surface) const
 {
-    for( auto &landuse: m_Model.Landuses() )
-        if( auto br = m_LanduseBrushes.find(landuse.type); br != m_LanduseBrushes.end() )        
-            surface.fill(br->second, PathFromMP(landuse));
+    for( auto &landuse: m_Layers->landuses )
+        if( landuse.brush )        
+            surface.fill(*landuse.brush, landuse.path);
 }
 
 void Render::DrawHighways(io2d::output_surface &surface) const
 {
-    auto ways = m_Model.Ways().data();
-    for( auto road: m_Model.Roads() )
-        if( auto rep_it = m_RoadReps.find(road.type); rep_it != m_RoadReps.end() ) {
-            auto &rep = rep_it->second;   
-            auto &way = ways[road.way];
+    for( auto &highway: m_Layers->highways )
+        if( highway.rep ) {
+            auto &rep = *highway.rep;   
             auto width = rep.metric_width > 0.f ? (rep.metric_width * m_PixelsInMeter) : 1.f;
             auto sp = io2d::stroke_props{width, io2d::line_cap::round};
-            surface.stroke(rep.brush, PathFromWay(way), std::nullopt, sp, rep.dashes);        
+            surface.stroke(rep.brush, highway.path, std::nullopt, sp, rep.dashes);        
         }
 }
 
 void Render::DrawRailways(io2d::output_surface &surface) const
 {     
-    auto ways = m_Model.Ways().data();
-    for( auto &railway: m_Model.Railways() ) {
-        auto &way = ways[railway.way];
-        auto path = PathFromWay(way);
-        surface.stroke(m_RailwayStrokeBrush, path, std::nullopt, io2d::stroke_props{m_RailwayOuterWidth * m_PixelsInMeter});
-        surface.stroke(m_RailwayDashBrush, path, std::nullopt, io2d::stroke_props{m_RailwayInnerWidth * m_PixelsInMeter}, m_RailwayDashes);
+    for( auto &railway: m_Layers->railways ) {
+        surface.stroke(m_RailwayStrokeBrush, railway.path, std::nullopt, io2d::stroke_props{m_RailwayOuterWidth * m_PixelsInMeter});
+        surface.stroke(m_RailwayDashBrush, railway.path, std::nullopt, io2d::stroke_props{m_RailwayInnerWidth * m_PixelsInMeter}, m_RailwayDashes);
     }
 }
 
-io2d::interpreted_path Render::PathLine() const
+io2d::interpreted_path Render::PathLine(const RoutePath &route) const
 {    
-    if( m_Model.path.empty() )
+    if( route.empty() )
         return {};
 
-    const auto nodes = m_Model.path;    
+    const auto &nodes = m_Model.SNodes();
+    const auto &path = route.nodes;
     
     auto pb = io2d::path_builder{};
     pb.matrix(m_Matrix);
-    pb.new_figure( ToPoint2D( m_Model.path[0]));
+    pb.new_figure( ToPoint2D( nodes[path[0]]));
 
-    for( int i=1; i< m_Model.path.size();i++ )
-        pb.line( ToPoint2D(m_Model.path[i])); 
+    for( size_t i=1; i< path.size();i++ )
+        pb.line( ToPoint2D(nodes[path[i]])); 
 
       
     return io2d::interpreted_path{pb};
@@ -1,20 +1,60 @@
 #pragma once
 
+#include <optional>
 #include <unordered_map>
+#include <vector>
 #include <io2d.h>
+#include "path_channel.h"
 #include "route_model.h"
+#include "worker_pool.h"
 
 using namespace std::experimental;
 
 class Render
 {
 public:
-    Render(RouteModel &model );
+    // Map layer paths are built on `threads` worker threads.
+    Render(RouteModel &model, unsigned threads = std::thread::hardware_concurrency() );
     void Display( io2d::output_surface &surface );
+    // Draws the routes received on `channel` instead of the model's route:
+    // partial routes animated while the search runs, then the final one, which
+    // is the last partial route when the search found none or was interrupted.
+    // The model's alternatives are drawn once the channel is done.
+    void Follow( PathChannel &channel );
     
 private:
+    struct RoadRep;
+
+    // A map feature as a path in surface coordinates, with the brush or road
+    // style it is painted with where that depends on the feature; features
+    // without one are not drawn.
+    struct Feature {
+        io2d::interpreted_path path;
+        const io2d::brush *brush = nullptr; // landuses
+        const RoadRep *rep = nullptr;       // highways
+    };
+
+    // Paths of the static map layers. They depend only on the surface size, so
+    // they are built once per size and then only painted.
+    struct Layers {
+        int width = 0;
+        int height = 0;
+        std::vector<Feature> landuses;
+        std::vector<Feature> leisures;
+        std::vector<Feature> waters;
+        std::vector<Feature> railways;
+        std::vector<Feature> highways;
+        std::vector<Feature> buildings;
+    };
+
     void BuildRoadReps();
     void BuildLanduseBrushes();
+    // Builds all layers for the current matrix on the worker pool, in chunks of
+    // features per task, and waits for them.
+    void BuildLayers( Layers &layers );
+    template <typename Item, typename F>
+    void BuildLayer( const std::vector<Item> &items, std::vector<Feature> &features, F &&make,
+                     std::vector<std::future<void>> &tasks );
     
     void DrawBuildings(io2d::output_surface &surface) const;
     void DrawHighways(io2d::output_surface &surface) const;
@@ -27,7 +67,10 @@ private:
     void DrawPath(io2d::output_surface &surface) const;
     io2d::interpreted_path PathFromWay(const Model::Way &way) const;
     io2d::interpreted_path PathFromMP(const Model::Multipolygon &mp) const;
-    io2d::interpreted_path PathLine() const;
+    io2d::interpreted_path PathLine(const RoutePath &route) const;
+    const RoutePath &Route() const { return m_Progress ? m_Streamed : m_Model.path; }
+    // A followed search may still publish routes: the channel is neither done nor has it sent a complete route.
+    bool Searching() const { return m_Progress && !m_StreamComplete && !m_StreamDone; }
 
     
     RouteModel &m_Model;
@@ -61,4 +104,13 @@ private:
     std::unordered_map<Model::Road::Type, RoadRep> m_RoadReps;
     
     std::unordered_map<Model::Landuse::Type, io2d::brush> m_LanduseBrushes;
+
+    std::optional<Layers> m_Layers;
+
+    PathChannel *m_Progress = nullptr;
+    RoutePath m_Streamed;
+    bool m_StreamComplete = false;
+    bool m_StreamDone = false;
+    unsigned m_Frame = 0;
+    WorkerPool m_Pool;
 };
\ No newline at end of file
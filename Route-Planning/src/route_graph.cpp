@@ -0,0 +1,152 @@
+#include "route_graph.h"
+#include <algorithm>
+
+RouteGraph::RouteGraph(const Model &model) : RouteGraph(model, RoutingProfile::Default()) {
+}
+
+RouteGraph::RouteGraph(const Model &model, const RoutingProfile &profile)
+    : m_Coords(&model.Nodes()), m_MetricScale(model.MetricScale()) {
+    std::vector<Segment> segments;
+    for (const Model::Road &road : model.Roads()) {
+        if (!profile.Allows(road.type))
+            continue;
+        const auto &nodes = model.Ways()[road.way].nodes;
+        for (size_t i = 1; i < nodes.size(); ++i) {
+            if (nodes[i - 1] == nodes[i])
+                continue;
+            segments.push_back({nodes[i - 1], nodes[i], 0.f, profile.factors[road.type]});
+        }
+    }
+    for (auto &segment : segments)
+        segment.length = Distance(segment.from, segment.to);
+    Build((int)model.Nodes().size(), segments);
+}
+
+RouteGraph::RouteGraph(const CompactGeometry &geometry) : m_Compact(&geometry), m_MetricScale(geometry.MetricScale()) {
+    std::vector<Segment> segments;
+    for (int road = 0; road < geometry.NumRoads(); ++road) {
+        int previous = -1;
+        for (int node : geometry.RoadNodes(road)) {
+            if (previous >= 0 && previous != node)
+                segments.push_back({previous, node, Distance(previous, node)});
+            previous = node;
+        }
+    }
+    Build(geometry.NumNodes(), segments);
+}
+
+void RouteGraph::ShareCoordinates(const RouteGraph &other) {
+    m_Coords = other.m_Coords;
+    m_Compact = other.m_Compact;
+    m_MetricScale = other.m_MetricScale;
+}
+
+void RouteGraph::Build(int num_nodes, std::vector<Segment> &segments) {
+    // Normalize to (low, high) so that duplicated segments from overlapping ways
+    // collapse, keeping the cheapest.
+    for (auto &segment : segments)
+        if (segment.from > segment.to)
+            std::swap(segment.from, segment.to);
+    std::sort(segments.begin(), segments.end(), [](const Segment &a, const Segment &b) {
+        return a.from != b.from ? a.from < b.from : a.to != b.to ? a.to < b.to
+                                                               : a.length * a.factor < b.length * b.factor;
+    });
+    segments.erase(std::unique(segments.begin(), segments.end(), [](const Segment &a, const Segment &b) {
+        return a.from == b.from && a.to == b.to;
+    }), segments.end());
+
+    m_Offsets.assign(num_nodes + 1, 0);
+    for (const auto &segment : segments) {
+        m_Offsets[segment.from + 1]++;
+        m_Offsets[segment.to + 1]++;
+    }
+    for (int i = 0; i < num_nodes; ++i)
+        m_Offsets[i + 1] += m_Offsets[i];
+
+    const int num_arcs = m_Offsets.back();
+    m_Heads.resize(num_arcs);
+    m_Lengths.resize(num_arcs);
+    m_BaseCosts.resize(num_arcs);
+    std::vector<int> fill(m_Offsets.begin(), m_Offsets.end() - 1);
+    for (const auto &segment : segments) {
+        int arc = fill[segment.from]++;
+        m_Heads[arc] = segment.to;
+        m_Lengths[arc] = segment.length;
+        m_BaseCosts[arc] = segment.length * segment.factor;
+        arc = fill[segment.to]++;
+        m_Heads[arc] = segment.from;
+        m_Lengths[arc] = segment.length;
+        m_BaseCosts[arc] = segment.length * segment.factor;
+    }
+
+    // Keep each adjacency sorted by head so FindArc can binary search.
+    std::vector<int> order;
+    std::vector<int> heads;
+    std::vector<float> lengths;
+    std::vector<float> costs;
+    for (int node = 0; node < num_nodes; ++node) {
+        const int first = FirstArc(node), last = LastArc(node);
+        order.resize(last - first);
+        for (int i = 0; i < (int)order.size(); ++i)
+            order[i] = first + i;
+        std::sort(order.begin(), order.end(), [&](int a, int b) { return m_Heads[a] < m_Heads[b]; });
+        heads.clear();
+        lengths.clear();
+        costs.clear();
+        for (int arc : order) {
+            heads.push_back(m_Heads[arc]);
+            lengths.push_back(m_Lengths[arc]);
+            costs.push_back(m_BaseCosts[arc]);
+        }
+        std::copy(heads.begin(), heads.end(), m_Heads.begin() + first);
+        std::copy(lengths.begin(), lengths.end(), m_Lengths.begin() + first);
+        std::copy(costs.begin(), costs.end(), m_BaseCosts.begin() + first);
+    }
+
+    m_Reverse.resize(num_arcs);
+    for (int node = 0; node < num_nodes; ++node)
+        for (int arc = FirstArc(node); arc < LastArc(node); ++arc)
+            m_Reverse[arc] = FindArc(m_Heads[arc], node);
+
+    m_Costs = m_BaseCosts;
+    m_Changes.clear();
+}
+
+int RouteGraph::FindArc(int from, int to) const {
+    auto first = m_Heads.begin() + FirstArc(from);
+    auto last = m_Heads.begin() + LastArc(from);
+    auto it = std::lower_bound(first, last, to);
+    if (it == last || *it != to)
+        return -1;
+    return (int)(it - m_Heads.begin());
+}
+
+bool RouteGraph::SetArcCost(int arc, float cost) {
+    cost = std::max(cost, m_Lengths[arc]);
+    if (cost == m_Costs[arc])
+        return false;
+    m_Changes.push_back({arc, m_Costs[arc], cost});
+    m_Costs[arc] = cost;
+    return true;
+}
+
+bool RouteGraph::SetEdgeCost(int from, int to, float cost, bool both_directions) {
+    const int arc = FindArc(from, to);
+    if (arc < 0)
+        return false;
+    bool changed = SetArcCost(arc, cost);
+    if (both_directions)
+        changed = SetArcCost(m_Reverse[arc], cost) || changed;
+    return changed;
+}
+
+bool RouteGraph::ScaleEdge(int from, int to, float factor) {
+    const int arc = FindArc(from, to);
+    if (arc < 0)
+        return false;
+    return SetEdgeCost(from, to, m_BaseCosts[arc] * factor);
+}
+
+bool RouteGraph::RestoreEdge(int from, int to) {
+    return ScaleEdge(from, to, 1.f);
+}
@@ -0,0 +1,93 @@
+#ifndef ROUTE_GRAPH_H
+#define ROUTE_GRAPH_H
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "compact_geometry.h"
+#include "model.h"
+#include "routing_profile.h"
+
+// Static adjacency (CSR) over the routable road network of a Model. Node ids are
+// the Model node indices, so every graph built over the same Model shares its
+// coordinates, e.g. the graphs of several routing profiles. A graph can also be
+// built over a CompactGeometry, which then supplies the coordinates and must
+// outlive the graph. Each road segment becomes a pair of arcs; arc costs start
+// at the segment length (in map units) times the profile factor of its road
+// type and can be changed afterwards to model closures or slowdowns. Every
+// change is appended to a change log so that incremental planners can repair
+// their results instead of searching again.
+class RouteGraph {
+  public:
+    struct Segment {
+        int from;
+        int to;
+        float length;
+        float factor = 1.f; // base cost is length * factor
+    };
+
+    struct ArcChange {
+        int arc;
+        float old_cost;
+        float new_cost;
+    };
+
+    static constexpr float kClosed = std::numeric_limits<float>::infinity();
+
+    RouteGraph(const Model &model);
+    RouteGraph(const Model &model, const RoutingProfile &profile);
+    explicit RouteGraph(const CompactGeometry &geometry);
+
+    int NumNodes() const { return (int)m_Offsets.size() - 1; }
+    int NumArcs() const { return (int)m_Heads.size(); }
+
+    // Arcs leaving `node` are [FirstArc(node), LastArc(node)).
+    int FirstArc(int node) const { return m_Offsets[node]; }
+    int LastArc(int node) const { return m_Offsets[node + 1]; }
+    int Degree(int node) const { return LastArc(node) - FirstArc(node); }
+    int Head(int arc) const { return m_Heads[arc]; }
+    int ReverseArc(int arc) const { return m_Reverse[arc]; }
+    float Length(int arc) const { return m_Lengths[arc]; }
+    float Cost(int arc) const { return m_Costs[arc]; }
+    // Cost before any edge weight updates.
+    float BaseCost(int arc) const { return m_BaseCosts[arc]; }
+    int FindArc(int from, int to) const;
+
+    Model::Node Coord(int node) const { return m_Compact ? m_Compact->Coord(node) : (*m_Coords)[node]; }
+    float Distance(int a, int b) const {
+        const auto na = Coord(a), nb = Coord(b);
+        return (float)std::hypot(na.x - nb.x, na.y - nb.y);
+    }
+    double MetricScale() const { return m_MetricScale; }
+
+    // Edge weight updates. Costs are clamped to the segment length so the
+    // Euclidean heuristic stays admissible; kClosed removes the segment.
+    // ScaleEdge() scales the base cost, RestoreEdge() returns to it.
+    bool SetEdgeCost(int from, int to, float cost, bool both_directions = true);
+    bool CloseEdge(int from, int to) { return SetEdgeCost(from, to, kClosed); }
+    bool ScaleEdge(int from, int to, float factor);
+    bool RestoreEdge(int from, int to);
+
+    // Monotonic change log; consumers remember how far they have read.
+    const std::vector<ArcChange> &Changes() const { return m_Changes; }
+
+  protected:
+    RouteGraph() = default;
+    void Build(int num_nodes, std::vector<Segment> &segments);
+    // Uses the coordinates of `other` (for graphs derived from it).
+    void ShareCoordinates(const RouteGraph &other);
+    bool SetArcCost(int arc, float cost);
+
+    std::vector<int> m_Offsets;
+    std::vector<int> m_Heads;
+    std::vector<int> m_Reverse;
+    std::vector<float> m_Lengths;
+    std::vector<float> m_BaseCosts;
+    std::vector<float> m_Costs;
+    std::vector<ArcChange> m_Changes;
+    const std::vector<Model::Node> *m_Coords = nullptr;
+    const CompactGeometry *m_Compact = nullptr;
+    double m_MetricScale = 1.;
+};
+
+#endif
@@ -1,18 +1,58 @@
 #include "route_model.h"
 #include <iostream>
+#include "trace.h"
 
 RouteModel::RouteModel(const std::vector<std::byte> &xml) : Model(xml) {
+    CreateSearchNodes();
+}
+
+
+RouteModel::RouteModel(MappedFile &&xml) : Model(std::move(xml)) {
+    CreateSearchNodes();
+}
+
+
+void RouteModel::CreateSearchNodes() {
+    TRACE_SCOPE("RouteModel::RouteModel");
     // Create RouteModel nodes.
     int counter = 0;
+    m_Nodes.reserve(this->Nodes().size());
     for (Model::Node node : this->Nodes()) {
         m_Nodes.emplace_back(Node(counter, this, node));
         counter++;
     }
     CreateNodeToRoadHashmap();
+
+    // A node has at most one neighbor per road through it and enters the open list once.
+    for (const auto &[node_idx, roads] : node_to_road)
+        m_Nodes[node_idx].neighbors.reserve(roads.size());
+    m_OpenList.reserve(m_Nodes.size());
+}
+
+
+void RouteModel::ResetSearchState() {
+    for (Node &node : m_Nodes) {
+        node.parent = nullptr;
+        node.h_value = std::numeric_limits<float>::max();
+        node.g_value = 0.0;
+        node.visited = false;
+        node.neighbors.clear();
+    }
+    m_OpenList.clear();
+    path.clear();
+    alternatives.clear();
+}
+
+
+RouteGraph &RouteModel::Graph() {
+    if (!m_Graph)
+        m_Graph = std::make_unique<RouteGraph>(*this);
+    return *m_Graph;
 }
 
 
 void RouteModel::CreateNodeToRoadHashmap() {
+    TRACE_SCOPE("RouteModel::CreateNodeToRoadHashmap");
     for (const Model::Road &road : Roads()) {
         if (road.type != Model::Road::Type::Footway) {
             for (int node_idx : Ways()[road.way].nodes) {
@@ -26,12 +66,11 @@ void RouteModel::CreateNodeToRoadHashmap() {
 }
 
 
-RouteModel::Node *RouteModel::Node::FindNeighbor(std::vector<int> node_indices) {
+RouteModel::Node *RouteModel::Node::FindNeighbor(const std::vector<int> &node_indices) {
     Node *closest_node = nullptr;
-    Node node;
 
     for (int node_index : node_indices) {
-        node = parent_model->SNodes()[node_index];
+        const Node &node = parent_model->SNodes()[node_index];
         if (this->distance(node) != 0 && !node.visited) {
             if (closest_node == nullptr || this->distance(node) < this->distance(*closest_node)) {
                 closest_node = &parent_model->SNodes()[node_index];
@@ -43,7 +82,11 @@ RouteModel::Node *RouteModel::Node::FindNeighbor(std::vector<int> node_indices)
 
 
 void RouteModel::Node::FindNeighbors() {
-    for (auto & road : parent_model->node_to_road[this->index]) {
+    // find() rather than [], which would insert an empty entry for nodes off the road network.
+    auto roads = parent_model->node_to_road.find(this->index);
+    if (roads == parent_model->node_to_road.end())
+        return;
+    for (auto & road : roads->second) {
         RouteModel::Node *new_neighbor = this->FindNeighbor(parent_model->Ways()[road->way].nodes);
         if (new_neighbor) {
             this->neighbors.emplace_back(new_neighbor);
@@ -53,6 +96,7 @@ void RouteModel::Node::FindNeighbors() {
 
 
 RouteModel::Node &RouteModel::FindClosestNode(float x, float y) {
+    TRACE_SCOPE("RouteModel::FindClosestNode");
     Node input;
     input.x = x;
     input.y = y;
@@ -3,8 +3,11 @@
 
 #include <limits>
 #include <cmath>
+#include <memory>
 #include <unordered_map>
 #include "model.h"
+#include "route_graph.h"
+#include "route_path.h"
 #include <iostream>
 
 class RouteModel : public Model {
@@ -19,7 +22,8 @@ class RouteModel : public Model {
         std::vector<Node *> neighbors;
 
         void FindNeighbors();
-        float distance(Node other) const {
+        int Index() const { return index; }
+        float distance(const Model::Node &other) const {
             return std::sqrt(std::pow((x - other.x), 2) + std::pow((y - other.y), 2));
         }
 
@@ -28,19 +32,32 @@ class RouteModel : public Model {
 
       private:
         int index;
-        Node * FindNeighbor(std::vector<int> node_indices);
+        Node * FindNeighbor(const std::vector<int> &node_indices);
         RouteModel * parent_model = nullptr;
     };
 
     RouteModel(const std::vector<std::byte> &xml);
+    RouteModel(MappedFile &&xml);
     Node &FindClosestNode(float x, float y);
+    // Clears the per-node search state so the model can serve another query.
+    void ResetSearchState();
     auto &SNodes() { return m_Nodes; }
-    std::vector<Node> path;
+    // Open list of RoutePlanner's A*, reserved for every node at construction
+    // like the neighbor lists, so searches on this model don't allocate.
+    std::vector<Node *> &OpenList() { return m_OpenList; }
+    // CSR graph over the same nodes, built on first use.
+    RouteGraph &Graph();
+    RoutePath path;
+    // Alternatives to `path`, drawn as extra overlays.
+    std::vector<RoutePath> alternatives;
     
   private:
+    void CreateSearchNodes();
     void CreateNodeToRoadHashmap();
     std::unordered_map<int, std::vector<const Model::Road *>> node_to_road;
     std::vector<Node> m_Nodes;
+    std::vector<Node *> m_OpenList;
+    std::unique_ptr<RouteGraph> m_Graph;
 
 };
 
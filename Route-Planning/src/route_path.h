@@ -0,0 +1,21 @@
+#ifndef ROUTE_PATH_H
+#define ROUTE_PATH_H
+
+#include <vector>
+
+// Compact route result: Model node indices from start to end, and the distance
+// in meters travelled when each node is reached (0 for the start node).
+struct RoutePath {
+    std::vector<int> nodes;
+    std::vector<float> distances;
+
+    bool empty() const { return nodes.empty(); }
+    size_t size() const { return nodes.size(); }
+    float Length() const { return distances.empty() ? 0.f : distances.back(); }
+    void clear() {
+        nodes.clear();
+        distances.clear();
+    }
+};
+
+#endif
@@ -1,8 +1,12 @@
 #include "route_planner.h"
 #include <algorithm>
+#include "trace.h"
 
-RoutePlanner::RoutePlanner(RouteModel &model, float start_x, float start_y, float end_x, float end_y) : m_Model(model)
+RoutePlanner::RoutePlanner(RouteModel &model, float start_x, float start_y, float end_x, float end_y)
+    : open_list(model.OpenList()), m_Model(model)
 {
+    open_list.clear();
+
     // Convert inputs to percentage:
     start_x *= 0.01;
     start_y *= 0.01;
@@ -11,8 +15,13 @@ RoutePlanner::RoutePlanner(RouteModel &model, float start_x, float start_y, floa
 
     // TODO 2: Use the m_Model.FindClosestNode method to find the closest nodes to the starting and ending coordinates.
     // Store the nodes you find in the RoutePlanner's start_node and end_node attributes.
-    RoutePlanner::start_node = &model.FindClosestNode(start_x, start_y);
-    RoutePlanner::end_node = &model.FindClosestNode(end_x, end_y);
+    {
+        ScopedMicros timer{stats.find_closest_us};
+        RoutePlanner::start_node = &model.FindClosestNode(start_x, start_y);
+        RoutePlanner::end_node = &model.FindClosestNode(end_x, end_y);
+    }
+    stats.start_node = start_node->Index();
+    stats.end_node = end_node->Index();
 }
 
 // TODO 3: Implement the CalculateHValue method.
@@ -22,7 +31,7 @@ RoutePlanner::RoutePlanner(RouteModel &model, float start_x, float start_y, floa
 
 float RoutePlanner::CalculateHValue(RouteModel::Node const *node)
 {
-    return node->distance(*RoutePlanner::end_node);
+    return heuristic_weight * node->distance(*RoutePlanner::end_node);
 }
 
 // TODO 4: Complete the AddNeighbors method to expand the current node by adding all unvisited neighbors to the open list.
@@ -35,6 +44,8 @@ float RoutePlanner::CalculateHValue(RouteModel::Node const *node)
 void RoutePlanner::AddNeighbors(RouteModel::Node *current_node)
 {
     current_node->FindNeighbors();
+    stats.nodes_expanded++;
+    stats.edges_relaxed += current_node->neighbors.size();
     for (RouteModel::Node *i : current_node->neighbors)
     {
         i->parent = current_node;                                        // set the parent
@@ -43,6 +54,7 @@ void RoutePlanner::AddNeighbors(RouteModel::Node *current_node)
         i->visited = true;                                               // set visited value to true
         RoutePlanner::open_list.push_back(i);                            // add to open list
     }
+    stats.open_list_peak = std::max(stats.open_list_peak, (long)open_list.size());
 }
 
 // TODO 5: Complete the NextNode method to sort the open list and return the next node.
@@ -74,24 +86,55 @@ RouteModel::Node *RoutePlanner::NextNode()
 // - The returned vector should be in the correct order: the start node should be the first element
 //   of the vector, the end node should be the last element.
 
-std::vector<RouteModel::Node> RoutePlanner::ConstructFinalPath(RouteModel::Node *current_node)
+RoutePath RoutePlanner::ConstructFinalPath(RouteModel::Node *current_node)
+{
+    RoutePath path_found;
+    ConstructFinalPath(current_node, path_found);
+    return path_found;
+}
+
+void RoutePlanner::ConstructFinalPath(RouteModel::Node *current_node, RoutePath &path_found)
+{
+    ScopedMicros timer{stats.path_us};
+    distance = TracePath(current_node, path_found);
+    stats.distance = distance;
+    stats.path_nodes = (int)path_found.size();
+}
+
+float RoutePlanner::TracePath(const RouteModel::Node *current_node, RoutePath &path_found) const
 {
-    // Create path_found vector
-    distance = 0.0f;
-    std::vector<RouteModel::Node> path_found;
+    // Size the path up front and fill it from the end, so it is allocated at most once;
+    // `distances` temporarily holds the distance left to the end.
+    float length = 0.0f;
+    size_t count = 1;
+    for (const RouteModel::Node *node = current_node; node->parent; node = node->parent)
+        count++;
+    path_found.nodes.resize(count);
+    path_found.distances.resize(count);
 
     // TODO: Implement your solution here.
     while (current_node->parent) // while (current node has a parent)
     {
-        distance += current_node->distance(*current_node->parent); // add to RoutePlanner distance variable
-        path_found.push_back(*current_node);                       // push node into path list
-        current_node = current_node->parent;                       // proceed to the next node
+        count--;
+        path_found.nodes[count] = current_node->Index();         // store node index from the back
+        path_found.distances[count] = length;
+        length += current_node->distance(*current_node->parent); // add to the route length
+        current_node = current_node->parent;                     // proceed to the next node
     }
-    path_found.push_back(*current_node);                // push the last node
-    std::reverse(path_found.begin(), path_found.end()); // reverse the vector
+    path_found.nodes[0] = current_node->Index(); // store the start node
+    path_found.distances[0] = length;
 
-    distance *= m_Model.MetricScale(); // Multiply the distance by the scale of the map to get meters.
-    return path_found;
+    // Convert the remaining distances to cumulative meters from the start.
+    for (float &remaining : path_found.distances)
+        remaining = (length - remaining) * m_Model.MetricScale();
+
+    return length * m_Model.MetricScale(); // Multiply the distance by the scale of the map to get meters.
+}
+
+void RoutePlanner::PublishProgress(const RouteModel::Node *node)
+{
+    TracePath(node, partial_path);
+    progress->Publish(partial_path, false);
 }
 
 // TODO 7: Write the A* Search algorithm here.
@@ -103,21 +146,155 @@ std::vector<RouteModel::Node> RoutePlanner::ConstructFinalPath(RouteModel::Node
 
 void RoutePlanner::AStarSearch()
 {
+    if (heuristic_weight > 1.0f || landmarks)
+    {
+        GraphSearch();
+        return;
+    }
+
+    TRACE_SCOPE("RoutePlanner::AStarSearch");
     RouteModel::Node *current_node = nullptr;
+    RouteModel::Node *closest_node = RoutePlanner::start_node; // expanded node nearest to the end, for progress
+    stats.search_us = 0.;
+    stats.path_us = 0.;
+    stats.suboptimality_bound = 0.f; // nodes are closed when first reached, so no bound holds
+    status = SearchStatus::Found; // until cancelled or timed out
+    auto next_progress = std::chrono::steady_clock::now() + progress_interval;
 
     // TODO: Implement your solution here.
-    RoutePlanner::start_node->visited = true;                                                    // set starting node 'visited' attribute
-    RoutePlanner::start_node->h_value = RoutePlanner::CalculateHValue(RoutePlanner::start_node); // set starting node 'h-value' attribute
-    RoutePlanner::open_list.push_back(RoutePlanner::start_node);                                 // push starting node into the open list
-
-    while ((open_list.size() > 0) && (current_node != RoutePlanner::end_node)) // WHILE (open list is not empty) AND (current_node is not the end node)
     {
-        current_node = NextNode();                  // get the next node
-        if (current_node == RoutePlanner::end_node) // IF (end_node is found), construct the path and break
+        ScopedMicros timer{stats.search_us};
+        RoutePlanner::start_node->visited = true;                                                    // set starting node 'visited' attribute
+        RoutePlanner::start_node->h_value = RoutePlanner::CalculateHValue(RoutePlanner::start_node); // set starting node 'h-value' attribute
+        RoutePlanner::open_list.push_back(RoutePlanner::start_node);                                 // push starting node into the open list
+
+        while ((open_list.size() > 0) && (current_node != RoutePlanner::end_node)) // WHILE (open list is not empty) AND (current_node is not the end node)
         {
-            m_Model.path = RoutePlanner::ConstructFinalPath(current_node);
-            break;
+            // Clocks and flags are only read every few dozen expansions.
+            if ((limits || progress) && stats.nodes_expanded % SearchLimits::kCheckInterval == 0)
+            {
+                if (limits && (status = limits->Check()) != SearchStatus::Found) // give up when cancelled or out of time
+                    break;
+                if (progress && std::chrono::steady_clock::now() >= next_progress) // publish the route so far
+                {
+                    PublishProgress(closest_node);
+                    next_progress = std::chrono::steady_clock::now() + progress_interval;
+                }
+            }
+            current_node = NextNode();                  // get the next node
+            if (current_node == RoutePlanner::end_node) // IF (end_node is found), stop searching
+                break;
+            if (current_node->h_value < closest_node->h_value)
+                closest_node = current_node;
+            RoutePlanner::AddNeighbors(current_node); // continue looking for end node
         }
-        RoutePlanner::AddNeighbors(current_node); // continue looking for end node
     }
-}
\ No newline at end of file
+
+    if (status == SearchStatus::Found)
+        status = current_node == RoutePlanner::end_node ? SearchStatus::Found : SearchStatus::NoRoute;
+    if (status == SearchStatus::Found) // construct the path outside the search timer
+        RoutePlanner::ConstructFinalPath(current_node, m_Model.path);
+    if (progress)
+    {
+        if (status == SearchStatus::Found)
+            progress->Publish(m_Model.path, true);
+        else
+            PublishProgress(closest_node);
+    }
+}
+
+
+void RoutePlanner::GraphSearch()
+{
+    TRACE_SCOPE("RoutePlanner::GraphSearch");
+    stats.search_us = 0.;
+    stats.path_us = 0.;
+    stats.suboptimality_bound = heuristic_weight;
+    const RouteGraph &graph = m_Model.Graph();
+    const int target = end_node->Index();
+    SearchWorkspace workspace;
+    SearchResult result;
+    {
+        ScopedMicros timer{stats.search_us};
+        auto h_value = [&](int node)
+        {
+            const float h = graph.Distance(node, target);
+            return heuristic_weight * (landmarks ? std::max(h, landmarks->LowerBound(node, target)) : h);
+        };
+        result = HeuristicAStar(graph, workspace, {{start_node->Index(), 0.f}}, {{target, 0.f}}, h_value,
+                                limits ? &*limits : nullptr);
+    }
+    status = result.status;
+    stats.nodes_expanded = result.expanded;
+    stats.edges_relaxed = result.relaxed;
+    stats.open_list_peak = result.heap_peak;
+    m_Model.path.clear();
+    if (result.Found())
+    {
+        ScopedMicros timer{stats.path_us};
+        m_Model.path = ExtractPath(graph, workspace, target);
+        distance = m_Model.path.Length();
+        stats.distance = distance;
+        stats.path_nodes = (int)m_Model.path.size();
+    }
+    if (progress) // the complete route, or the part explored when interrupted
+        progress->Publish(result.Found() || result.closest < 0 ? m_Model.path : ExtractPath(graph, workspace, result.closest),
+                          result.Found());
+}
+
+
+std::vector<AnytimeSolution> RoutePlanner::AnytimeSearch(std::chrono::microseconds budget, float initial_weight)
+{
+    stats.search_us = 0.;
+    stats.path_us = 0.;
+    std::vector<AnytimeSolution> solutions;
+    status = limits && limits->token.IsCancelled() ? SearchStatus::Cancelled : SearchStatus::NoRoute;
+    if (status != SearchStatus::Cancelled)
+    {
+        ScopedMicros timer{stats.search_us};
+        SearchWorkspace workspace;
+        auto deadline = std::chrono::steady_clock::now() + budget;
+        if (limits)
+            deadline = std::min(deadline, limits->deadline);
+        solutions = AnytimeAStar(m_Model.Graph(), workspace, start_node->Index(), end_node->Index(), deadline, initial_weight);
+    }
+    m_Model.path.clear();
+    distance = 0.f;
+    if (!solutions.empty())
+    {
+        const AnytimeSolution &best = solutions.back();
+        status = SearchStatus::Found;
+        m_Model.path = best.path;
+        distance = best.path.Length();
+        stats.distance = distance;
+        stats.path_nodes = (int)best.path.size();
+        stats.nodes_expanded = best.expanded;
+        stats.suboptimality_bound = best.bound;
+    }
+    if (progress)
+        progress->Publish(m_Model.path, status == SearchStatus::Found);
+    return solutions;
+}
+
+
+int RoutePlanner::AlternativeSearch(const AlternativeOptions &options)
+{
+    TRACE_SCOPE("RoutePlanner::AlternativeSearch");
+    stats.search_us = 0.;
+    std::vector<AlternativeRoute> routes;
+    {
+        ScopedMicros timer{stats.search_us};
+        routes = AlternativeRoutes(m_Model.Graph(), start_node->Index(), end_node->Index(), options);
+    }
+    m_Model.alternatives.clear();
+    if (routes.empty())
+        return 0;
+
+    m_Model.path = std::move(routes.front().path);
+    for (size_t i = 1; i < routes.size(); ++i)
+        m_Model.alternatives.push_back(std::move(routes[i].path));
+    distance = m_Model.path.Length();
+    stats.distance = distance;
+    stats.path_nodes = (int)m_Model.path.size();
+    return (int)m_Model.alternatives.size();
+}
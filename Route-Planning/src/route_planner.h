@@ -1,10 +1,19 @@
 #ifndef ROUTE_PLANNER_H
 #define ROUTE_PLANNER_H
 
+#include <chrono>
 #include <iostream>
+#include <optional>
 #include <vector>
 #include <string>
+#include <algorithm>
+#include "alternative_routes.h"
+#include "anytime_search.h"
+#include "landmarks.h"
+#include "path_channel.h"
 #include "route_model.h"
+#include "search_limits.h"
+#include "search_stats.h"
 
 
 class RoutePlanner {
@@ -12,21 +21,70 @@ class RoutePlanner {
     RoutePlanner(RouteModel &model, float start_x, float start_y, float end_x, float end_y);
     // Add public variables or methods declarations here.
     float GetDistance() const {return distance;}
+    const SearchStats &GetStats() const {return stats;}
+    // With the default weight of 1 and no landmarks, the original search over
+    // the model's ways. It closes nodes when it first reaches them and never
+    // relaxes them again, so its route may be longer than the shortest one and
+    // it reports no suboptimality bound. Otherwise A* over the routing graph,
+    // weighted (see SetHeuristicWeight()) and guided by the landmarks (see
+    // SetLandmarks()) when set.
     void AStarSearch();
+    // Stores the shortest route in the model's path and alternatives to it in
+    // the model's alternatives; returns the number of alternatives found.
+    int AlternativeSearch(const AlternativeOptions &options = {});
+    // Makes AStarSearch give up when the token is cancelled or the deadline passes.
+    void SetLimits(const SearchLimits &search_limits) {limits = search_limits;}
+    SearchStatus GetStatus() const {return status;}
+    // Makes AStarSearch publish the route to the expanded node nearest to the
+    // end on `channel` about every `interval`, and its result (the complete
+    // route, or the last partial one) when it ends. The channel is not closed.
+    void SetProgress(PathChannel &channel, std::chrono::microseconds interval = std::chrono::milliseconds{20})
+    {
+        progress = &channel;
+        progress_interval = interval;
+    }
+    // Weighted A* on the routing graph: h is multiplied by `weight` (>= 1), which finds a
+    // route at most `weight` times longer than the shortest one, usually expanding fewer nodes.
+    void SetHeuristicWeight(float weight) {heuristic_weight = std::max(weight, 1.0f);}
+    // Guides the search with the landmark bounds of the model's graph, e.g. from
+    // LoadOrPreprocess(); with a weight of 1 it then finds shortest routes. The
+    // landmarks must outlive the planner.
+    void SetLandmarks(const Landmarks &search_landmarks) {landmarks = &search_landmarks;}
+    // ARA*: publishes a first route quickly and refines it until `budget` has
+    // passed, or until the deadline set with SetLimits() if that is earlier;
+    // the first route is always completed. The best route is stored in the
+    // model (cleared when there is none); all solutions are returned.
+    std::vector<AnytimeSolution> AnytimeSearch(std::chrono::microseconds budget, float initial_weight = 3.0f);
 
     // The following methods have been made public so we can test them individually.
     void AddNeighbors(RouteModel::Node *current_node);
     float CalculateHValue(RouteModel::Node const *node);
-    std::vector<RouteModel::Node> ConstructFinalPath(RouteModel::Node *);
+    RoutePath ConstructFinalPath(RouteModel::Node *);
+    // Same, reusing the storage of `path`.
+    void ConstructFinalPath(RouteModel::Node *, RoutePath &path);
     RouteModel::Node *NextNode();
 
   private:
     // Add private variables or methods declarations here.
-    std::vector<RouteModel::Node*> open_list;
+    // Fills `path` with the route from the start to `node` and returns its length in meters.
+    float TracePath(const RouteModel::Node *node, RoutePath &path) const;
+    // AStarSearch() on the routing graph.
+    void GraphSearch();
+    void PublishProgress(const RouteModel::Node *node);
+
+    std::vector<RouteModel::Node*> &open_list; // the model's, reused between queries
     RouteModel::Node *start_node;
     RouteModel::Node *end_node;
 
     float distance = 0.0f;
+    float heuristic_weight = 1.0f;
+    const Landmarks *landmarks = nullptr;
+    std::optional<SearchLimits> limits; // unset until SetLimits(); a default token would allocate per planner
+    SearchStatus status = SearchStatus::NoRoute;
+    PathChannel *progress = nullptr;
+    std::chrono::microseconds progress_interval{0};
+    RoutePath partial_path; // reused for progress routes
+    SearchStats stats;
     RouteModel &m_Model;
 };
 
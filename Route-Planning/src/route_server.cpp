@@ -0,0 +1,579 @@
+#include "route_server.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <future>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "search_stats.h"
+
+namespace {
+
+// Longest request line accepted before the connection is dropped.
+constexpr size_t kMaxRequestSize = 1 << 20;
+// How often the poll loop looks at the stop flag.
+constexpr int kPollMillis = 100;
+
+[[noreturn]] void Fail(const std::string &what)
+{
+    throw std::logic_error(what);
+}
+
+struct JsonValue {
+    enum Type { Null, Bool, Number, String, Array, Object };
+    Type type = Null;
+    double number = 0.;
+    std::string string;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    const JsonValue *Find(std::string_view key) const {
+        for (const auto &[name, value] : members)
+            if (name == key)
+                return &value;
+        return nullptr;
+    }
+};
+
+// Recursive-descent reader for the JSON the protocol uses. Throws std::logic_error.
+class JsonReader {
+  public:
+    explicit JsonReader(std::string_view text) : m_Text(text) {}
+
+    JsonValue Document() {
+        JsonValue value = Value(0);
+        SkipSpace();
+        if (m_Pos != m_Text.size())
+            Fail("trailing characters after JSON value");
+        return value;
+    }
+
+  private:
+    static constexpr int kMaxDepth = 16;
+
+    void SkipSpace() {
+        while (m_Pos < m_Text.size() && std::strchr(" \t\r\n", m_Text[m_Pos]))
+            ++m_Pos;
+    }
+    bool Consume(char c) {
+        SkipSpace();
+        if (m_Pos < m_Text.size() && m_Text[m_Pos] == c) {
+            ++m_Pos;
+            return true;
+        }
+        return false;
+    }
+    void Expect(char c) {
+        if (!Consume(c))
+            Fail(std::string{"expected '"} + c + "'");
+    }
+    bool Literal(std::string_view word) {
+        if (m_Text.substr(m_Pos, word.size()) != word)
+            return false;
+        m_Pos += word.size();
+        return true;
+    }
+
+    JsonValue Value(int depth) {
+        if (depth > kMaxDepth)
+            Fail("JSON nested too deeply");
+        SkipSpace();
+        if (m_Pos == m_Text.size())
+            Fail("unexpected end of JSON");
+        JsonValue value;
+        const char c = m_Text[m_Pos];
+        if (c == '{') {
+            ++m_Pos;
+            value.type = JsonValue::Object;
+            if (Consume('}'))
+                return value;
+            do {
+                SkipSpace();
+                std::string key = String();
+                Expect(':');
+                value.members.emplace_back(std::move(key), Value(depth + 1));
+            } while (Consume(','));
+            Expect('}');
+        }
+        else if (c == '[') {
+            ++m_Pos;
+            value.type = JsonValue::Array;
+            if (Consume(']'))
+                return value;
+            do
+                value.items.push_back(Value(depth + 1));
+            while (Consume(','));
+            Expect(']');
+        }
+        else if (c == '"') {
+            value.type = JsonValue::String;
+            value.string = String();
+        }
+        else if (c == 't' || c == 'f') {
+            value.type = JsonValue::Bool;
+            value.number = Literal("true");
+            if (!value.number && !Literal("false"))
+                Fail("invalid JSON value");
+        }
+        else if (c == 'n') {
+            if (!Literal("null"))
+                Fail("invalid JSON value");
+        }
+        else {
+            // strtod needs a terminated string; numbers are short.
+            const size_t end = m_Text.find_first_not_of("+-0123456789.eE", m_Pos);
+            const std::string digits{m_Text.substr(m_Pos, end - m_Pos)};
+            char *parsed = nullptr;
+            value.type = JsonValue::Number;
+            value.number = std::strtod(digits.c_str(), &parsed);
+            if (digits.empty() || parsed != digits.c_str() + digits.size() || !std::isfinite(value.number))
+                Fail("invalid JSON value");
+            m_Pos += digits.size();
+        }
+        return value;
+    }
+
+    // Strings are only keys and profile names, so escapes beyond the simple ones are rejected.
+    std::string String() {
+        if (m_Pos == m_Text.size() || m_Text[m_Pos] != '"')
+            Fail("expected a string");
+        std::string out;
+        for (++m_Pos; m_Pos < m_Text.size(); ++m_Pos) {
+            char c = m_Text[m_Pos];
+            if (c == '"') {
+                ++m_Pos;
+                return out;
+            }
+            if (c == '\\') {
+                if (++m_Pos == m_Text.size())
+                    break;
+                c = m_Text[m_Pos];
+                if (c == 'n')
+                    c = '\n';
+                else if (c == 't')
+                    c = '\t';
+                else if (c != '"' && c != '\\' && c != '/')
+                    Fail("unsupported string escape");
+            }
+            out.push_back(c);
+        }
+        Fail("unterminated string");
+    }
+
+    std::string_view m_Text;
+    size_t m_Pos = 0;
+};
+
+// Reads [x, y] in percent of the map.
+void ReadPoint(const JsonValue *value, const char *name, float &x, float &y)
+{
+    if (!value || value->type != JsonValue::Array || value->items.size() != 2 ||
+        value->items[0].type != JsonValue::Number || value->items[1].type != JsonValue::Number)
+        Fail(std::string{"\""} + name + "\" must be [x, y]");
+    x = (float)value->items[0].number;
+    y = (float)value->items[1].number;
+    if (x < 0.f || x > 100.f || y < 0.f || y > 100.f)
+        Fail(std::string{"\""} + name + "\" must be within 0..100");
+}
+
+void WriteJsonString(std::ostream &os, std::string_view text)
+{
+    os << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            os << '\\' << c;
+        else if ((unsigned char)c < 0x20)
+            os << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c << std::dec << std::setfill(' ');
+        else
+            os << c;
+    }
+    os << '"';
+}
+
+// Writes all of `data`; false if the peer went away.
+bool SendAll(int fd, const char *data, size_t size)
+{
+    while (size > 0) {
+        const ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return false;
+        data += sent;
+        size -= (size_t)sent;
+    }
+    return true;
+}
+
+bool FillAddress(const std::string &path, sockaddr_un &address)
+{
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path))
+        return false;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+} // namespace
+
+RouteServer::RouteServer(RouteService &service, std::string socket_path, unsigned threads)
+    : m_Service(service), m_SocketPath(std::move(socket_path)), m_Workers(std::max(threads, 1u))
+{
+}
+
+RouteServer::~RouteServer()
+{
+    Stop();
+    if (m_Listener >= 0) {
+        close(m_Listener);
+        unlink(m_SocketPath.c_str());
+    }
+}
+
+bool RouteServer::Listen(std::string *why)
+{
+    auto fail = [&](const std::string &reason) {
+        if (why)
+            *why = reason;
+        if (m_Listener >= 0)
+            close(m_Listener);
+        m_Listener = -1;
+        return false;
+    };
+    sockaddr_un address;
+    if (!FillAddress(m_SocketPath, address))
+        return fail("invalid socket path " + m_SocketPath);
+    m_Listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_Listener < 0)
+        return fail(std::string{"socket: "} + std::strerror(errno));
+    // A socket file left behind by a previous run would make bind fail.
+    unlink(m_SocketPath.c_str());
+    if (bind(m_Listener, (const sockaddr *)&address, sizeof(address)) < 0)
+        return fail("bind " + m_SocketPath + ": " + std::strerror(errno));
+    if (listen(m_Listener, SOMAXCONN) < 0)
+        return fail(std::string{"listen: "} + std::strerror(errno));
+    return true;
+}
+
+struct RouteServer::Connection {
+    int fd = -1;
+    std::string buffer; // received bytes not yet handed out
+    bool open = true;   // false once the peer stops sending
+    // Set while a worker answers a request; the poll loop leaves the connection alone meanwhile.
+    std::atomic<bool> busy{false};
+    bool failed = false; // the response could not be sent; written by the worker
+};
+
+// Self-pipe through which workers wake the poll loop. Workers hold on to it
+// until they are done with it, so it closes after the last one.
+struct RouteServer::WakePipe {
+    int fds[2] = {-1, -1};
+
+    WakePipe() {
+        if (pipe2(fds, O_CLOEXEC | O_NONBLOCK) < 0)
+            fds[0] = fds[1] = -1;
+    }
+    ~WakePipe() {
+        for (int fd : fds)
+            if (fd >= 0)
+                close(fd);
+    }
+    void Wake() const {
+        const char woken = 1;
+        [[maybe_unused]] ssize_t written = write(fds[1], &woken, 1); // a full pipe wakes the loop anyway
+    }
+    void Drain() const {
+        for (char drained[64]; read(fds[0], drained, sizeof(drained)) > 0;)
+            ;
+    }
+};
+
+void RouteServer::Serve()
+{
+    const auto wake = std::make_shared<WakePipe>();
+    if (m_Listener < 0 || wake->fds[0] < 0)
+        return;
+
+    std::vector<std::unique_ptr<Connection>> connections;
+    std::vector<pollfd> polled;
+    while (!m_Stopping) {
+        polled.clear();
+        polled.push_back({m_Listener, POLLIN, 0});
+        polled.push_back({wake->fds[0], POLLIN, 0});
+        for (const auto &connection : connections) // poll ignores negative descriptors
+            polled.push_back({connection->busy || !connection->open ? -1 : connection->fd, POLLIN, 0});
+        if (poll(polled.data(), polled.size(), kPollMillis) < 0 && errno != EINTR)
+            break;
+
+        if (polled[1].revents & POLLIN)
+            wake->Drain();
+        for (size_t i = 0; i < connections.size(); ++i)
+            if (polled[i + 2].revents & (POLLIN | POLLHUP | POLLERR))
+                connections[i]->open = Receive(*connections[i]);
+        if (polled[0].revents & POLLIN) {
+            const int fd = accept4(m_Listener, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd >= 0) {
+                connections.push_back(std::make_unique<Connection>());
+                connections.back()->fd = fd;
+            }
+        }
+
+        // Answer what idle connections have sent; drop them once they are done.
+        for (size_t i = 0; i < connections.size();) {
+            Connection &connection = *connections[i];
+            if (!connection.busy)
+                Dispatch(connection, wake);
+            if (!connection.busy && (connection.failed || !connection.open)) {
+                close(connection.fd);
+                connections.erase(connections.begin() + i);
+            }
+            else
+                ++i;
+        }
+    }
+
+    // Requests in flight still use their connections.
+    for (const auto &connection : connections) {
+        while (connection->busy) {
+            pollfd woken{wake->fds[0], POLLIN, 0};
+            poll(&woken, 1, kPollMillis);
+            wake->Drain();
+        }
+        close(connection->fd);
+    }
+}
+
+bool RouteServer::Receive(Connection &connection)
+{
+    char chunk[4096];
+    ssize_t received;
+    while ((received = recv(connection.fd, chunk, sizeof(chunk), MSG_DONTWAIT)) < 0 && errno == EINTR)
+        ;
+    if (received < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    connection.buffer.append(chunk, (size_t)received);
+    return received > 0;
+}
+
+void RouteServer::Dispatch(Connection &connection, const std::shared_ptr<WakePipe> &wake)
+{
+    const size_t end = connection.buffer.find('\n');
+    if (end == std::string::npos) {
+        // Without a newline in sight the request may never end.
+        if (connection.buffer.size() > kMaxRequestSize)
+            connection.failed = true;
+        return;
+    }
+    std::string request = connection.buffer.substr(0, end);
+    connection.buffer.erase(0, end + 1);
+    connection.busy = true;
+    m_Workers.Submit([this, &connection, wake, request = std::move(request)] {
+        // Hands the connection back to the poll loop however the request ends; the
+        // loop may drop it from then on.
+        struct Release {
+            Connection &connection;
+            const WakePipe &wake;
+            ~Release() {
+                connection.busy = false;
+                wake.Wake();
+            }
+        } release{connection, *wake};
+        bool sent = false;
+        try {
+            std::string response = Handle(request);
+            response.push_back('\n');
+            sent = SendAll(connection.fd, response.data(), response.size());
+        }
+        catch (...) {
+        }
+        connection.failed = !sent;
+    });
+}
+
+std::string RouteServer::Handle(std::string_view request)
+{
+    const auto start = std::chrono::steady_clock::now();
+    std::string op = "invalid";
+    std::ostringstream out;
+    out << std::setprecision(7);
+    try {
+        const JsonValue json = JsonReader{request}.Document();
+        const JsonValue *op_value = json.Find("op");
+        if (json.type != JsonValue::Object || !op_value || op_value->type != JsonValue::String)
+            Fail("request must be an object with a string \"op\"");
+        // Only known ops get a latency entry, so clients can't add keys of their own.
+        static const char *const kOps[] = {"route", "nearest", "matrix", "stats"};
+        if (std::find(std::begin(kOps), std::end(kOps), op_value->string) == std::end(kOps))
+            Fail("unknown op");
+        op = op_value->string;
+
+        int profile = 0;
+        if (const JsonValue *name = json.Find("profile")) {
+            profile = name->type == JsonValue::String ? m_Service.FindProfile(name->string) : -1;
+            if (profile < 0)
+                Fail("unknown profile");
+        }
+
+        if (op == "route") {
+            float start_x, start_y, end_x, end_y;
+            ReadPoint(json.Find("start"), "start", start_x, start_y);
+            ReadPoint(json.Find("end"), "end", end_x, end_y);
+            SearchLimits limits;
+            if (const JsonValue *timeout = json.Find("timeout_ms"); timeout && timeout->type == JsonValue::Number)
+                limits.deadline = std::chrono::steady_clock::now() +
+                                  std::chrono::microseconds((long long)(timeout->number * 1000.));
+            const RouteQueryResult result = m_Service.Run(start_x, start_y, end_x, end_y, limits, profile);
+            out << "{\"status\":\"" << ToString(result.status) << "\",\"distance\":" << result.stats.distance
+                << ",\"expanded\":" << result.stats.nodes_expanded << ",\"nodes\":[";
+            for (size_t i = 0; i < result.path.size(); ++i)
+                out << (i ? "," : "") << result.path.nodes[i];
+            out << "]}";
+        }
+        else if (op == "nearest") {
+            float x, y;
+            ReadPoint(json.Find("point"), "point", x, y);
+            const SegmentSnap snap = m_Service.Snap(x, y, profile);
+            if (!snap.Valid())
+                Fail("map has no roads");
+            const RouteGraph &graph = m_Service.Graph(profile);
+            const int node = snap.t <= 0.5f ? snap.from : snap.to;
+            const auto coord = graph.Coord(node);
+            const double distance = std::hypot(coord.x - x * 0.01, coord.y - y * 0.01) * graph.MetricScale();
+            out << "{\"node\":" << node << ",\"x\":" << coord.x * 100. << ",\"y\":" << coord.y * 100.
+                << ",\"distance\":" << distance << "}";
+        }
+        else if (op == "matrix") {
+            const JsonValue *points = json.Find("points");
+            if (!points || points->type != JsonValue::Array)
+                Fail("\"points\" must be an array of [x, y]");
+            if (points->items.size() > kMaxMatrixPoints)
+                Fail("too many points");
+            const size_t n = points->items.size();
+            std::vector<float> xs(n), ys(n);
+            for (size_t i = 0; i < n; ++i)
+                ReadPoint(&points->items[i], "points", xs[i], ys[i]);
+            // Fans out to the service's pool, which is separate from the connection threads.
+            std::vector<std::future<RouteQueryResult>> cells;
+            for (size_t i = 0; i < n; ++i)
+                for (size_t j = 0; j < n; ++j)
+                    cells.push_back(m_Service.Query(xs[i], ys[i], xs[j], ys[j], {}, profile));
+            out << "{\"distances\":[";
+            for (size_t i = 0; i < n; ++i) {
+                out << (i ? ",[" : "[");
+                for (size_t j = 0; j < n; ++j) {
+                    const RouteQueryResult result = cells[i * n + j].get();
+                    out << (j ? "," : "");
+                    if (result.status == SearchStatus::Found)
+                        out << result.stats.distance;
+                    else
+                        out << "null";
+                }
+                out << "]";
+            }
+            out << "]}";
+        }
+        else if (op == "stats") {
+            std::lock_guard<std::mutex> lock{m_LatencyMutex};
+            out << "{";
+            bool first = true;
+            for (const auto &[name, latencies] : m_Latencies) {
+                out << (first ? "" : ",");
+                WriteJsonString(out, name);
+                out << ":{\"count\":" << latencies.Count() << ",\"p50_us\":" << latencies.Percentile(50)
+                    << ",\"p99_us\":" << latencies.Percentile(99) << "}";
+                first = false;
+            }
+            out << "}";
+        }
+    }
+    catch (const std::logic_error &error) {
+        out.str("");
+        out << "{\"error\":";
+        WriteJsonString(out, error.what());
+        out << "}";
+    }
+    catch (const std::exception &) {
+        // E.g. out of memory while searching; the details are not the client's business.
+        op = "invalid";
+        out.str("");
+        out << "{\"error\":\"internal error\"}";
+    }
+    if (op != "stats")
+        RecordLatency(op, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    return out.str();
+}
+
+void RouteServer::RecordLatency(const std::string &op, double micros)
+{
+    std::lock_guard<std::mutex> lock{m_LatencyMutex};
+    m_Latencies[op].Add(micros);
+}
+
+void RouteServer::WriteLatencyReport(std::ostream &os) const
+{
+    std::lock_guard<std::mutex> lock{m_LatencyMutex};
+    for (const auto &[name, latencies] : m_Latencies) {
+        os << std::left << std::setw(10) << name << std::right
+           << " requests " << std::setw(8) << latencies.Count()
+           << "  p50 " << std::setw(10) << latencies.Percentile(50) << " us"
+           << "  p99 " << std::setw(10) << latencies.Percentile(99) << " us\n";
+    }
+}
+
+RouteClient::~RouteClient()
+{
+    if (m_Socket >= 0)
+        close(m_Socket);
+}
+
+bool RouteClient::Connect(const std::string &socket_path)
+{
+    sockaddr_un address;
+    if (!FillAddress(socket_path, address))
+        return false;
+    if (m_Socket >= 0)
+        close(m_Socket);
+    m_Buffer.clear();
+    m_Socket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_Socket >= 0 && connect(m_Socket, (const sockaddr *)&address, sizeof(address)) == 0)
+        return true;
+    if (m_Socket >= 0)
+        close(m_Socket);
+    m_Socket = -1;
+    return false;
+}
+
+std::string RouteClient::Request(std::string_view request)
+{
+    std::string line{request};
+    line.push_back('\n');
+    if (m_Socket < 0 || !SendAll(m_Socket, line.data(), line.size()))
+        return {};
+    char chunk[4096];
+    size_t end;
+    while ((end = m_Buffer.find('\n')) == std::string::npos) {
+        const ssize_t received = recv(m_Socket, chunk, sizeof(chunk), 0);
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0) {
+            close(m_Socket);
+            m_Socket = -1;
+            return {};
+        }
+        m_Buffer.append(chunk, (size_t)received);
+    }
+    std::string response = m_Buffer.substr(0, end);
+    m_Buffer.erase(0, end + 1);
+    return response;
+}
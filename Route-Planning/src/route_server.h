@@ -0,0 +1,101 @@
+#ifndef ROUTE_SERVER_H
+#define ROUTE_SERVER_H
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "route_service.h"
+#include "search_stats.h"
+#include "worker_pool.h"
+
+// Long-running routing daemon answering requests over a Unix domain socket, so
+// the map and the profile graphs are loaded once instead of per query.
+//
+// The protocol is line-delimited JSON: every request is one JSON object on one
+// line and gets one response line. Coordinates are percentages of the map, as
+// for RouteService; distances are in meters.
+//
+//   {"op":"route","start":[10,10],"end":[90,90],"profile":"car","timeout_ms":50}
+//     -> {"status":"found","distance":832.8,"expanded":412,"nodes":[45,79,...]}
+//   {"op":"nearest","point":[50,50],"profile":"foot"}
+//     -> {"node":1234,"x":50.1,"y":49.8,"distance":3.2}
+//   {"op":"matrix","points":[[10,10],[50,50],[90,90]]}
+//     -> {"distances":[[0,412.5,832.8],[...],[...]]}, null where there is no route
+//   {"op":"stats"}
+//     -> {"route":{"count":12,"p50_us":310,"p99_us":910},...}
+//
+// "profile" is optional and defaults to the service's profile 0. Malformed
+// requests get {"error":"..."} and the connection stays open. One thread polls
+// the listener and every connection and hands each complete request line to a
+// pool of threads, so idle connections hold no thread. A connection has at most
+// one request in flight, which keeps its responses in request order.
+class RouteServer {
+  public:
+    RouteServer(RouteService &service, std::string socket_path,
+                unsigned threads = std::thread::hardware_concurrency());
+    ~RouteServer();
+    RouteServer(const RouteServer &) = delete;
+    RouteServer &operator=(const RouteServer &) = delete;
+
+    // Creates the socket, replacing a stale one; false with the reason in `why` on failure.
+    bool Listen(std::string *why = nullptr);
+    // Accepts clients and serves their requests until Stop(); returns
+    // immediately if not listening.
+    void Serve();
+    // Makes Serve() and the open connections return. Safe to call from a signal handler.
+    void Stop() { m_Stopping = true; }
+
+    // Answers one request line, without the trailing newline.
+    std::string Handle(std::string_view request);
+    // Request counts and latency percentiles per operation.
+    void WriteLatencyReport(std::ostream &os) const;
+
+    // Most points a matrix request may contain.
+    static constexpr size_t kMaxMatrixPoints = 100;
+
+  private:
+    struct Connection;
+    struct WakePipe;
+
+    // Reads what `connection` has sent; false once the peer closed or failed.
+    bool Receive(Connection &connection);
+    // Hands the next complete request line of an idle connection to a worker,
+    // which wakes the poll loop through `wake` when the response is sent.
+    void Dispatch(Connection &connection, const std::shared_ptr<WakePipe> &wake);
+    void RecordLatency(const std::string &op, double micros);
+
+    RouteService &m_Service;
+    std::string m_SocketPath;
+    int m_Listener = -1;
+    std::atomic<bool> m_Stopping{false};
+    mutable std::mutex m_LatencyMutex;
+    std::map<std::string, LatencyHistogram> m_Latencies;
+    // Last, so that requests finish before the members above go away.
+    WorkerPool m_Workers;
+};
+
+// Blocking client for RouteServer, used by the tests and benchmarks.
+class RouteClient {
+  public:
+    RouteClient() = default;
+    ~RouteClient();
+    RouteClient(const RouteClient &) = delete;
+    RouteClient &operator=(const RouteClient &) = delete;
+
+    bool Connect(const std::string &socket_path);
+    bool Connected() const { return m_Socket >= 0; }
+    // Sends one request line and returns the response line, or "" if the connection failed.
+    std::string Request(std::string_view request);
+
+  private:
+    int m_Socket = -1;
+    std::string m_Buffer;
+};
+
+#endif
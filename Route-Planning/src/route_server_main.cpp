@@ -0,0 +1,95 @@
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "mapped_file.h"
+#include "preprocess.h"
+#include "route_model.h"
+#include "route_server.h"
+#include "routing_profile.h"
+
+// rp_server: loads a map and its preprocessing artifact once and answers route, nearest-node and matrix
+// requests on a Unix domain socket until interrupted. See route_server.h for
+// the protocol.
+
+static RouteServer *g_Server = nullptr;
+
+static void PrintUsage()
+{
+    std::cout << "Usage: rp_server [-f filename.osm] [-s socket] [-j threads] [-p car,bike,foot]" << std::endl;
+    std::cout << "Serves line-delimited JSON requests on the socket (default /tmp/rp_server.sock)." << std::endl;
+}
+
+static void HandleSignal(int)
+{
+    if (g_Server)
+        g_Server->Stop();
+}
+
+int main(int argc, const char **argv)
+{
+    std::string osm_data_file = "../map.osm";
+    std::string socket_path = "/tmp/rp_server.sock";
+    unsigned threads = std::thread::hardware_concurrency();
+    std::vector<RoutingProfile> profiles;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg{argv[i]};
+        if (arg == "-f" && i + 1 < argc)
+            osm_data_file = argv[++i];
+        else if (arg == "-s" && i + 1 < argc)
+            socket_path = argv[++i];
+        else if (arg == "-j" && i + 1 < argc)
+            threads = (unsigned)std::atoi(argv[++i]);
+        else if (arg == "-p" && i + 1 < argc)
+        {
+            std::istringstream names{argv[++i]};
+            for (std::string name; std::getline(names, name, ',');)
+            {
+                auto profile = RoutingProfile::Named(name);
+                if (!profile)
+                {
+                    std::cerr << "Unknown profile " << name << std::endl;
+                    return 1;
+                }
+                profiles.push_back(*profile);
+            }
+        }
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    MappedFile file{osm_data_file};
+    if (!file.Valid())
+    {
+        std::cerr << "Failed to read " << osm_data_file << std::endl;
+        return 1;
+    }
+    RouteModel model{std::move(file)};
+    RouteService service{model, threads, profiles};
+    service.UseLandmarks(LoadOrPreprocess(model.Graph(), osm_data_file, {16, threads}, std::cout).landmarks);
+    RouteServer server{service, socket_path, threads};
+    std::string why;
+    if (!server.Listen(&why))
+    {
+        std::cerr << why << std::endl;
+        return 1;
+    }
+
+    g_Server = &server;
+    std::signal(SIGINT, HandleSignal);
+    std::signal(SIGTERM, HandleSignal);
+    std::cout << "Serving " << osm_data_file << " with " << service.NumProfiles() << " profile(s) on " << socket_path
+              << std::endl;
+    server.Serve();
+    g_Server = nullptr;
+    server.WriteLatencyReport(std::cout);
+    return 0;
+}
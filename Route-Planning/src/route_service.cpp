@@ -0,0 +1,174 @@
+#include "route_service.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+RouteService::RouteService(RouteModel &model, unsigned threads, const std::vector<RoutingProfile> &profiles)
+    : m_Pool(threads)
+{
+    m_Profiles.push_back({"default", nullptr, &model.Graph(), nullptr});
+    auto graphs = BuildProfileGraphs(model, profiles, threads);
+    for (size_t i = 0; i < profiles.size(); ++i) {
+        const RouteGraph *graph = graphs[i].get();
+        m_Profiles.push_back({profiles[i].name, std::move(graphs[i]), graph, nullptr});
+    }
+    for (auto &profile : m_Profiles)
+        profile.segments = std::make_unique<SegmentRTree>(*profile.graph, threads);
+}
+
+void RouteService::UseLandmarks(Landmarks landmarks)
+{
+    if (landmarks.NumNodes() == m_Profiles[0].graph->NumNodes())
+        m_Landmarks = std::move(landmarks);
+}
+
+int RouteService::FindProfile(std::string_view name) const
+{
+    for (int i = 0; i < NumProfiles(); ++i)
+        if (m_Profiles[i].name == name)
+            return i;
+    return -1;
+}
+
+std::future<RouteQueryResult> RouteService::Query(float start_x, float start_y, float end_x, float end_y, SearchLimits limits,
+                                                  int profile)
+{
+    assert(profile >= 0 && profile < NumProfiles());
+    return m_Pool.Submit([=] { return Run(start_x, start_y, end_x, end_y, limits, profile); });
+}
+
+RouteQueryResult RouteService::Run(float start_x, float start_y, float end_x, float end_y, const SearchLimits &limits,
+                                   int profile)
+{
+    static thread_local SearchWorkspace workspace;
+    const RouteGraph &graph = *At(profile).graph;
+    const SegmentRTree &segments = *At(profile).segments;
+    RouteQueryResult result;
+    SearchStats &stats = result.stats;
+
+    {
+        ScopedMicros timer{stats.find_closest_us};
+        result.start = Snap(start_x, start_y, profile);
+        result.end = Snap(end_x, end_y, profile);
+    }
+    if (!result.start.Valid() || !result.end.Valid())
+        return result;
+    stats.start_node = result.start.from;
+    stats.end_node = result.end.from;
+
+    const auto sources = segments.SourceSeeds(result.start);
+    const auto targets = segments.TargetSeeds(result.end);
+    SearchResult search;
+    {
+        ScopedMicros timer{stats.search_us};
+        if (profile == 0 && m_Landmarks.Count() > 0)
+            search = m_Landmarks.Search(graph, workspace, sources, targets, &limits);
+        else
+            search = AStar(graph, workspace, sources, targets, &limits);
+    }
+    result.status = search.status;
+    stats.nodes_expanded = search.expanded;
+    stats.edges_relaxed = search.relaxed;
+    stats.open_list_peak = search.heap_peak;
+
+    // Costs depend on the profile, so distances come from the geometry.
+    auto leg = [&](const SegmentSnap &snap, int node) {
+        const auto coord = graph.Coord(node);
+        return (float)(std::hypot(snap.x - coord.x, snap.y - coord.y) * graph.MetricScale());
+    };
+
+    // Both points on one segment: travelling along it may beat leaving it.
+    const float direct = segments.DirectCost(result.start, result.end);
+    if (!search.Interrupted() && direct < RouteGraph::kClosed && direct <= search.cost) {
+        result.status = SearchStatus::Found;
+        stats.distance = (float)(std::hypot(result.start.x - result.end.x, result.start.y - result.end.y) *
+                                 graph.MetricScale());
+        return result;
+    }
+
+    {
+        ScopedMicros timer{stats.path_us};
+        const int last = search.Found() ? targets[search.target].node : search.closest;
+        if (last >= 0 && (search.Found() || search.Interrupted())) {
+            result.path = ExtractPath(graph, workspace, last);
+            const float offset = leg(result.start, result.path.nodes.front());
+            for (float &distance : result.path.distances)
+                distance += offset;
+        }
+    }
+    stats.distance = result.path.Length();
+    if (search.Found())
+        stats.distance += leg(result.end, result.path.nodes.back());
+    stats.path_nodes = (int)result.path.size();
+    return result;
+}
+
+FacilitySet RouteService::SnapFacilities(const std::vector<std::pair<float, float>> &points, int profile) const
+{
+    FacilitySet facilities{*At(profile).graph};
+    for (const auto &[x, y] : points)
+        facilities.Add(*At(profile).segments, Snap(x, y, profile));
+    return facilities;
+}
+
+std::vector<FacilityMatch> RouteService::NearestFacilities(float x, float y, const FacilitySet &facilities, int k,
+                                                           int profile) const
+{
+    static thread_local SearchWorkspace workspace;
+    const RouteGraph &graph = *At(profile).graph;
+    const SegmentRTree &segments = *At(profile).segments;
+    const SegmentSnap start = Snap(x, y, profile);
+    if (!start.Valid())
+        return {};
+    auto nearest = ::NearestFacilities(graph, workspace, segments.SourceSeeds(start), facilities, k);
+
+    // Facilities on the segment of the point may be closer along it than through its ends.
+    bool changed = false;
+    auto direct_to = [&](int facility, float) {
+        const float direct = segments.DirectCost(start, facilities.Snap(facility));
+        if (direct == RouteGraph::kClosed)
+            return;
+        auto found = std::find_if(nearest.begin(), nearest.end(),
+                                  [&](const FacilityMatch &match) { return match.facility == facility; });
+        if (found == nearest.end())
+            nearest.push_back({facility, direct});
+        else if (direct < found->cost)
+            found->cost = direct;
+        else
+            return;
+        changed = true;
+    };
+    facilities.ForEachAt(start.from, direct_to);
+    facilities.ForEachAt(start.to, direct_to);
+    if (changed) {
+        std::stable_sort(nearest.begin(), nearest.end(),
+                         [](const FacilityMatch &a, const FacilityMatch &b) { return a.cost < b.cost; });
+        if ((int)nearest.size() > k)
+            nearest.resize(k);
+    }
+
+    for (auto &match : nearest)
+        match.cost *= (float)graph.MetricScale();
+    return nearest;
+}
+
+std::vector<std::vector<FacilityMatch>> RouteService::NearestFacilities(const std::vector<std::pair<float, float>> &points,
+                                                                        const FacilitySet &facilities, int k,
+                                                                        int profile) const
+{
+    std::vector<std::vector<FacilityMatch>> nearest(points.size());
+    // Searches differ in length, so workers take points one at a time.
+    std::atomic<size_t> next{0};
+    std::vector<std::future<void>> done;
+    for (unsigned worker = 0; worker < std::min<size_t>(m_Pool.Size(), points.size()); ++worker)
+        done.push_back(m_Pool.Submit([&] {
+            for (size_t i = next++; i < points.size(); i = next++)
+                nearest[i] = NearestFacilities(points[i].first, points[i].second, facilities, k, profile);
+        }));
+    // The tasks refer to this frame, so all of them finish before any error is rethrown.
+    for (auto &task : done)
+        task.wait();
+    for (auto &task : done)
+        task.get();
+    return nearest;
+}
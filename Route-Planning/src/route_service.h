@@ -0,0 +1,104 @@
+#ifndef ROUTE_SERVICE_H
+#define ROUTE_SERVICE_H
+
+#include <cassert>
+#include <future>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "facilities.h"
+#include "graph_search.h"
+#include "landmarks.h"
+#include "route_model.h"
+#include "routing_profile.h"
+#include "search_limits.h"
+#include "search_stats.h"
+#include "segment_rtree.h"
+#include "worker_pool.h"
+
+struct RouteQueryResult {
+    SearchStatus status = SearchStatus::NoRoute;
+    // Graph nodes of the route between the snapped start and end points; empty
+    // when both lie on the same segment. Distances (in meters, whatever the
+    // profile weighs) include the leg from the start point, stats.distance also
+    // the leg to the end point. A cancelled or
+    // timed out query returns the part of the route explored so far.
+    RoutePath path;
+    SearchStats stats;
+    // Query points snapped onto their nearest road segments.
+    SegmentSnap start;
+    SegmentSnap end;
+};
+
+// Answers route queries asynchronously on a pool of worker threads. Query points
+// are snapped to the nearest point on a road segment, which joins the search as
+// a virtual node. Queries share the model's read-only RouteGraph and segment
+// R-tree, and search with per-thread workspaces,
+// so any number can run at once. Each query takes its own deadline and
+// cancellation token; a query that exceeds them returns early instead of
+// holding its worker.
+//
+// Profile 0 routes on the model's own graph. Further routing profiles get a
+// graph each, built in parallel over the model's nodes, and every query picks
+// the profile it routes with. A `profile` argument must be below NumProfiles();
+// look names up with FindProfile() and check for -1 first. Given the landmarks of the preprocessing
+// artifact, queries on profile 0 are guided by their bounds.
+class RouteService {
+  public:
+    explicit RouteService(RouteModel &model, unsigned threads = std::thread::hardware_concurrency(),
+                          const std::vector<RoutingProfile> &profiles = {});
+
+    // Guides queries on profile 0 with `landmarks` computed for the model's
+    // graph, e.g. from LoadOrPreprocess(). Call before the first query.
+    void UseLandmarks(Landmarks landmarks);
+
+    int NumProfiles() const { return (int)m_Profiles.size(); }
+    // Index of the profile called `name`, or -1.
+    int FindProfile(std::string_view name) const;
+    const RouteGraph &Graph(int profile = 0) const { return *At(profile).graph; }
+    // Closest point on a road of `profile` to a point given in percent of the map.
+    SegmentSnap Snap(float x, float y, int profile = 0) const {
+        return At(profile).segments->Nearest(x * 0.01, y * 0.01);
+    }
+
+    // Coordinates are percentages of the map, as for RoutePlanner.
+    std::future<RouteQueryResult> Query(float start_x, float start_y, float end_x, float end_y,
+                                        SearchLimits limits = {}, int profile = 0);
+    // Runs a query on the calling thread.
+    RouteQueryResult Run(float start_x, float start_y, float end_x, float end_y, const SearchLimits &limits = {},
+                         int profile = 0);
+
+    // Facilities at points (x, y) given in percent of the map, snapped onto the
+    // roads of `profile`; pass them to NearestFacilities() with the same profile.
+    FacilitySet SnapFacilities(const std::vector<std::pair<float, float>> &points, int profile = 0) const;
+    // The `k` facilities cheapest to reach by road from a point, cheapest first.
+    // Costs are scaled like distances: meters for the default profile.
+    std::vector<FacilityMatch> NearestFacilities(float x, float y, const FacilitySet &facilities, int k,
+                                                 int profile = 0) const;
+    // Same for many points, run on the service's workers; each worker reuses
+    // one search workspace. Must not be called from one of those workers.
+    std::vector<std::vector<FacilityMatch>> NearestFacilities(const std::vector<std::pair<float, float>> &points,
+                                                              const FacilitySet &facilities, int k,
+                                                              int profile = 0) const;
+
+  private:
+    struct Profile {
+        std::string name;
+        std::unique_ptr<RouteGraph> owned;
+        const RouteGraph *graph;
+        std::unique_ptr<SegmentRTree> segments;
+    };
+
+    const Profile &At(int profile) const {
+        assert(profile >= 0 && profile < NumProfiles());
+        return m_Profiles[profile];
+    }
+
+    std::vector<Profile> m_Profiles;
+    Landmarks m_Landmarks;
+    mutable WorkerPool m_Pool; // synchronized; const batches submit to it too
+};
+
+#endif
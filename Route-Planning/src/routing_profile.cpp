@@ -0,0 +1,91 @@
+#include "routing_profile.h"
+#include <atomic>
+#include "route_graph.h"
+#include "worker_pool.h"
+
+using Road = Model::Road;
+
+// Factors from typical speeds (km/h), relative to the fastest allowed type.
+static std::array<float, RoutingProfile::kRoadTypes> FromSpeeds(const std::array<float, RoutingProfile::kRoadTypes> &speeds)
+{
+    float fastest = 0.f;
+    for (float speed : speeds)
+        fastest = std::max(fastest, speed);
+    std::array<float, RoutingProfile::kRoadTypes> factors{};
+    for (int type = 0; type < RoutingProfile::kRoadTypes; ++type)
+        factors[type] = speeds[type] > 0.f ? fastest / speeds[type] : 0.f;
+    return factors;
+}
+
+RoutingProfile RoutingProfile::Default()
+{
+    RoutingProfile profile{"default", {}};
+    profile.factors.fill(1.f);
+    profile.factors[Road::Footway] = 0.f;
+    return profile;
+}
+
+RoutingProfile RoutingProfile::Car()
+{
+    std::array<float, kRoadTypes> speeds{};
+    speeds[Road::Invalid] = 0.f;
+    speeds[Road::Unclassified] = 40.f;
+    speeds[Road::Service] = 20.f;
+    speeds[Road::Residential] = 30.f;
+    speeds[Road::Tertiary] = 50.f;
+    speeds[Road::Secondary] = 60.f;
+    speeds[Road::Primary] = 70.f;
+    speeds[Road::Trunk] = 90.f;
+    speeds[Road::Motorway] = 110.f;
+    speeds[Road::Footway] = 0.f;
+    return {"car", FromSpeeds(speeds)};
+}
+
+RoutingProfile RoutingProfile::Bike()
+{
+    // Effective speeds: busy roads count as slower to steer routes onto quiet streets.
+    std::array<float, kRoadTypes> speeds{};
+    speeds[Road::Unclassified] = 18.f;
+    speeds[Road::Service] = 16.f;
+    speeds[Road::Residential] = 18.f;
+    speeds[Road::Tertiary] = 17.f;
+    speeds[Road::Secondary] = 14.f;
+    speeds[Road::Primary] = 12.f;
+    speeds[Road::Footway] = 8.f;
+    return {"bike", FromSpeeds(speeds)};
+}
+
+RoutingProfile RoutingProfile::Pedestrian()
+{
+    RoutingProfile profile{"foot", {}};
+    profile.factors.fill(1.f);
+    profile.factors[Road::Invalid] = 0.f;
+    profile.factors[Road::Trunk] = 0.f;
+    profile.factors[Road::Motorway] = 0.f;
+    return profile;
+}
+
+std::optional<RoutingProfile> RoutingProfile::Named(std::string_view name)
+{
+    if (name == "default")
+        return Default();
+    if (name == "car")
+        return Car();
+    if (name == "bike")
+        return Bike();
+    if (name == "foot")
+        return Pedestrian();
+    return std::nullopt;
+}
+
+std::vector<std::unique_ptr<RouteGraph>> BuildProfileGraphs(const Model &model, const std::vector<RoutingProfile> &profiles,
+                                                            unsigned threads)
+{
+    std::vector<std::unique_ptr<RouteGraph>> graphs(profiles.size());
+    std::atomic<size_t> next{0};
+    ParallelFor(std::max(threads, 1u), [&](size_t, size_t) {
+        for (size_t i; (i = next++) < profiles.size();)
+            graphs[i] = std::make_unique<RouteGraph>(model, profiles[i]);
+    }, std::max(threads, 1u));
+    return graphs;
+}
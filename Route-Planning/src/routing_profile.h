@@ -0,0 +1,44 @@
+#ifndef ROUTING_PROFILE_H
+#define ROUTING_PROFILE_H
+
+#include <array>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "model.h"
+
+class RouteGraph;
+
+// Which roads a mode of travel may use and how much each costs. Factors are
+// relative to the fastest allowed road type (factor 1), so an arc costs its
+// length times the factor of its road type and never less than its length,
+// which keeps the Euclidean heuristic admissible. A factor of 0 excludes the type.
+struct RoutingProfile {
+    static constexpr int kRoadTypes = Model::Road::Footway + 1;
+
+    std::string name;
+    std::array<float, kRoadTypes> factors{};
+
+    bool Allows(Model::Road::Type type) const { return factors[type] > 0.f; }
+
+    // Every road except footways, all at their length: what RouteGraph(model) routes on.
+    static RoutingProfile Default();
+    // Travel time at typical speeds on each road type; no footways.
+    static RoutingProfile Car();
+    // No motorways or trunk roads, busy roads discouraged, footways at walking pace.
+    static RoutingProfile Bike();
+    // Everything except motorways and trunk roads at walking speed.
+    static RoutingProfile Pedestrian();
+    // "default", "car", "bike" or "foot".
+    static std::optional<RoutingProfile> Named(std::string_view name);
+};
+
+// Builds one RouteGraph per profile, all sharing the node coordinates of
+// `model`, on up to `threads` threads.
+std::vector<std::unique_ptr<RouteGraph>> BuildProfileGraphs(const Model &model, const std::vector<RoutingProfile> &profiles,
+                                                            unsigned threads = std::thread::hardware_concurrency());
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef SEARCH_LIMITS_H
+#define SEARCH_LIMITS_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+// Shared flag that lets another thread abort a running search. Copies refer to
+// the same flag.
+class CancellationToken {
+  public:
+    CancellationToken() : m_Cancelled(std::make_shared<std::atomic<bool>>(false)) {}
+    void Cancel() { m_Cancelled->store(true, std::memory_order_relaxed); }
+    bool IsCancelled() const { return m_Cancelled->load(std::memory_order_relaxed); }
+
+  private:
+    std::shared_ptr<std::atomic<bool>> m_Cancelled;
+};
+
+enum class SearchStatus { Found, NoRoute, Cancelled, TimedOut };
+
+inline const char *ToString(SearchStatus status)
+{
+    switch (status) {
+    case SearchStatus::Found: return "found";
+    case SearchStatus::NoRoute: return "no_route";
+    case SearchStatus::Cancelled: return "cancelled";
+    case SearchStatus::TimedOut: return "timed_out";
+    }
+    return "unknown";
+}
+
+// Deadline and cancellation for one search. Searches call Check() every
+// kCheckInterval expansions so the clock stays off the hot path.
+struct SearchLimits {
+    static constexpr long kCheckInterval = 64;
+
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    CancellationToken token;
+
+    // Found while the search may continue, Cancelled or TimedOut otherwise.
+    SearchStatus Check() const {
+        if (token.IsCancelled())
+            return SearchStatus::Cancelled;
+        if (deadline != std::chrono::steady_clock::time_point::max() && std::chrono::steady_clock::now() >= deadline)
+            return SearchStatus::TimedOut;
+        return SearchStatus::Found;
+    }
+};
+
+#endif
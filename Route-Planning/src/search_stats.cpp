@@ -0,0 +1,87 @@
+#include "search_stats.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+
+void SearchStats::WriteJsonLine(std::ostream &os) const
+{
+    os << "{\"start_node\":" << start_node
+       << ",\"end_node\":" << end_node
+       << ",\"distance\":" << distance
+       << ",\"path_nodes\":" << path_nodes
+       << ",\"nodes_expanded\":" << nodes_expanded
+       << ",\"edges_relaxed\":" << edges_relaxed
+       << ",\"open_list_peak\":" << open_list_peak
+       << ",\"find_closest_us\":" << find_closest_us
+       << ",\"search_us\":" << search_us
+       << ",\"path_us\":" << path_us
+       << ",\"suboptimality_bound\":" << suboptimality_bound
+       << "}\n";
+}
+
+void SearchStatsAggregate::Add(const SearchStats &stats)
+{
+    m_Stats.push_back(stats);
+}
+
+double Percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty())
+        return 0.;
+    auto rank = (size_t)(p / 100. * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+void LatencyHistogram::Add(double micros)
+{
+    // Bucket b holds (2^((b-1)/8), 2^(b/8)] us; the first also everything below.
+    const double position = micros > 1. ? std::ceil(std::log2(micros) * kBucketsPerDoubling) : 0.;
+    m_Buckets[(size_t)std::min(position, (double)kBuckets - 1)]++;
+    m_Count++;
+    m_Max = std::max(m_Max, micros);
+}
+
+double LatencyHistogram::Percentile(double p) const
+{
+    if (m_Count == 0)
+        return 0.;
+    // Same rank as ::Percentile() on the sorted samples.
+    const long rank = std::min((long)(p / 100. * (m_Count - 1) + 0.5), m_Count - 1);
+    long seen = 0;
+    int bucket = 0;
+    while ((seen += m_Buckets[bucket]) <= rank)
+        ++bucket;
+    return std::min(std::exp2((double)bucket / kBucketsPerDoubling), m_Max);
+}
+
+void SearchStatsAggregate::WriteReport(std::ostream &os) const
+{
+    os << "Queries: " << m_Stats.size() << "\n";
+    if (m_Stats.empty())
+        return;
+
+    auto row = [&](const char *name, std::function<double(const SearchStats &)> field) {
+        std::vector<double> values;
+        values.reserve(m_Stats.size());
+        double sum = 0.;
+        for (const auto &stats : m_Stats) {
+            values.push_back(field(stats));
+            sum += values.back();
+        }
+        std::sort(values.begin(), values.end());
+        os << std::left << std::setw(18) << name << std::right
+           << " mean " << std::setw(10) << sum / values.size()
+           << "  p50 " << std::setw(10) << Percentile(values, 50)
+           << "  p99 " << std::setw(10) << Percentile(values, 99)
+           << "  max " << std::setw(10) << values.back()
+           << "  total " << sum << "\n";
+    };
+    row("nodes_expanded", [](const SearchStats &s) { return (double)s.nodes_expanded; });
+    row("edges_relaxed", [](const SearchStats &s) { return (double)s.edges_relaxed; });
+    row("open_list_peak", [](const SearchStats &s) { return (double)s.open_list_peak; });
+    row("find_closest_us", [](const SearchStats &s) { return s.find_closest_us; });
+    row("search_us", [](const SearchStats &s) { return s.search_us; });
+    row("path_us", [](const SearchStats &s) { return s.path_us; });
+    row("total_us", [](const SearchStats &s) { return s.TotalMicros(); });
+}
@@ -0,0 +1,258 @@
+#include "segment_rtree.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include "worker_pool.h"
+
+static constexpr float kInfinity = std::numeric_limits<float>::infinity();
+
+double SegmentRTree::Box::MinDistanceSquared(double x, double y) const
+{
+    const double dx = x < min_x ? min_x - x : (x > max_x ? x - max_x : 0.);
+    const double dy = y < min_y ? min_y - y : (y > max_y ? y - max_y : 0.);
+    return dx * dx + dy * dy;
+}
+
+SegmentRTree::SegmentRTree(const RouteGraph &graph, unsigned threads) : m_Graph(graph)
+{
+    for (int node = 0; node < graph.NumNodes(); ++node)
+        for (int arc = graph.FirstArc(node); arc < graph.LastArc(node); ++arc)
+            if (node < graph.Head(arc))
+                m_Segments.push_back({node, graph.Head(arc)});
+
+    std::vector<Entry> level(m_Segments.size());
+    ParallelFor(m_Segments.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const auto &a = graph.Coord(m_Segments[i].from), &b = graph.Coord(m_Segments[i].to);
+            // Round outwards so float boxes never cut off part of the segment.
+            level[i].box = {std::nextafter((float)std::min(a.x, b.x), -kInfinity), std::nextafter((float)std::min(a.y, b.y), -kInfinity),
+                            std::nextafter((float)std::max(a.x, b.x), kInfinity), std::nextafter((float)std::max(a.y, b.y), kInfinity)};
+            level[i].first = (int)i;
+            level[i].count = 0;
+        }
+    }, threads);
+
+    // Store the segments in leaf order so a query touches neighbouring memory.
+    SortTileRecursive(level, threads);
+    std::vector<Segment> ordered(m_Segments.size());
+    for (size_t i = 0; i < level.size(); ++i) {
+        ordered[i] = m_Segments[level[i].first];
+        level[i].first = (int)i;
+    }
+    m_Segments = std::move(ordered);
+
+    for (bool sorted = true; !level.empty(); sorted = false) {
+        if (!sorted)
+            SortTileRecursive(level, threads);
+        m_Levels.push_back(std::move(level));
+        const auto &below = m_Levels.back();
+        if (below.size() == 1 && m_Levels.size() > 1)
+            break;
+        level.clear();
+        for (size_t first = 0; first < below.size(); first += kFanout) {
+            const int count = (int)std::min<size_t>(kFanout, below.size() - first);
+            Box box = below[first].box;
+            for (int i = 1; i < count; ++i) {
+                const Box &child = below[first + i].box;
+                box = {std::min(box.min_x, child.min_x), std::min(box.min_y, child.min_y),
+                       std::max(box.max_x, child.max_x), std::max(box.max_y, child.max_y)};
+            }
+            level.push_back({box, (int)first, count});
+        }
+    }
+}
+
+void SegmentRTree::SortTileRecursive(std::vector<Entry> &entries, unsigned threads)
+{
+    auto center_x = [](const Entry &e) { return e.box.min_x + e.box.max_x; };
+    auto center_y = [](const Entry &e) { return e.box.min_y + e.box.max_y; };
+    const size_t pages = (entries.size() + kFanout - 1) / kFanout;
+    const size_t slices = (size_t)std::ceil(std::sqrt((double)pages));
+    const size_t slice_size = slices * kFanout;
+
+    std::sort(entries.begin(), entries.end(), [&](const Entry &a, const Entry &b) { return center_x(a) < center_x(b); });
+    const size_t num_slices = (entries.size() + slice_size - 1) / slice_size;
+    ParallelFor(num_slices, [&](size_t begin, size_t end) {
+        for (size_t s = begin; s < end; ++s) {
+            auto first = entries.begin() + s * slice_size;
+            auto last = entries.begin() + std::min(entries.size(), (s + 1) * slice_size);
+            std::sort(first, last, [&](const Entry &a, const Entry &b) { return center_y(a) < center_y(b); });
+        }
+    }, threads);
+}
+
+SegmentSnap SegmentRTree::Project(const Segment &segment, double x, double y) const
+{
+    const auto &a = m_Graph.Coord(segment.from), &b = m_Graph.Coord(segment.to);
+    const double dx = b.x - a.x, dy = b.y - a.y;
+    const double length_squared = dx * dx + dy * dy;
+    double t = length_squared > 0. ? ((x - a.x) * dx + (y - a.y) * dy) / length_squared : 0.;
+    t = std::clamp(t, 0., 1.);
+    SegmentSnap snap;
+    snap.from = segment.from;
+    snap.to = segment.to;
+    snap.t = (float)t;
+    snap.x = a.x + t * dx;
+    snap.y = a.y + t * dy;
+    snap.distance = std::sqrt((snap.x - x) * (snap.x - x) + (snap.y - y) * (snap.y - y));
+    return snap;
+}
+
+SegmentSnap SegmentRTree::Nearest(double x, double y) const
+{
+    SegmentSnap best;
+    if (m_Levels.empty())
+        return best;
+
+    struct Candidate {
+        double distance_squared;
+        int level;
+        int index;
+        bool operator>(const Candidate &other) const { return distance_squared > other.distance_squared; }
+    };
+    // Reused between queries so a lookup does not allocate.
+    static thread_local std::vector<Candidate> queue;
+    queue.clear();
+    auto push = [&](Candidate candidate) {
+        queue.push_back(candidate);
+        std::push_heap(queue.begin(), queue.end(), std::greater<Candidate>());
+    };
+
+    double best_squared = std::numeric_limits<double>::infinity();
+    // Measures the segments below a level 1 entry directly instead of queueing them.
+    auto scan_segments = [&](const Entry &entry) {
+        for (int child = entry.first; child < entry.first + entry.count; ++child) {
+            if (m_Levels[0][child].box.MinDistanceSquared(x, y) >= best_squared)
+                continue;
+            SegmentSnap snap = Project(m_Segments[child], x, y);
+            if (snap.distance * snap.distance < best_squared) {
+                best_squared = snap.distance * snap.distance;
+                best = snap;
+            }
+        }
+    };
+
+    // A greedy descent to the closest leaf gives a tight first bound, so the
+    // best-first search below queues few entries.
+    const int root = (int)m_Levels.size() - 1;
+    int greedy = 0;
+    for (int level = root; level > 1; --level) {
+        const Entry &entry = m_Levels[level][greedy];
+        double closest = std::numeric_limits<double>::infinity();
+        for (int child = entry.first; child < entry.first + entry.count; ++child) {
+            const double d = m_Levels[level - 1][child].box.MinDistanceSquared(x, y);
+            if (d < closest) {
+                closest = d;
+                greedy = child;
+            }
+        }
+    }
+    scan_segments(m_Levels[1][greedy]);
+
+    push({m_Levels[root][0].box.MinDistanceSquared(x, y), root, 0});
+    while (!queue.empty() && queue.front().distance_squared < best_squared) {
+        const Candidate top = queue.front();
+        std::pop_heap(queue.begin(), queue.end(), std::greater<Candidate>());
+        queue.pop_back();
+
+        const Entry &entry = m_Levels[top.level][top.index];
+        if (top.level == 1) {
+            if (top.index != greedy)
+                scan_segments(entry);
+            continue;
+        }
+        for (int child = entry.first; child < entry.first + entry.count; ++child) {
+            const double d = m_Levels[top.level - 1][child].box.MinDistanceSquared(x, y);
+            if (d < best_squared)
+                push({d, top.level - 1, child});
+        }
+    }
+    return best;
+}
+
+std::vector<SegmentSnap> SegmentRTree::Candidates(double x, double y, double radius, size_t max_count) const
+{
+    std::vector<SegmentSnap> found;
+    if (m_Levels.empty() || max_count == 0)
+        return found;
+
+    // Best-first over entries and segments alike; segments are queued with their
+    // exact distance, so they come out in order.
+    struct Candidate {
+        double distance_squared;
+        int level;
+        int index;
+        bool operator>(const Candidate &other) const { return distance_squared > other.distance_squared; }
+    };
+    std::vector<Candidate> queue;
+    auto push = [&](Candidate candidate) {
+        queue.push_back(candidate);
+        std::push_heap(queue.begin(), queue.end(), std::greater<Candidate>());
+    };
+
+    const double radius_squared = radius * radius;
+    const int root = (int)m_Levels.size() - 1;
+    push({m_Levels[root][0].box.MinDistanceSquared(x, y), root, 0});
+    while (!queue.empty() && queue.front().distance_squared <= radius_squared && found.size() < max_count) {
+        const Candidate top = queue.front();
+        std::pop_heap(queue.begin(), queue.end(), std::greater<Candidate>());
+        queue.pop_back();
+
+        if (top.level == 0) {
+            found.push_back(Project(m_Segments[top.index], x, y));
+            continue;
+        }
+        const Entry &entry = m_Levels[top.level][top.index];
+        for (int child = entry.first; child < entry.first + entry.count; ++child) {
+            double d = m_Levels[top.level - 1][child].box.MinDistanceSquared(x, y);
+            if (d > radius_squared)
+                continue;
+            if (top.level == 1) {
+                d = Project(m_Segments[child], x, y).distance;
+                d *= d;
+            }
+            if (d <= radius_squared)
+                push({d, top.level - 1, child});
+        }
+    }
+    return found;
+}
+
+std::vector<SearchSeed> SegmentRTree::SourceSeeds(const SegmentSnap &snap) const
+{
+    std::vector<SearchSeed> seeds;
+    if (!snap.Valid())
+        return seeds;
+    const float forward = m_Graph.Cost(m_Graph.FindArc(snap.from, snap.to));
+    const float backward = m_Graph.Cost(m_Graph.FindArc(snap.to, snap.from));
+    if (forward < kInfinity)
+        seeds.push_back({snap.to, (1.f - snap.t) * forward});
+    if (backward < kInfinity)
+        seeds.push_back({snap.from, snap.t * backward});
+    return seeds;
+}
+
+std::vector<SearchSeed> SegmentRTree::TargetSeeds(const SegmentSnap &snap) const
+{
+    std::vector<SearchSeed> seeds;
+    if (!snap.Valid())
+        return seeds;
+    const float forward = m_Graph.Cost(m_Graph.FindArc(snap.from, snap.to));
+    const float backward = m_Graph.Cost(m_Graph.FindArc(snap.to, snap.from));
+    if (forward < kInfinity)
+        seeds.push_back({snap.from, snap.t * forward});
+    if (backward < kInfinity)
+        seeds.push_back({snap.to, (1.f - snap.t) * backward});
+    return seeds;
+}
+
+float SegmentRTree::DirectCost(const SegmentSnap &from, const SegmentSnap &to) const
+{
+    if (!from.Valid() || from.from != to.from || from.to != to.to)
+        return kInfinity;
+    if (from.t == to.t)
+        return 0.f;
+    if (from.t <= to.t)
+        return (to.t - from.t) * m_Graph.Cost(m_Graph.FindArc(from.from, from.to));
+    return (from.t - to.t) * m_Graph.Cost(m_Graph.FindArc(from.to, from.from));
+}
@@ -0,0 +1,73 @@
+#ifndef SEGMENT_RTREE_H
+#define SEGMENT_RTREE_H
+
+#include <thread>
+#include <vector>
+#include "graph_search.h"
+#include "route_graph.h"
+
+// A point snapped onto a road segment: the segment runs from graph node `from`
+// to `to`, and the point lies at fraction `t` along it.
+struct SegmentSnap {
+    int from = -1;
+    int to = -1;
+    float t = 0.f;
+    double x = 0.;
+    double y = 0.;
+    double distance = 0.; // from the query point, in map units
+
+    bool Valid() const { return from >= 0; }
+};
+
+// Static R-tree over the road segments of a RouteGraph, bulk loaded with
+// Sort-Tile-Recursive packing so every node is full and siblings overlap
+// little. Answers nearest-segment queries with a best-first descent.
+class SegmentRTree {
+  public:
+    explicit SegmentRTree(const RouteGraph &graph, unsigned threads = std::thread::hardware_concurrency());
+
+    // Closest point on any segment to (x, y) in map coordinates.
+    SegmentSnap Nearest(double x, double y) const;
+    // Up to `max_count` segments within `radius` of (x, y), closest first.
+    std::vector<SegmentSnap> Candidates(double x, double y, double radius, size_t max_count) const;
+
+    // Seeds that start a search at, or end it on, the snapped point as a virtual
+    // node: the cost of the part of the segment to each of its end nodes.
+    std::vector<SearchSeed> SourceSeeds(const SegmentSnap &snap) const;
+    std::vector<SearchSeed> TargetSeeds(const SegmentSnap &snap) const;
+    // Cost of travelling along one segment between two snaps on it; infinity
+    // when they are on different segments or the direction is closed.
+    float DirectCost(const SegmentSnap &from, const SegmentSnap &to) const;
+
+    size_t NumSegments() const { return m_Segments.size(); }
+    int Height() const { return (int)m_Levels.size(); }
+
+  private:
+    static constexpr int kFanout = 16;
+
+    struct Box {
+        float min_x, min_y, max_x, max_y;
+        double MinDistanceSquared(double x, double y) const;
+    };
+    // Level 0 entries are segments; above that, entries cover `count` entries
+    // of the level below starting at `first`.
+    struct Entry {
+        Box box;
+        int first;
+        int count;
+    };
+    struct Segment {
+        int from;
+        int to;
+    };
+
+    // Reorders `entries` so that groups of kFanout consecutive entries are spatially compact.
+    static void SortTileRecursive(std::vector<Entry> &entries, unsigned threads);
+    SegmentSnap Project(const Segment &segment, double x, double y) const;
+
+    const RouteGraph &m_Graph;
+    std::vector<Segment> m_Segments;
+    std::vector<std::vector<Entry>> m_Levels; // the root level holds a single entry
+};
+
+#endif
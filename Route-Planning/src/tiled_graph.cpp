@@ -0,0 +1,311 @@
+#include "tiled_graph.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+
+static const char kTileMagic[8] = {'R', 'P', 'T', 'I', 'L', 'E', 'S', '1'};
+
+template <typename T>
+static void WriteVector(std::ofstream &os, const std::vector<T> &values)
+{
+    uint64_t size = values.size();
+    os.write((const char *)&size, sizeof(size));
+    os.write((const char *)values.data(), size * sizeof(T));
+}
+
+// Reads a vector written by WriteVector(), which must hold exactly `expected`
+// values; the stored size is checked before anything is allocated.
+template <typename T>
+static bool ReadVector(std::ifstream &is, std::vector<T> &values, uint64_t expected)
+{
+    uint64_t size = 0;
+    if (!is.read((char *)&size, sizeof(size)) || size != expected)
+        return false;
+    const auto position = is.tellg();
+    if (position < 0 || !is.seekg(0, std::ios::end))
+        return false;
+    const uint64_t remaining = (uint64_t)(is.tellg() - position);
+    if (!is.seekg(position) || size > remaining / sizeof(T))
+        return false;
+    values.resize(size);
+    return (bool)is.read((char *)values.data(), size * sizeof(T));
+}
+
+size_t TiledGraph::Tile::Bytes() const
+{
+    return sizeof(Tile) + model_ids.size() * sizeof(int) + (x.size() + y.size() + costs.size()) * sizeof(float) +
+           (offsets.size() + head_tile.size() + head_local.size()) * sizeof(uint32_t);
+}
+
+bool TiledGraph::Write(const RouteGraph &graph, const std::string &directory, int grid)
+{
+    double min_x = std::numeric_limits<double>::max(), min_y = min_x;
+    double max_x = std::numeric_limits<double>::lowest(), max_y = max_x;
+    for (int node = 0; node < graph.NumNodes(); ++node)
+        if (graph.Degree(node) > 0) {
+            min_x = std::min(min_x, graph.Coord(node).x);
+            max_x = std::max(max_x, graph.Coord(node).x);
+            min_y = std::min(min_y, graph.Coord(node).y);
+            max_y = std::max(max_y, graph.Coord(node).y);
+        }
+    if (min_x > max_x || grid <= 0)
+        return false;
+
+    auto cell = [&](double value, double min, double max) {
+        return std::clamp((int)((value - min) / std::max(max - min, 1e-12) * grid), 0, grid - 1);
+    };
+    const int num_tiles = grid * grid;
+    std::vector<uint32_t> node_tile(graph.NumNodes()), node_local(graph.NumNodes());
+    std::vector<std::vector<int>> members(num_tiles);
+    for (int node = 0; node < graph.NumNodes(); ++node)
+        if (graph.Degree(node) > 0) {
+            const uint32_t tile = cell(graph.Coord(node).y, min_y, max_y) * grid + cell(graph.Coord(node).x, min_x, max_x);
+            node_tile[node] = tile;
+            node_local[node] = (uint32_t)members[tile].size();
+            members[tile].push_back(node);
+        }
+
+    for (int t = 0; t < num_tiles; ++t) {
+        if (members[t].empty())
+            continue;
+        Tile tile;
+        tile.offsets.push_back(0);
+        for (int node : members[t]) {
+            tile.model_ids.push_back(node);
+            tile.x.push_back((float)graph.Coord(node).x);
+            tile.y.push_back((float)graph.Coord(node).y);
+            for (int arc = graph.FirstArc(node); arc < graph.LastArc(node); ++arc) {
+                tile.head_tile.push_back(node_tile[graph.Head(arc)]);
+                tile.head_local.push_back(node_local[graph.Head(arc)]);
+                tile.costs.push_back(graph.Cost(arc));
+            }
+            tile.offsets.push_back((uint32_t)tile.costs.size());
+        }
+        std::ofstream os{directory + "/tile_" + std::to_string(t) + ".bin", std::ios::binary};
+        if (!os)
+            return false;
+        WriteVector(os, tile.model_ids);
+        WriteVector(os, tile.x);
+        WriteVector(os, tile.y);
+        WriteVector(os, tile.offsets);
+        WriteVector(os, tile.head_tile);
+        WriteVector(os, tile.head_local);
+        WriteVector(os, tile.costs);
+        if (!os)
+            return false;
+    }
+
+    std::ofstream index{directory + "/tiles.idx", std::ios::binary};
+    if (!index)
+        return false;
+    const double metric_scale = graph.MetricScale();
+    const uint32_t grid_size = grid;
+    std::vector<uint32_t> counts(num_tiles);
+    for (int t = 0; t < num_tiles; ++t)
+        counts[t] = (uint32_t)members[t].size();
+    index.write(kTileMagic, sizeof(kTileMagic));
+    index.write((const char *)&grid_size, sizeof(grid_size));
+    for (double value : {min_x, min_y, max_x, max_y, metric_scale})
+        index.write((const char *)&value, sizeof(value));
+    WriteVector(index, counts);
+    return (bool)index;
+}
+
+TiledGraph::TiledGraph(const std::string &directory, size_t memory_budget) : m_Directory(directory), m_Budget(memory_budget)
+{
+    std::ifstream index{directory + "/tiles.idx", std::ios::binary};
+    char magic[sizeof(kTileMagic)] = {};
+    uint32_t grid = 0;
+    if (!index.read(magic, sizeof(magic)) || std::memcmp(magic, kTileMagic, sizeof(magic)) != 0)
+        return;
+    index.read((char *)&grid, sizeof(grid));
+    for (double *value : {&m_MinX, &m_MinY, &m_MaxX, &m_MaxY, &m_MetricScale})
+        index.read((char *)value, sizeof(*value));
+    if (!index || grid == 0 || grid > (uint32_t)std::numeric_limits<int>::max() ||
+        !ReadVector(index, m_TileNodeCounts, (uint64_t)grid * grid))
+        return;
+    m_Grid = (int)grid;
+}
+
+std::string TiledGraph::TilePath(uint32_t tile) const
+{
+    return m_Directory + "/tile_" + std::to_string(tile) + ".bin";
+}
+
+std::shared_ptr<const TiledGraph::Tile> TiledGraph::Load(uint32_t tile)
+{
+    if (auto it = m_Resident.find(tile); it != m_Resident.end()) {
+        m_Lru.splice(m_Lru.begin(), m_Lru, it->second.lru);
+        return it->second.tile;
+    }
+
+    auto loaded = std::make_shared<Tile>();
+    const uint32_t nodes = m_TileNodeCounts[tile];
+    std::ifstream is{TilePath(tile), std::ios::binary};
+    if (!ReadVector(is, loaded->model_ids, nodes) || !ReadVector(is, loaded->x, nodes) ||
+        !ReadVector(is, loaded->y, nodes) || !ReadVector(is, loaded->offsets, (uint64_t)nodes + 1) ||
+        loaded->offsets.front() != 0 || !std::is_sorted(loaded->offsets.begin(), loaded->offsets.end()))
+        return nullptr;
+    const uint32_t arcs = loaded->offsets.back();
+    if (!ReadVector(is, loaded->head_tile, arcs) || !ReadVector(is, loaded->head_local, arcs) ||
+        !ReadVector(is, loaded->costs, arcs))
+        return nullptr;
+    for (uint32_t arc = 0; arc < arcs; ++arc)
+        if (loaded->head_tile[arc] >= m_TileNodeCounts.size() ||
+            loaded->head_local[arc] >= m_TileNodeCounts[loaded->head_tile[arc]])
+            return nullptr;
+
+    m_Lru.push_front(tile);
+    m_Resident[tile] = {loaded, m_Lru.begin()};
+    m_ResidentBytes += loaded->Bytes();
+    m_PeakBytes = std::max(m_PeakBytes, m_ResidentBytes);
+    m_TilesLoaded++;
+
+    // Evict cold tiles that no caller is holding on to.
+    for (auto it = std::prev(m_Lru.end()); m_ResidentBytes > m_Budget && it != m_Lru.begin();) {
+        auto resident = m_Resident.find(*it);
+        auto current = it--;
+        if (resident->second.tile.use_count() > 1)
+            continue;
+        m_ResidentBytes -= resident->second.tile->Bytes();
+        m_Resident.erase(resident);
+        m_Lru.erase(current);
+        m_Evictions++;
+    }
+    return loaded;
+}
+
+int TiledGraph::TileOf(double x, double y) const
+{
+    auto cell = [&](double value, double min, double max) {
+        return std::clamp((int)((value - min) / std::max(max - min, 1e-12) * m_Grid), 0, m_Grid - 1);
+    };
+    return cell(y, m_MinY, m_MaxY) * m_Grid + cell(x, m_MinX, m_MaxX);
+}
+
+bool TiledGraph::NearestNode(double x, double y, NodeKey &key)
+{
+    const int center = TileOf(x, y);
+    const int cx = center % m_Grid, cy = center / m_Grid;
+    const double tile_size = std::min(m_MaxX - m_MinX, m_MaxY - m_MinY) / m_Grid;
+    double best = std::numeric_limits<double>::max();
+    bool found = false;
+    for (int ring = 0; ring < m_Grid; ++ring) {
+        // Tiles on this ring are at least `ring - 1` whole tiles away from the point.
+        if (found && best <= (ring - 1) * tile_size)
+            break;
+        for (int ty = cy - ring; ty <= cy + ring; ++ty)
+            for (int tx = cx - ring; tx <= cx + ring; ++tx) {
+                if (std::max(std::abs(tx - cx), std::abs(ty - cy)) != ring || tx < 0 || ty < 0 || tx >= m_Grid || ty >= m_Grid)
+                    continue;
+                const uint32_t t = ty * m_Grid + tx;
+                if (m_TileNodeCounts[t] == 0)
+                    continue;
+                auto tile = Load(t);
+                if (!tile)
+                    return false;
+                for (int local = 0; local < tile->NumNodes(); ++local) {
+                    const double d = std::hypot(tile->x[local] - x, tile->y[local] - y);
+                    if (d < best) {
+                        best = d;
+                        key = Key(t, local);
+                        found = true;
+                    }
+                }
+            }
+    }
+    return found;
+}
+
+RoutePath TiledGraph::ShortestPath(double start_x, double start_y, double end_x, double end_y)
+{
+    RoutePath path;
+    NodeKey start, goal;
+    if (!Valid() || !NearestNode(start_x, start_y, start) || !NearestNode(end_x, end_y, goal))
+        return path;
+
+    float goal_x, goal_y;
+    {
+        auto tile = Load(goal >> 32);
+        if (!tile)
+            return path;
+        goal_x = tile->x[(uint32_t)goal];
+        goal_y = tile->y[(uint32_t)goal];
+    }
+
+    struct State {
+        float g;
+        NodeKey parent;
+        int model_id;
+    };
+    struct Entry {
+        float key;
+        float g;
+        NodeKey node;
+        bool operator>(const Entry &other) const { return key > other.key; }
+    };
+    std::unordered_map<NodeKey, State> states;
+    std::vector<Entry> open;
+    auto push = [&](float key, float g, NodeKey node) {
+        open.push_back({key, g, node});
+        std::push_heap(open.begin(), open.end(), std::greater<Entry>());
+    };
+
+    {
+        auto tile = Load(start >> 32);
+        if (!tile)
+            return path;
+        states[start] = {0.f, start, tile->model_ids[(uint32_t)start]};
+        push(std::hypot(tile->x[(uint32_t)start] - goal_x, tile->y[(uint32_t)start] - goal_y), 0.f, start);
+    }
+
+    bool found = false;
+    while (!open.empty()) {
+        const Entry top = open.front();
+        std::pop_heap(open.begin(), open.end(), std::greater<Entry>());
+        open.pop_back();
+        if (top.g > states[top.node].g)
+            continue;
+        if (top.node == goal) {
+            found = true;
+            break;
+        }
+
+        auto tile = Load(top.node >> 32);
+        if (!tile)
+            return path;
+        const uint32_t local = (uint32_t)top.node;
+        for (uint32_t arc = tile->offsets[local]; arc < tile->offsets[local + 1]; ++arc) {
+            const float cost = tile->costs[arc];
+            if (cost == RouteGraph::kClosed)
+                continue;
+            const NodeKey head = Key(tile->head_tile[arc], tile->head_local[arc]);
+            const float g = top.g + cost;
+            auto it = states.find(head);
+            if (it != states.end() && it->second.g <= g)
+                continue;
+            // Reaching a node in another tile is what pulls that tile in.
+            auto head_tile = tile->head_tile[arc] == (top.node >> 32) ? tile : Load(tile->head_tile[arc]);
+            if (!head_tile)
+                return path;
+            const uint32_t head_local = tile->head_local[arc];
+            states[head] = {g, top.node, head_tile->model_ids[head_local]};
+            push(g + std::hypot(head_tile->x[head_local] - goal_x, head_tile->y[head_local] - goal_y), g, head);
+        }
+    }
+    if (!found)
+        return path;
+
+    for (NodeKey node = goal;; node = states[node].parent) {
+        path.nodes.push_back(states[node].model_id);
+        path.distances.push_back(states[node].g * (float)m_MetricScale);
+        if (node == start)
+            break;
+    }
+    std::reverse(path.nodes.begin(), path.nodes.end());
+    std::reverse(path.distances.begin(), path.distances.end());
+    return path;
+}
@@ -0,0 +1,90 @@
+#ifndef TILED_GRAPH_H
+#define TILED_GRAPH_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "route_graph.h"
+#include "route_path.h"
+
+// Routing graph partitioned into a grid of spatial tiles stored on disk.
+//
+// Write() splits a RouteGraph into `grid` x `grid` tile files plus an index.
+// A TiledGraph then answers queries by loading tiles only when the search
+// frontier reaches them, keeping at most `memory_budget` bytes of tiles
+// resident (least recently used tiles are evicted). Search state is kept in
+// hash maps, so memory grows with the area a query touches rather than with
+// the size of the region.
+//
+// Tile files are written in host byte order. Files are not trusted: a missing
+// or malformed index leaves the graph !Valid(), and a tile that is missing,
+// truncated or refers to nodes outside the grid makes ShortestPath() return
+// an empty route, as it does when no route exists.
+class TiledGraph {
+  public:
+    struct Tile {
+        std::vector<int> model_ids;
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> head_tile;
+        std::vector<uint32_t> head_local;
+        std::vector<float> costs;
+
+        int NumNodes() const { return (int)model_ids.size(); }
+        size_t Bytes() const;
+    };
+
+    // Writes the tiles and index into an existing directory.
+    static bool Write(const RouteGraph &graph, const std::string &directory, int grid);
+
+    TiledGraph(const std::string &directory, size_t memory_budget);
+
+    bool Valid() const { return m_Grid > 0; }
+    int Grid() const { return m_Grid; }
+    double MetricScale() const { return m_MetricScale; }
+
+    // Shortest route between two points in map coordinates (see Model::Nodes()),
+    // snapped to their nearest routable nodes. Path nodes are Model node indices.
+    RoutePath ShortestPath(double start_x, double start_y, double end_x, double end_y);
+
+    size_t TilesLoaded() const { return m_TilesLoaded; }
+    size_t Evictions() const { return m_Evictions; }
+    size_t ResidentBytes() const { return m_ResidentBytes; }
+    size_t PeakBytes() const { return m_PeakBytes; }
+    size_t ResidentTiles() const { return m_Resident.size(); }
+
+  private:
+    using NodeKey = uint64_t;
+    static NodeKey Key(uint32_t tile, uint32_t local) { return ((NodeKey)tile << 32) | local; }
+
+    // Null if the tile file is missing or inconsistent with the index.
+    std::shared_ptr<const Tile> Load(uint32_t tile);
+    std::string TilePath(uint32_t tile) const;
+    int TileOf(double x, double y) const;
+    // Nearest routable node to a point, searching outwards ring by ring.
+    bool NearestNode(double x, double y, NodeKey &key);
+
+    std::string m_Directory;
+    size_t m_Budget;
+    int m_Grid = 0;
+    double m_MinX = 0., m_MinY = 0., m_MaxX = 0., m_MaxY = 0.;
+    double m_MetricScale = 1.;
+    std::vector<uint32_t> m_TileNodeCounts;
+
+    struct Resident {
+        std::shared_ptr<const Tile> tile;
+        std::list<uint32_t>::iterator lru;
+    };
+    std::unordered_map<uint32_t, Resident> m_Resident;
+    std::list<uint32_t> m_Lru; // most recently used first
+    size_t m_ResidentBytes = 0;
+    size_t m_PeakBytes = 0;
+    size_t m_TilesLoaded = 0;
+    size_t m_Evictions = 0;
+};
+
+#endif
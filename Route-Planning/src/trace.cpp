@@ -0,0 +1,96 @@
+#include "trace.h"
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Event {
+    const char *name;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point end;
+};
+
+// Each thread appends to its own buffer; the lock is only contended while Stop() collects them.
+struct ThreadBuffer {
+    std::mutex mutex;
+    std::vector<Event> events;
+    int tid;
+};
+
+std::atomic<bool> g_Enabled{false};
+std::mutex g_Mutex;
+std::string g_Path;
+std::chrono::steady_clock::time_point g_Origin;
+std::vector<std::shared_ptr<ThreadBuffer>> g_Buffers;
+
+ThreadBuffer &LocalBuffer()
+{
+    thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+        auto created = std::make_shared<ThreadBuffer>();
+        std::lock_guard<std::mutex> lock{g_Mutex};
+        created->tid = (int)g_Buffers.size() + 1;
+        g_Buffers.push_back(created);
+        return created;
+    }();
+    return *buffer;
+}
+
+} // namespace
+
+bool Tracer::Start(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock{g_Mutex};
+    if (g_Enabled.load())
+        return false;
+    g_Path = path;
+    g_Origin = std::chrono::steady_clock::now();
+    for (auto &buffer : g_Buffers) {
+        std::lock_guard<std::mutex> buffer_lock{buffer->mutex};
+        buffer->events.clear();
+    }
+    g_Enabled.store(true, std::memory_order_release);
+    return true;
+}
+
+bool Tracer::Enabled()
+{
+    return g_Enabled.load(std::memory_order_relaxed);
+}
+
+void Tracer::Record(const char *name, std::chrono::steady_clock::time_point start,
+                    std::chrono::steady_clock::time_point end)
+{
+    ThreadBuffer &buffer = LocalBuffer();
+    std::lock_guard<std::mutex> lock{buffer.mutex};
+    buffer.events.push_back({name, start, end});
+}
+
+bool Tracer::Stop()
+{
+    std::lock_guard<std::mutex> lock{g_Mutex};
+    if (!g_Enabled.exchange(false))
+        return false;
+
+    std::ofstream os{g_Path};
+    auto micros = [](std::chrono::steady_clock::duration d) {
+        return std::chrono::duration<double, std::micro>(d).count();
+    };
+    os << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+    bool first = true;
+    for (auto &buffer : g_Buffers) {
+        std::lock_guard<std::mutex> buffer_lock{buffer->mutex};
+        for (const auto &event : buffer->events) {
+            os << (first ? "\n" : ",\n") << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+               << ",\"ts\":" << micros(event.start - g_Origin) << ",\"dur\":" << micros(event.end - event.start) << "}";
+            first = false;
+        }
+        buffer->events.clear();
+    }
+    os << "\n]}\n";
+    return (bool)os;
+}
@@ -0,0 +1,61 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <chrono>
+#include <string>
+
+// Scoped trace points written as Chrome trace-event JSON (load the file in
+// chrome://tracing or Perfetto).
+//
+// TRACE_SCOPE("name") records the enclosing scope as a complete event. It
+// compiles to nothing unless the ROUTE_PLANNING_TRACING CMake option is on;
+// when compiled in, it costs one relaxed atomic load until Tracer::Start()
+// enables recording at runtime. Names must be string literals.
+class Tracer {
+  public:
+    // Starts recording; events are written to `path` by Stop(). Returns false if
+    // tracing is already running.
+    static bool Start(const std::string &path);
+    // Writes all recorded events and stops recording. Returns false on I/O errors.
+    static bool Stop();
+    static bool Enabled();
+    // Whether TRACE_SCOPE was compiled in.
+    static constexpr bool CompiledIn() {
+#ifdef ROUTE_PLANNING_TRACING
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    static void Record(const char *name, std::chrono::steady_clock::time_point start,
+                       std::chrono::steady_clock::time_point end);
+};
+
+class TraceScope {
+  public:
+    explicit TraceScope(const char *name) : m_Name(Tracer::Enabled() ? name : nullptr) {
+        if (m_Name)
+            m_Start = std::chrono::steady_clock::now();
+    }
+    ~TraceScope() {
+        if (m_Name)
+            Tracer::Record(m_Name, m_Start, std::chrono::steady_clock::now());
+    }
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+  private:
+    const char *m_Name;
+    std::chrono::steady_clock::time_point m_Start;
+};
+
+#ifdef ROUTE_PLANNING_TRACING
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__){name}
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#endif
+
+#endif
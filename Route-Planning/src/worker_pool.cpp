@@ -0,0 +1,36 @@
+#include "worker_pool.h"
+
+WorkerPool::WorkerPool(unsigned threads)
+{
+    if (threads == 0)
+        threads = 1;
+    for (unsigned i = 0; i < threads; ++i)
+        m_Threads.emplace_back(&WorkerPool::Run, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock{m_Mutex};
+        m_Stopping = true;
+    }
+    m_Condition.notify_all();
+    for (auto &thread : m_Threads)
+        thread.join();
+}
+
+void WorkerPool::Run()
+{
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock{m_Mutex};
+            m_Condition.wait(lock, [this] { return m_Stopping || !m_Tasks.empty(); });
+            if (m_Tasks.empty())
+                return;
+            task = std::move(m_Tasks.front());
+            m_Tasks.pop_front();
+        }
+        task();
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of threads running submitted tasks in FIFO order. The destructor
+// finishes the queued tasks before joining.
+class WorkerPool {
+  public:
+    explicit WorkerPool(unsigned threads = std::thread::hardware_concurrency());
+    ~WorkerPool();
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    unsigned Size() const { return (unsigned)m_Threads.size(); }
+
+    template <typename F>
+    auto Submit(F &&task) -> std::future<std::invoke_result_t<F>> {
+        auto packaged = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::forward<F>(task));
+        auto future = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock{m_Mutex};
+            m_Tasks.emplace_back([packaged] { (*packaged)(); });
+        }
+        m_Condition.notify_one();
+        return future;
+    }
+
+  private:
+    void Run();
+
+    std::vector<std::thread> m_Threads;
+    std::deque<std::function<void()>> m_Tasks;
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    bool m_Stopping = false;
+};
+
+// Calls body(begin, end) on contiguous chunks of [0, count) from up to
+// `threads` threads (the caller included) and waits for all of them.
+template <typename F>
+void ParallelFor(size_t count, F &&body, unsigned threads = std::thread::hardware_concurrency())
+{
+    const size_t chunks = std::max<size_t>(1, std::min<size_t>(threads, count));
+    std::vector<std::thread> workers;
+    for (size_t c = 1; c < chunks; ++c)
+        workers.emplace_back([&body, c, count, chunks] { body(count * c / chunks, count * (c + 1) / chunks); });
+    body(0, count / chunks);
+    for (auto &worker : workers)
+        worker.join();
+}
+
+#endif
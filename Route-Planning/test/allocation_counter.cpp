@@ -0,0 +1,58 @@
+#include "allocation_counter.h"
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Every replaceable form is replaced, so each allocation is freed by its own
+// counterpart.
+
+thread_local long *g_AllocationCount = nullptr;
+
+static void *Allocate(size_t size, size_t alignment = 0) noexcept
+{
+    if (g_AllocationCount)
+        ++*g_AllocationCount;
+    size = size ? size : 1;
+    if (alignment <= alignof(std::max_align_t))
+        return std::malloc(size);
+    // aligned_alloc wants a multiple of the alignment.
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+void *operator new(size_t size)
+{
+    if (void *memory = Allocate(size))
+        return memory;
+    throw std::bad_alloc();
+}
+void *operator new[](size_t size) { return operator new(size); }
+void *operator new(size_t size, std::align_val_t alignment)
+{
+    if (void *memory = Allocate(size, (size_t)alignment))
+        return memory;
+    throw std::bad_alloc();
+}
+void *operator new[](size_t size, std::align_val_t alignment) { return operator new(size, alignment); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return Allocate(size); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return Allocate(size); }
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return Allocate(size, (size_t)alignment);
+}
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return Allocate(size, (size_t)alignment);
+}
+
+void operator delete(void *memory) noexcept { std::free(memory); }
+void operator delete[](void *memory) noexcept { std::free(memory); }
+void operator delete(void *memory, size_t) noexcept { std::free(memory); }
+void operator delete[](void *memory, size_t) noexcept { std::free(memory); }
+void operator delete(void *memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete[](void *memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete(void *memory, size_t, std::align_val_t) noexcept { std::free(memory); }
+void operator delete[](void *memory, size_t, std::align_val_t) noexcept { std::free(memory); }
+void operator delete(void *memory, const std::nothrow_t &) noexcept { std::free(memory); }
+void operator delete[](void *memory, const std::nothrow_t &) noexcept { std::free(memory); }
+void operator delete(void *memory, std::align_val_t, const std::nothrow_t &) noexcept { std::free(memory); }
+void operator delete[](void *memory, std::align_val_t, const std::nothrow_t &) noexcept { std::free(memory); }
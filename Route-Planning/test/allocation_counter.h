@@ -0,0 +1,20 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+// Allocation-counting hook: while an AllocationCounter is alive, heap
+// allocations made on its thread are counted. The replaced operator new and
+// delete live in allocation_counter.cpp, out of sight of the tests, so the
+// compiler never pairs an inlined free() with a new-expression.
+extern thread_local long *g_AllocationCount;
+
+class AllocationCounter {
+  public:
+    AllocationCounter() { g_AllocationCount = &m_Count; }
+    ~AllocationCounter() { g_AllocationCount = nullptr; }
+    long Count() const { return m_Count; }
+
+  private:
+    long m_Count = 0;
+};
+
+#endif
@@ -1,10 +1,44 @@
 #include "gtest/gtest.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <functional>
+#include <iomanip>
 #include <iostream>
 #include <optional>
+#include <random>
+#include <set>
+#include <sstream>
+#include <thread>
 #include <vector>
 #include "../src/route_model.h"
 #include "../src/route_planner.h"
+#include "../src/batch.h"
+#include "../src/route_graph.h"
+#include "../src/lpa_star.h"
+#include "../src/chain_graph.h"
+#include "../src/graph_search.h"
+#include "../src/tiled_graph.h"
+#include "../src/anytime_search.h"
+#include "../src/route_service.h"
+#include "../src/segment_rtree.h"
+#include "../src/map_matcher.h"
+#include "../src/mapped_file.h"
+#include "../src/trace.h"
+#include "../src/alternative_routes.h"
+#include "../src/landmarks.h"
+#include "../src/preprocess.h"
+#include "../src/compact_geometry.h"
+#include "../src/osm_pbf.h"
+#include "../src/partition_overlay.h"
+#include "../src/routing_profile.h"
+#include "../src/route_server.h"
+#include "../src/projection.h"
+#include "../src/differential.h"
+#include "../src/facilities.h"
+#include "allocation_counter.h"
 
 
 static std::optional<std::vector<std::byte>> ReadFile(const std::string &path)
@@ -35,6 +69,7 @@ std::vector<std::byte> ReadOSMData(const std::string &path) {
     return osm_data;
 }
 
+
 //--------------------------------//
 //   Beginning RoutePlanner Tests.
 //--------------------------------//
@@ -42,8 +77,7 @@ std::vector<std::byte> ReadOSMData(const std::string &path) {
 class RoutePlannerTest : public ::testing::Test {
   protected:
     std::string osm_data_file = "../map.osm";
-    std::vector<std::byte> osm_data = ReadOSMData(osm_data_file);
-    RouteModel model{osm_data};
+    RouteModel model{MappedFile{osm_data_file}};
     RoutePlanner route_planner{model, 10, 10, 90, 90};
     
     // Construct start_node and end_node as in the model.
@@ -98,14 +132,17 @@ TEST_F(RoutePlannerTest, TestConstructFinalPath) {
     // Construct a path.
     mid_node->parent = start_node;
     end_node->parent = mid_node;
-    std::vector<RouteModel::Node> path = route_planner.ConstructFinalPath(end_node);
+    RoutePath path = route_planner.ConstructFinalPath(end_node);
 
     // Test the path.
     EXPECT_EQ(path.size(), 3);
-    EXPECT_FLOAT_EQ(start_node->x, path.front().x);
-    EXPECT_FLOAT_EQ(start_node->y, path.front().y);
-    EXPECT_FLOAT_EQ(end_node->x, path.back().x);
-    EXPECT_FLOAT_EQ(end_node->y, path.back().y);
+    EXPECT_EQ(path.nodes.front(), start_node->Index());
+    EXPECT_EQ(path.nodes[1], mid_node->Index());
+    EXPECT_EQ(path.nodes.back(), end_node->Index());
+    ASSERT_EQ(path.distances.size(), 3);
+    EXPECT_FLOAT_EQ(path.distances.front(), 0.0f);
+    EXPECT_FLOAT_EQ(path.distances[1], start_node->distance(*mid_node) * model.MetricScale());
+    EXPECT_FLOAT_EQ(path.Length(), route_planner.GetDistance());
 }
 
 
@@ -113,12 +150,1200 @@ TEST_F(RoutePlannerTest, TestConstructFinalPath) {
 TEST_F(RoutePlannerTest, TestAStarSearch) {
     route_planner.AStarSearch();
     EXPECT_EQ(model.path.size(), 33);
-    RouteModel::Node path_start = model.path.front();
-    RouteModel::Node path_end = model.path.back();
+    const RouteModel::Node &path_start = model.SNodes()[model.path.nodes.front()];
+    const RouteModel::Node &path_end = model.SNodes()[model.path.nodes.back()];
     // The start_node and end_node x, y values should be the same as in the path.
     EXPECT_FLOAT_EQ(start_node->x, path_start.x);
     EXPECT_FLOAT_EQ(start_node->y, path_start.y);
     EXPECT_FLOAT_EQ(end_node->x, path_end.x);
     EXPECT_FLOAT_EQ(end_node->y, path_end.y);
     EXPECT_FLOAT_EQ(route_planner.GetDistance(), 873.41565);
+    EXPECT_FLOAT_EQ(model.path.Length(), 873.41565);
+}
+
+
+// Test the per-query statistics collected by AStarSearch.
+TEST_F(RoutePlannerTest, TestSearchStats) {
+    route_planner.AStarSearch();
+    const SearchStats &stats = route_planner.GetStats();
+    EXPECT_EQ(stats.start_node, start_node->Index());
+    EXPECT_EQ(stats.end_node, end_node->Index());
+    EXPECT_EQ(stats.path_nodes, model.path.size());
+    EXPECT_FLOAT_EQ(stats.distance, route_planner.GetDistance());
+    EXPECT_GT(stats.nodes_expanded, 0);
+    EXPECT_GE(stats.edges_relaxed, stats.path_nodes - 1);
+    EXPECT_GT(stats.open_list_peak, 0);
+    EXPECT_GE(stats.search_us, 0.);
+
+    std::ostringstream line;
+    stats.WriteJsonLine(line);
+    EXPECT_EQ(line.str().front(), '{');
+    EXPECT_EQ(line.str().back(), '\n');
+    EXPECT_NE(line.str().find("\"nodes_expanded\":" + std::to_string(stats.nodes_expanded)), std::string::npos);
+
+    SearchStatsAggregate aggregate;
+    aggregate.Add(stats);
+    aggregate.Add(stats);
+    EXPECT_EQ(aggregate.Count(), 2);
+}
+
+
+// Test batch parsing and that repeated queries on one model give identical results.
+TEST_F(RoutePlannerTest, TestBatchQueries) {
+    std::istringstream input{"start_x,start_y,end_x,end_y\n10,10,90,90\n\n# comment\n10,10,90\n10,10,90,190\n10,10,90,90\n"};
+    std::ostringstream errors;
+    auto queries = ReadBatchQueries(input, model, BatchFormat::Percent, errors);
+    ASSERT_EQ(queries.size(), 2);
+    EXPECT_NE(errors.str().find("line 5"), std::string::npos);
+    EXPECT_NE(errors.str().find("line 6"), std::string::npos);
+
+    std::ostringstream output, json_lines;
+    auto aggregate = RunBatch(model, queries, output, &json_lines);
+    EXPECT_EQ(aggregate.Count(), 2);
+    std::istringstream rows{output.str()};
+    std::string header, first, second;
+    std::getline(rows, header);
+    std::getline(rows, first);
+    std::getline(rows, second);
+    EXPECT_EQ(first.substr(0, 2), "0,");
+    EXPECT_NE(first.find(",873.416,33,"), std::string::npos);
+    EXPECT_NE(second.find(",873.416,33,"), std::string::npos);
+
+    // With landmarks the queries run on the routing graph, find the shortest
+    // route and still count relaxed arcs and the heap peak.
+    const Landmarks landmarks = Landmarks::Compute(model.Graph(), 8, 2);
+    BatchSearch search;
+    search.landmarks = &landmarks;
+    std::ostringstream guided_output, guided_json;
+    RunBatch(model, queries, guided_output, &guided_json, search);
+    EXPECT_NE(guided_output.str().find("\n0,10,10,90,90,839.263,70,"), std::string::npos) << guided_output.str();
+    std::istringstream lines{guided_json.str()};
+    int count = 0;
+    for (std::string line; std::getline(lines, line); ++count)
+        for (const std::string key : {"\"nodes_expanded\":", "\"edges_relaxed\":", "\"open_list_peak\":"}) {
+            const size_t at = line.find(key);
+            ASSERT_NE(at, std::string::npos) << line;
+            EXPECT_GT(std::stol(line.substr(at + key.size())), 0) << key << " in " << line;
+        }
+    EXPECT_EQ(count, 2);
+}
+
+
+// Weighted A* and ARA* must report their bound and stay within it; the
+// default search guarantees none.
+TEST_F(RoutePlannerTest, TestWeightedSearch) {
+    SearchWorkspace workspace;
+    const RouteGraph &graph = model.Graph();
+    SearchResult optimal = AStar(graph, workspace, {{start_node->Index(), 0.f}}, {{end_node->Index(), 0.f}});
+    ASSERT_TRUE(optimal.Found());
+    const float shortest = ExtractPath(graph, workspace, end_node->Index()).Length();
+
+    route_planner.SetHeuristicWeight(2.0f);
+    route_planner.AStarSearch();
+    EXPECT_EQ(route_planner.GetStatus(), SearchStatus::Found);
+    EXPECT_FLOAT_EQ(route_planner.GetStats().suboptimality_bound, 2.0f);
+    ASSERT_FALSE(model.path.empty());
+    EXPECT_EQ(model.path.nodes.front(), start_node->Index());
+    EXPECT_EQ(model.path.nodes.back(), end_node->Index());
+    EXPECT_GE(route_planner.GetDistance(), shortest - 0.01f);
+    EXPECT_LE(route_planner.GetDistance(), 2.0f * shortest + 0.01f);
+    for (size_t i = 1; i < model.path.size(); ++i)
+        ASSERT_GE(graph.FindArc(model.path.nodes[i - 1], model.path.nodes[i]), 0);
+
+    model.ResetSearchState();
+    RoutePlanner legacy{model, 10, 10, 90, 90};
+    legacy.AStarSearch();
+    EXPECT_FLOAT_EQ(legacy.GetStats().suboptimality_bound, 0.0f);
+
+    model.ResetSearchState();
+    RoutePlanner anytime{model, 10, 10, 90, 90};
+    auto solutions = anytime.AnytimeSearch(std::chrono::seconds(10));
+    ASSERT_FALSE(solutions.empty());
+    EXPECT_FLOAT_EQ(anytime.GetStats().suboptimality_bound, 1.0f);
+    EXPECT_LE(anytime.GetDistance(), 873.41565 + 0.01);
+    EXPECT_EQ(model.path.nodes.back(), end_node->Index());
+    EXPECT_EQ(anytime.GetStatus(), SearchStatus::Found);
+
+    // An expired deadline still yields the first route, but no refinement.
+    SearchLimits expired;
+    expired.deadline = std::chrono::steady_clock::now();
+    anytime.SetLimits(expired);
+    solutions = anytime.AnytimeSearch(std::chrono::seconds(10));
+    EXPECT_EQ(solutions.size(), 1);
+    EXPECT_EQ(anytime.GetStatus(), SearchStatus::Found);
+
+    // With the end cut off, the previous route must not be left in the model.
+    RouteGraph &mutable_graph = model.Graph();
+    for (int node = 0; node < mutable_graph.NumNodes(); ++node)
+        for (int arc = mutable_graph.FirstArc(node); arc < mutable_graph.LastArc(node); ++arc)
+            if (mutable_graph.Head(arc) == end_node->Index())
+                mutable_graph.CloseEdge(node, end_node->Index());
+    anytime.SetLimits(SearchLimits{});
+    solutions = anytime.AnytimeSearch(std::chrono::seconds(10));
+    EXPECT_TRUE(solutions.empty());
+    EXPECT_EQ(anytime.GetStatus(), SearchStatus::NoRoute);
+    EXPECT_TRUE(model.path.empty());
+    EXPECT_FLOAT_EQ(anytime.GetDistance(), 0.f);
+}
+
+
+// A cancelled or expired query must stop early; others must match the planner.
+TEST_F(RoutePlannerTest, TestQueryLimits) {
+    SearchLimits cancelled;
+    cancelled.token.Cancel();
+    route_planner.SetLimits(cancelled);
+    route_planner.AStarSearch();
+    EXPECT_EQ(route_planner.GetStatus(), SearchStatus::Cancelled);
+    EXPECT_TRUE(model.path.empty());
+
+    RouteService service{model, 2};
+    SearchLimits expired;
+    expired.deadline = std::chrono::steady_clock::now();
+    auto timed_out = service.Query(10, 10, 90, 90, expired);
+    auto found = service.Query(10, 10, 90, 90);
+    auto aborted = service.Query(10, 10, 90, 90, cancelled);
+
+    RouteQueryResult result = found.get();
+    ASSERT_EQ(result.status, SearchStatus::Found);
+    ASSERT_FALSE(result.path.empty());
+    EXPECT_TRUE(result.path.nodes.front() == result.start.from || result.path.nodes.front() == result.start.to);
+    EXPECT_TRUE(result.path.nodes.back() == result.end.from || result.path.nodes.back() == result.end.to);
+    EXPECT_GE(result.stats.distance, result.path.Length());
+    EXPECT_EQ(timed_out.get().status, SearchStatus::TimedOut);
+    result = aborted.get();
+    EXPECT_EQ(result.status, SearchStatus::Cancelled);
+    EXPECT_EQ(result.stats.nodes_expanded, 0);
+}
+
+
+// Parsing the mapped file in place must give the same model as parsing a copy.
+TEST_F(RoutePlannerTest, TestMappedModel) {
+    MappedFile file{osm_data_file};
+    ASSERT_TRUE(file.Valid());
+    EXPECT_FALSE(MappedFile{"missing.osm"}.Valid());
+
+    Model copied{ReadOSMData(osm_data_file)};
+    Model mapped{std::move(file)};
+    EXPECT_FALSE(file.Valid());
+    ASSERT_EQ(mapped.Nodes().size(), copied.Nodes().size());
+    for (size_t i = 0; i < copied.Nodes().size(); ++i) {
+        EXPECT_EQ(mapped.Nodes()[i].x, copied.Nodes()[i].x);
+        EXPECT_EQ(mapped.Nodes()[i].y, copied.Nodes()[i].y);
+    }
+    EXPECT_EQ(mapped.Ways().size(), copied.Ways().size());
+    EXPECT_EQ(mapped.Roads().size(), copied.Roads().size());
+    EXPECT_EQ(mapped.Buildings().size(), copied.Buildings().size());
+    EXPECT_EQ(mapped.MetricScale(), copied.MetricScale());
+}
+
+
+// The PBF encoding of the map must load into the same model as the XML.
+TEST_F(RoutePlannerTest, TestPbfModel) {
+    const auto xml = ReadOSMData(osm_data_file);
+    const auto pbf = ConvertOsmXmlToPbf(xml.data(), xml.size());
+    ASSERT_TRUE(IsOsmPbf(pbf.data(), pbf.size()));
+    EXPECT_FALSE(IsOsmPbf(xml.data(), xml.size()));
+    EXPECT_LT(pbf.size() * 5, xml.size());
+
+    Model from_xml{xml};
+    Model from_pbf{pbf};
+    ASSERT_EQ(from_pbf.Nodes().size(), from_xml.Nodes().size());
+    for (size_t i = 0; i < from_xml.Nodes().size(); ++i) {
+        EXPECT_EQ(from_pbf.Nodes()[i].x, from_xml.Nodes()[i].x);
+        EXPECT_EQ(from_pbf.Nodes()[i].y, from_xml.Nodes()[i].y);
+    }
+    ASSERT_EQ(from_pbf.Ways().size(), from_xml.Ways().size());
+    for (size_t i = 0; i < from_xml.Ways().size(); ++i)
+        EXPECT_EQ(from_pbf.Ways()[i].nodes, from_xml.Ways()[i].nodes);
+    ASSERT_EQ(from_pbf.Roads().size(), from_xml.Roads().size());
+    for (size_t i = 0; i < from_xml.Roads().size(); ++i) {
+        EXPECT_EQ(from_pbf.Roads()[i].way, from_xml.Roads()[i].way);
+        EXPECT_EQ(from_pbf.Roads()[i].type, from_xml.Roads()[i].type);
+    }
+    EXPECT_EQ(from_pbf.Buildings().size(), from_xml.Buildings().size());
+    EXPECT_EQ(from_pbf.Leisures().size(), from_xml.Leisures().size());
+    EXPECT_EQ(from_pbf.Waters().size(), from_xml.Waters().size());
+    EXPECT_EQ(from_pbf.Landuses().size(), from_xml.Landuses().size());
+    EXPECT_EQ(from_pbf.Railways().size(), from_xml.Railways().size());
+    EXPECT_EQ(from_pbf.MetricScale(), from_xml.MetricScale());
+
+    // Decoding on several threads gives the same blocks.
+    const PbfFile serial = ReadOsmPbf(pbf.data(), pbf.size(), 1), parallel = ReadOsmPbf(pbf.data(), pbf.size(), 4);
+    ASSERT_EQ(parallel.blocks.size(), serial.blocks.size());
+    for (size_t i = 0; i < serial.blocks.size(); ++i) {
+        EXPECT_EQ(parallel.blocks[i].nodes.size(), serial.blocks[i].nodes.size());
+        EXPECT_EQ(parallel.blocks[i].ways.size(), serial.blocks[i].ways.size());
+    }
+
+    auto truncated = pbf;
+    truncated.resize(pbf.size() - 10);
+    EXPECT_THROW(Model{truncated}, std::logic_error);
+    auto corrupt = pbf;
+    corrupt[corrupt.size() / 2] ^= std::byte{0x55};
+    EXPECT_THROW(Model{corrupt}, std::logic_error);
+}
+
+
+// Trace scopes must only be recorded while tracing is running.
+TEST_F(RoutePlannerTest, TestTracing) {
+    const std::string path = ::testing::TempDir() + "trace.json";
+    { TraceScope ignored{"before_start"}; }
+    ASSERT_TRUE(Tracer::Start(path));
+    EXPECT_FALSE(Tracer::Start(path));
+    { TraceScope scope{"test_scope"}; }
+    route_planner.AStarSearch();
+    ASSERT_TRUE(Tracer::Stop());
+    EXPECT_FALSE(Tracer::Enabled());
+    { TraceScope ignored{"after_stop"}; }
+
+    std::ifstream is{path};
+    std::string json{std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>()};
+    EXPECT_EQ(json.rfind("{\"traceEvents\":[", 0), 0);
+    EXPECT_NE(json.find("\"name\":\"test_scope\",\"ph\":\"X\""), std::string::npos);
+    EXPECT_EQ(json.find("before_start"), std::string::npos);
+    EXPECT_EQ(json.find("after_stop"), std::string::npos);
+    EXPECT_EQ(json.find("RoutePlanner::AStarSearch") != std::string::npos, Tracer::CompiledIn());
+}
+
+
+//--------------------------------//
+//   Beginning RouteGraph Tests.
+//--------------------------------//
+
+class RouteGraphTest : public ::testing::Test {
+  protected:
+    std::string osm_data_file = "../map.osm";
+    RouteModel model{MappedFile{osm_data_file}};
+    RouteGraph graph{model};
+    int start = model.FindClosestNode(0.1, 0.1).Index();
+    int goal = model.FindClosestNode(0.9, 0.9).Index();
+};
+
+
+// Every arc must have a matching reverse arc of the same length.
+TEST_F(RouteGraphTest, TestArcsAreSymmetric) {
+    ASSERT_GT(graph.NumArcs(), 0);
+    for (int node = 0; node < graph.NumNodes(); ++node)
+        for (int arc = graph.FirstArc(node); arc < graph.LastArc(node); ++arc) {
+            int reverse = graph.ReverseArc(arc);
+            ASSERT_GE(reverse, 0);
+            EXPECT_EQ(graph.Head(reverse), node);
+            EXPECT_FLOAT_EQ(graph.Length(reverse), graph.Length(arc));
+        }
+}
+
+
+// Closing an edge on the route must be repaired to the same result as a fresh search.
+TEST_F(RouteGraphTest, TestLPAStarRepair) {
+    LPAStar planner{graph, start, goal};
+    ASSERT_TRUE(planner.ComputeShortestPath());
+    auto path = planner.Path();
+    ASSERT_GE(path.size(), 3);
+    EXPECT_EQ(path.nodes.front(), start);
+    EXPECT_EQ(path.nodes.back(), goal);
+    EXPECT_FLOAT_EQ(path.Length(), planner.GetDistance());
+    float before = planner.GetDistance();
+    int expansions = planner.Expansions();
+
+    EXPECT_TRUE(graph.CloseEdge(path.nodes[path.size() / 2 - 1], path.nodes[path.size() / 2]));
+    planner.Replan();
+
+    LPAStar scratch{graph, start, goal};
+    scratch.ComputeShortestPath();
+    EXPECT_GE(planner.GetDistance(), before);
+    EXPECT_FLOAT_EQ(planner.GetDistance(), scratch.GetDistance());
+    EXPECT_LE(planner.Expansions() - expansions, scratch.Expansions());
+}
+
+
+// Routes over the chain-compressed graph must match searches over the full graph.
+TEST_F(RouteGraphTest, TestChainCompression) {
+    ChainGraph chains{graph};
+    EXPECT_LT(chains.NumArcs() * 2, graph.NumArcs());
+
+    SearchWorkspace workspace;
+    std::vector<int> routable;
+    for (int node = 0; node < graph.NumNodes(); ++node)
+        if (graph.Degree(node) > 0)
+            routable.push_back(node);
+    for (int i = 0; i < 200; ++i) {
+        int source = routable[(i * 7919) % routable.size()];
+        int target = routable[(i * 104729 + 13) % routable.size()];
+        SearchResult expected = AStar(graph, workspace, {{source, 0.f}}, {{target, 0.f}});
+        SearchResult found;
+        RoutePath path = chains.ShortestPath(workspace, source, target, &found);
+        ASSERT_EQ(found.Found(), expected.Found());
+        if (!expected.Found())
+            continue;
+        EXPECT_NEAR(found.cost, expected.cost, 1e-4f);
+        ASSERT_FALSE(path.empty());
+        EXPECT_EQ(path.nodes.front(), source);
+        EXPECT_EQ(path.nodes.back(), target);
+        for (size_t j = 1; j < path.size(); ++j)
+            ASSERT_GE(graph.FindArc(path.nodes[j - 1], path.nodes[j]), 0);
+        EXPECT_NEAR(path.Length(), expected.cost * graph.MetricScale(), 0.01f);
+    }
+}
+
+
+// Routes over lazily loaded tiles must match the in-memory graph, within the memory budget.
+TEST_F(RouteGraphTest, TestTiledGraph) {
+    ASSERT_TRUE(TiledGraph::Write(graph, ::testing::TempDir(), 8));
+    const size_t budget = 16 * 1024;
+    TiledGraph tiles{::testing::TempDir(), budget};
+    ASSERT_TRUE(tiles.Valid());
+
+    SearchWorkspace workspace;
+    const auto &nodes = model.Nodes();
+    int routed = -1;
+    for (int i = 0; i < 50; ++i) {
+        const auto &from = nodes[(i * 7919) % nodes.size()];
+        const auto &to = nodes[(i * 104729 + 13) % nodes.size()];
+        RoutePath path = tiles.ShortestPath(from.x, from.y, to.x, to.y);
+        if (path.empty())
+            continue;
+        routed = i;
+        SearchResult expected = AStar(graph, workspace, {{path.nodes.front(), 0.f}}, {{path.nodes.back(), 0.f}});
+        ASSERT_TRUE(expected.Found());
+        EXPECT_NEAR(path.Length(), expected.cost * graph.MetricScale(), 0.05f);
+    }
+    EXPECT_GT(tiles.Evictions(), 0);
+    EXPECT_LE(tiles.ResidentBytes(), budget);
+
+    // Corrupt tiles must give an empty route rather than be trusted.
+    ASSERT_GE(routed, 0);
+    const auto &from = nodes[(routed * 7919) % nodes.size()];
+    const auto &to = nodes[(routed * 104729 + 13) % nodes.size()];
+    auto rewrite_tiles = [&](const std::function<void(std::string &)> &corrupt) {
+        for (int t = 0; t < tiles.Grid() * tiles.Grid(); ++t) {
+            const std::string tile_path = ::testing::TempDir() + "/tile_" + std::to_string(t) + ".bin";
+            std::ifstream is{tile_path, std::ios::binary};
+            if (!is)
+                continue;
+            std::string bytes{std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>()};
+            is.close();
+            corrupt(bytes);
+            std::ofstream{tile_path, std::ios::binary | std::ios::trunc}.write(bytes.data(), bytes.size());
+        }
+    };
+    rewrite_tiles([](std::string &bytes) {
+        // Five vectors of 4-byte values precede head_local; point its first arc outside the tile.
+        size_t position = 0;
+        for (int vector = 0; vector < 5; ++vector) {
+            uint64_t size;
+            std::memcpy(&size, bytes.data() + position, sizeof(size));
+            position += sizeof(size) + size * 4;
+        }
+        if (position + 12 <= bytes.size())
+            std::memset(&bytes[position + 8], 0xff, 4);
+    });
+    EXPECT_TRUE((TiledGraph{::testing::TempDir(), budget}.ShortestPath(from.x, from.y, to.x, to.y).empty()));
+    ASSERT_TRUE(TiledGraph::Write(graph, ::testing::TempDir(), 8));
+    rewrite_tiles([](std::string &bytes) { bytes.resize(bytes.size() / 2); });
+    EXPECT_TRUE((TiledGraph{::testing::TempDir(), budget}.ShortestPath(from.x, from.y, to.x, to.y).empty()));
+}
+
+
+// Every ARA* solution must improve on the previous one and respect its bound.
+TEST_F(RouteGraphTest, TestAnytimeSearch) {
+    SearchWorkspace workspace, reference;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    std::vector<int> routable;
+    for (int node = 0; node < graph.NumNodes(); ++node)
+        if (graph.Degree(node) > 0)
+            routable.push_back(node);
+    for (int i = 0; i < 50; ++i) {
+        int source = routable[(i * 7919) % routable.size()];
+        int target = routable[(i * 104729 + 13) % routable.size()];
+        SearchResult optimal = AStar(graph, reference, {{source, 0.f}}, {{target, 0.f}});
+        auto solutions = AnytimeAStar(graph, workspace, source, target, deadline, 5.f, 1.f);
+        ASSERT_EQ(solutions.empty(), !optimal.Found());
+        if (!optimal.Found())
+            continue;
+        for (size_t j = 0; j < solutions.size(); ++j) {
+            const auto &solution = solutions[j];
+            EXPECT_LE(solution.cost, solution.bound * optimal.cost * 1.0001f + 1e-6f);
+            EXPECT_EQ(solution.path.nodes.front(), source);
+            EXPECT_EQ(solution.path.nodes.back(), target);
+            if (j > 0) {
+                EXPECT_LE(solution.cost, solutions[j - 1].cost);
+                EXPECT_LE(solution.bound, solutions[j - 1].bound);
+            }
+        }
+        EXPECT_FLOAT_EQ(solutions.back().bound, 1.f);
+        EXPECT_NEAR(solutions.back().cost, optimal.cost, 1e-4f);
+    }
+}
+
+
+// Snapping must find the same nearest segment as a scan over all of them.
+TEST_F(RouteGraphTest, TestSegmentSnapping) {
+    SegmentRTree tree{graph, 4};
+    EXPECT_EQ(tree.NumSegments() * 2, graph.NumArcs());
+    EXPECT_GT(tree.Height(), 1);
+
+    for (int i = 0; i < 200; ++i) {
+        const double x = (i * 7919 % 1000) / 1000.0, y = (i * 104729 % 997) / 997.0;
+        SegmentSnap snap = tree.Nearest(x, y);
+        ASSERT_TRUE(snap.Valid());
+        ASSERT_GE(graph.FindArc(snap.from, snap.to), 0);
+
+        double best = std::numeric_limits<double>::infinity();
+        for (int node = 0; node < graph.NumNodes(); ++node)
+            for (int arc = graph.FirstArc(node); arc < graph.LastArc(node); ++arc) {
+                const auto &a = graph.Coord(node), &b = graph.Coord(graph.Head(arc));
+                const double dx = b.x - a.x, dy = b.y - a.y;
+                double t = ((x - a.x) * dx + (y - a.y) * dy) / std::max(dx * dx + dy * dy, 1e-300);
+                t = std::clamp(t, 0., 1.);
+                best = std::min(best, std::hypot(a.x + t * dx - x, a.y + t * dy - y));
+            }
+        EXPECT_NEAR(snap.distance, best, 1e-9);
+        const auto &vertex = model.FindClosestNode(x, y);
+        EXPECT_LE(snap.distance, std::hypot(vertex.x - x, vertex.y - y) + 1e-9);
+
+        // The snapped point's seeds add up to the segment's cost.
+        auto sources = tree.SourceSeeds(snap);
+        ASSERT_EQ(sources.size(), 2);
+        EXPECT_NEAR(sources[0].cost + sources[1].cost, graph.Cost(graph.FindArc(snap.from, snap.to)), 1e-6f);
+    }
+}
+
+
+// A noisy trace sampled along a route must be matched back onto that route.
+TEST_F(RouteGraphTest, TestMapMatching) {
+    SearchWorkspace workspace;
+    ASSERT_TRUE(AStar(graph, workspace, {{start, 0.f}}, {{goal, 0.f}}).Found());
+    RoutePath path = ExtractPath(graph, workspace, goal);
+
+    // One fix every 20 m, alternately 4 m to either side of the road.
+    const double spacing = 20. / graph.MetricScale(), offset = 4. / graph.MetricScale();
+    std::vector<TracePoint> trace;
+    double along = 0.;
+    for (size_t i = 1; i < path.size(); ++i) {
+        const auto &a = graph.Coord(path.nodes[i - 1]), &b = graph.Coord(path.nodes[i]);
+        const double length = std::hypot(b.x - a.x, b.y - a.y);
+        for (; along < length; along += spacing) {
+            const double side = trace.size() % 2 ? offset : -offset;
+            trace.push_back({a.x + (b.x - a.x) * along / length - (b.y - a.y) / length * side,
+                             a.y + (b.y - a.y) * along / length + (b.x - a.x) / length * side});
+        }
+        along -= length;
+    }
+    ASSERT_GT(trace.size(), 20);
+
+    SegmentRTree segments{graph};
+    MapMatcher matcher{graph, segments};
+    auto matches = matcher.MatchTraces({trace, trace}, 2);
+    ASSERT_EQ(matches.size(), 2);
+    EXPECT_EQ(matches[0].breaks, 0);
+    int on_route = 0;
+    for (size_t i = 0; i < trace.size(); ++i) {
+        const auto &snap = matches[0].points[i];
+        ASSERT_TRUE(snap.Valid());
+        EXPECT_EQ(snap.from, matches[1].points[i].from);
+        auto from = std::find(path.nodes.begin(), path.nodes.end(), snap.from);
+        auto to = std::find(path.nodes.begin(), path.nodes.end(), snap.to);
+        on_route += from != path.nodes.end() && to != path.nodes.end() && std::abs(from - to) == 1;
+    }
+    EXPECT_GE(on_route, (int)trace.size() * 9 / 10);
+}
+
+
+// Alternatives must be distinct, simple, bounded in length and start with the shortest route.
+TEST_F(RouteGraphTest, TestAlternativeRoutes) {
+    SearchWorkspace workspace;
+    const SearchResult shortest = AStar(graph, workspace, {{start, 0.f}}, {{goal, 0.f}});
+    ASSERT_TRUE(shortest.Found());
+
+    AlternativeOptions options;
+    options.max_alternatives = 3;
+    auto routes = AlternativeRoutes(graph, start, goal, options);
+    ASSERT_GE(routes.size(), 2);
+    EXPECT_LE(routes.size(), 4);
+    EXPECT_NEAR(routes[0].cost, shortest.cost, 1e-4f);
+    EXPECT_EQ(routes[0].via, -1);
+    for (size_t i = 0; i < routes.size(); ++i) {
+        const auto &path = routes[i].path;
+        EXPECT_EQ(path.nodes.front(), start);
+        EXPECT_EQ(path.nodes.back(), goal);
+        EXPECT_LE(routes[i].cost, shortest.cost * options.max_stretch + 1e-4f);
+        std::vector<int> sorted = path.nodes;
+        std::sort(sorted.begin(), sorted.end());
+        EXPECT_EQ(std::adjacent_find(sorted.begin(), sorted.end()), sorted.end());
+        for (size_t j = 1; j < path.size(); ++j)
+            ASSERT_GE(graph.FindArc(path.nodes[j - 1], path.nodes[j]), 0);
+        for (size_t j = 0; j < i; ++j)
+            EXPECT_NE(path.nodes, routes[j].path.nodes);
+    }
+}
+
+
+// Landmark bounds must leave routes unchanged while expanding fewer nodes.
+TEST_F(RouteGraphTest, TestLandmarks) {
+    Landmarks landmarks = Landmarks::Compute(graph, 8, 2);
+    ASSERT_EQ(landmarks.Count(), 8);
+
+    SearchWorkspace workspace;
+    std::vector<int> routable;
+    for (int node = 0; node < graph.NumNodes(); ++node)
+        if (graph.Degree(node) > 0)
+            routable.push_back(node);
+    long plain_expanded = 0, alt_expanded = 0;
+    for (int i = 0; i < 100; ++i) {
+        int source = routable[(i * 7919) % routable.size()];
+        int target = routable[(i * 104729 + 13) % routable.size()];
+        SearchResult expected = AStar(graph, workspace, {{source, 0.f}}, {{target, 0.f}});
+        SearchResult found = landmarks.Search(graph, workspace, source, target);
+        ASSERT_EQ(found.Found(), expected.Found());
+        if (!expected.Found())
+            continue;
+        EXPECT_NEAR(found.cost, expected.cost, 1e-4f);
+        EXPECT_LE(landmarks.LowerBound(source, target), expected.cost + 1e-4f);
+        plain_expanded += expected.expanded;
+        alt_expanded += found.expanded;
+    }
+    EXPECT_LT(alt_expanded, plain_expanded);
+}
+
+
+// The preprocessing artifact must round trip, and be rejected once stale or corrupt.
+TEST_F(RouteGraphTest, TestPreprocessedArtifact) {
+    const std::string map_copy = ::testing::TempDir() + "preprocess_map.osm";
+    {
+        MappedFile source{osm_data_file};
+        std::ofstream os{map_copy, std::ios::binary | std::ios::trunc};
+        os.write(reinterpret_cast<const char *>(source.Data()), source.Size());
+    }
+    std::remove(PreprocessedPath(map_copy).c_str());
+    std::ostringstream log;
+    PreprocessOptions options;
+    options.landmarks = 8;
+    options.threads = 2;
+
+    std::string why;
+    EXPECT_FALSE(LoadPreprocessed(graph, map_copy, &why));
+    EXPECT_EQ(why, "missing");
+    auto computed = Preprocess(graph, map_copy, options, log);
+    ASSERT_TRUE(computed);
+    EXPECT_FALSE(computed->loaded);
+
+    auto loaded = LoadPreprocessed(graph, map_copy, &why);
+    ASSERT_TRUE(loaded) << why;
+    EXPECT_TRUE(loaded->loaded);
+    ASSERT_EQ(loaded->landmarks.Ids(), computed->landmarks.Ids());
+    for (int node = 0; node < graph.NumNodes(); node += 17)
+        EXPECT_EQ(loaded->landmarks.LowerBound(node, goal), computed->landmarks.LowerBound(node, goal));
+    EXPECT_EQ(loaded->chains->KeptNodes(), computed->chains->KeptNodes());
+    EXPECT_EQ(loaded->chains->NumArcs(), computed->chains->NumArcs());
+    loaded.reset();
+
+    // Flip a byte inside the last section.
+    {
+        std::fstream fs{PreprocessedPath(map_copy), std::ios::in | std::ios::out | std::ios::binary};
+        fs.seekp(-1, std::ios::end);
+        fs.put('\x7f');
+    }
+    EXPECT_FALSE(LoadPreprocessed(graph, map_copy, &why));
+    Preprocessed repaired = LoadOrPreprocess(graph, map_copy, options, log);
+    EXPECT_FALSE(repaired.loaded);
+    EXPECT_TRUE(LoadPreprocessed(graph, map_copy));
+
+    // Any change to the map makes the artifact stale.
+    std::ofstream{map_copy, std::ios::app} << "\n";
+    EXPECT_FALSE(LoadPreprocessed(graph, map_copy, &why));
+    EXPECT_EQ(why, "stale: map file changed");
+    EXPECT_FALSE(LoadOrPreprocess(graph, map_copy, options, log).loaded);
+    EXPECT_TRUE(LoadOrPreprocess(graph, map_copy, options, log).loaded);
+
+    // Without a writable location the stages still run only once.
+    std::ostringstream unwritable_log;
+    const Preprocessed in_memory =
+        LoadOrPreprocess(graph, ::testing::TempDir() + "missing_dir/map.osm", options, unwritable_log);
+    EXPECT_FALSE(in_memory.loaded);
+    EXPECT_EQ(in_memory.landmarks.Count(), 8);
+    EXPECT_TRUE(in_memory.chains);
+    const std::string text = unwritable_log.str();
+    EXPECT_EQ(text.find("Preprocessing took"), text.rfind("Preprocessing took")) << text;
+    EXPECT_NE(text.find("Failed to write"), std::string::npos) << text;
+}
+
+
+// Queries answered with the loaded landmarks must match plain A*, and the
+// planner must then return shortest routes on the graph.
+TEST_F(RouteGraphTest, TestPreprocessedRouting) {
+    const std::string map_copy = ::testing::TempDir() + "routing_map.osm";
+    {
+        MappedFile source{osm_data_file};
+        std::ofstream os{map_copy, std::ios::binary | std::ios::trunc};
+        os.write(reinterpret_cast<const char *>(source.Data()), source.Size());
+    }
+    std::ostringstream log;
+    PreprocessOptions options;
+    options.landmarks = 8;
+    options.threads = 2;
+    LoadOrPreprocess(model.Graph(), map_copy, options, log); // writes the artifact
+    Preprocessed preprocessed = LoadOrPreprocess(model.Graph(), map_copy, options, log);
+    ASSERT_TRUE(preprocessed.loaded) << log.str();
+
+    RouteService plain{model, 1}, guided{model, 1};
+    guided.UseLandmarks(std::move(preprocessed.landmarks));
+    long plain_expanded = 0, guided_expanded = 0;
+    for (int i = 0; i < 50; ++i) {
+        const float x0 = (i * 37) % 100, y0 = (i * 53 + 11) % 100, x1 = (i * 71 + 29) % 100, y1 = (i * 13 + 47) % 100;
+        const RouteQueryResult expected = plain.Run(x0, y0, x1, y1);
+        const RouteQueryResult found = guided.Run(x0, y0, x1, y1);
+        ASSERT_EQ(found.status, expected.status);
+        EXPECT_NEAR(found.stats.distance, expected.stats.distance, 1e-2f);
+        plain_expanded += expected.stats.nodes_expanded;
+        guided_expanded += found.stats.nodes_expanded;
+    }
+    EXPECT_LT(guided_expanded, plain_expanded);
+
+    const Landmarks computed = Landmarks::Compute(model.Graph(), 8, 2);
+    SearchWorkspace workspace;
+    const SearchResult shortest = AStar(graph, workspace, {{start, 0.f}}, {{goal, 0.f}});
+    ASSERT_TRUE(shortest.Found());
+    model.ResetSearchState();
+    RoutePlanner planner{model, 10, 10, 90, 90};
+    planner.SetLandmarks(computed);
+    planner.AStarSearch();
+    ASSERT_EQ(planner.GetStatus(), SearchStatus::Found);
+    EXPECT_NEAR(planner.GetDistance(), shortest.cost * graph.MetricScale(), 1e-2f);
+    EXPECT_EQ(planner.GetStats().suboptimality_bound, 1.f);
+}
+
+
+// The compact encoding must reproduce the road network in at most half the memory.
+TEST_F(RouteGraphTest, TestCompactGeometry) {
+    CompactGeometry geometry{model};
+    EXPECT_LE(geometry.MemoryBytes() * 2, CompactGeometry::ModelBytes(model));
+    ASSERT_EQ(geometry.NumNodes(), (int)model.Nodes().size());
+    for (int node = 0; node < geometry.NumNodes(); ++node) {
+        EXPECT_NEAR(geometry.Coord(node).x, model.Nodes()[node].x, geometry.Precision() * 1.01);
+        EXPECT_NEAR(geometry.Coord(node).y, model.Nodes()[node].y, geometry.Precision() * 1.01);
+    }
+    int road = 0;
+    for (const Model::Road &model_road : model.Roads()) {
+        if (model_road.type == Model::Road::Type::Footway)
+            continue;
+        ASSERT_LT(road, geometry.NumRoads());
+        auto nodes = geometry.RoadNodes(road++);
+        EXPECT_EQ(std::vector<int>(nodes.begin(), nodes.end()), model.Ways()[model_road.way].nodes);
+    }
+    EXPECT_EQ(road, geometry.NumRoads());
+
+    RouteGraph compact{geometry};
+    ASSERT_EQ(compact.NumArcs(), graph.NumArcs());
+    for (int arc = 0; arc < graph.NumArcs(); ++arc)
+        EXPECT_EQ(compact.Head(arc), graph.Head(arc));
+    SearchWorkspace workspace;
+    SearchResult expected = AStar(graph, workspace, {{start, 0.f}}, {{goal, 0.f}});
+    SearchResult found = AStar(compact, workspace, {{start, 0.f}}, {{goal, 0.f}});
+    ASSERT_TRUE(found.Found());
+    EXPECT_NEAR(found.cost, expected.cost, 1e-5f);
+}
+
+
+// Overlay queries must match A* on the graph, also after customizing for new costs.
+TEST_F(RouteGraphTest, TestPartitionOverlay) {
+    PartitionOverlay overlay{graph, {32, 256}};
+    ASSERT_EQ(overlay.NumLevels(), 2);
+    std::vector<int> routable;
+    std::vector<int> cell_sizes(overlay.NumCells(0));
+    for (int node = 0; node < graph.NumNodes(); ++node) {
+        if (graph.Degree(node) == 0)
+            continue;
+        routable.push_back(node);
+        cell_sizes[overlay.Cell(0, node)]++;
+    }
+    EXPECT_LE(*std::max_element(cell_sizes.begin(), cell_sizes.end()), 32);
+    // Nodes sharing a cell share the cells of all levels above.
+    for (int node : routable)
+        for (int arc = graph.FirstArc(node); arc < graph.LastArc(node); ++arc) {
+            if (overlay.Cell(0, node) == overlay.Cell(0, graph.Head(arc))) {
+                EXPECT_EQ(overlay.Cell(1, node), overlay.Cell(1, graph.Head(arc)));
+            }
+        }
+    EXPECT_FALSE(overlay.Current());
+    overlay.Customize(2);
+    EXPECT_TRUE(overlay.Current());
+
+    SearchWorkspace workspace;
+    auto check_queries = [&] {
+        for (int i = 0; i < 100; ++i) {
+            int source = routable[(i * 7919) % routable.size()];
+            int target = routable[(i * 104729 + 13) % routable.size()];
+            SearchResult expected = AStar(graph, workspace, {{source, 0.f}}, {{target, 0.f}});
+            SearchResult found;
+            RoutePath path = overlay.ShortestPath(workspace, source, target, &found);
+            ASSERT_EQ(found.Found(), expected.Found());
+            if (!expected.Found())
+                continue;
+            EXPECT_NEAR(found.cost, expected.cost, 1e-4f);
+            ASSERT_FALSE(path.empty());
+            EXPECT_EQ(path.nodes.front(), source);
+            EXPECT_EQ(path.nodes.back(), target);
+            float cost = 0.f;
+            for (size_t j = 1; j < path.size(); ++j) {
+                const int arc = graph.FindArc(path.nodes[j - 1], path.nodes[j]);
+                ASSERT_GE(arc, 0);
+                cost += graph.Cost(arc);
+            }
+            EXPECT_NEAR(cost, expected.cost, 1e-4f);
+        }
+    };
+    check_queries();
+
+    // Penalize every tenth edge and customize again.
+    for (int node : routable)
+        for (int arc = graph.FirstArc(node); arc < graph.LastArc(node); arc += 10)
+            graph.ScaleEdge(node, graph.Head(arc), 3.f);
+    EXPECT_FALSE(overlay.Current());
+    overlay.Customize(2);
+    check_queries();
+}
+
+
+// Profile graphs must only contain the roads their profile allows, weighted by
+// its factors, and build the same in parallel as one at a time.
+TEST_F(RouteGraphTest, TestRoutingProfiles) {
+    const std::vector<RoutingProfile> profiles{RoutingProfile::Car(), RoutingProfile::Bike(), RoutingProfile::Pedestrian()};
+    const auto graphs = BuildProfileGraphs(model, profiles, 3);
+    const auto serial = BuildProfileGraphs(model, profiles, 1);
+    ASSERT_EQ(graphs.size(), profiles.size());
+    EXPECT_FALSE(RoutingProfile::Named("boat"));
+    EXPECT_EQ(RoutingProfile::Named("foot")->name, "foot");
+
+    for (size_t i = 0; i < profiles.size(); ++i) {
+        const RouteGraph &profile_graph = *graphs[i];
+        std::set<std::pair<int, int>> allowed;
+        for (const Model::Road &road : model.Roads())
+            if (profiles[i].Allows(road.type)) {
+                const auto &nodes = model.Ways()[road.way].nodes;
+                for (size_t j = 1; j < nodes.size(); ++j)
+                    allowed.insert(std::minmax(nodes[j - 1], nodes[j]));
+            }
+        ASSERT_EQ(profile_graph.NumNodes(), graph.NumNodes());
+        ASSERT_EQ(profile_graph.NumArcs(), serial[i]->NumArcs());
+        for (int node = 0; node < profile_graph.NumNodes(); ++node)
+            for (int arc = profile_graph.FirstArc(node); arc < profile_graph.LastArc(node); ++arc) {
+                EXPECT_TRUE(allowed.count(std::minmax(node, profile_graph.Head(arc))));
+                EXPECT_GE(profile_graph.Cost(arc), profile_graph.Length(arc));
+                EXPECT_EQ(profile_graph.Cost(arc), profile_graph.BaseCost(arc));
+                EXPECT_EQ(profile_graph.Head(arc), serial[i]->Head(arc));
+                EXPECT_EQ(profile_graph.Cost(arc), serial[i]->Cost(arc));
+            }
+    }
+    // Footways are only walkable.
+    EXPECT_LT(graphs[0]->NumArcs(), graphs[2]->NumArcs());
+
+    // The default profile is the graph every other planner routes on.
+    const RouteGraph default_graph{model, RoutingProfile::Default()};
+    ASSERT_EQ(default_graph.NumArcs(), graph.NumArcs());
+    for (int arc = 0; arc < graph.NumArcs(); ++arc) {
+        EXPECT_EQ(default_graph.Head(arc), graph.Head(arc));
+        EXPECT_EQ(default_graph.Cost(arc), graph.Length(arc));
+    }
+
+    // Each query routes on the graph of its profile. Roads connect the corners
+    // of the map; walking and cycling queries there may snap to footways that
+    // don't, so every profile also routes from the middle of the map to the
+    // farthest node reachable on its graph.
+    RouteService service{model, 2, profiles};
+    ASSERT_EQ(service.NumProfiles(), 4);
+    EXPECT_EQ(service.FindProfile("default"), 0);
+    EXPECT_EQ(service.FindProfile("bike"), 2);
+    EXPECT_EQ(service.FindProfile("boat"), -1);
+    SearchWorkspace workspace;
+    for (int profile = 0; profile < service.NumProfiles(); ++profile) {
+        const RouteGraph &profile_graph = service.Graph(profile);
+        const int from = service.Snap(50, 50, profile).from;
+        BoundedDijkstra(profile_graph, workspace, {{from, 0.f}}, RouteGraph::kClosed);
+        int to = from;
+        for (int node = 0; node < profile_graph.NumNodes(); ++node)
+            if (workspace.Reached(node) && workspace.G(node) > workspace.G(to))
+                to = node;
+        ASSERT_NE(to, from);
+        const auto a = profile_graph.Coord(from), b = profile_graph.Coord(to);
+        std::vector<RouteQueryResult> results;
+        results.push_back(
+            service.Query((float)a.x * 100.f, (float)a.y * 100.f, (float)b.x * 100.f, (float)b.y * 100.f, {}, profile)
+                .get());
+        if (profile <= service.FindProfile("car")) {
+            results.push_back(service.Query(10, 10, 90, 90, {}, profile).get());
+        }
+        for (const RouteQueryResult &result : results) {
+            ASSERT_EQ(result.status, SearchStatus::Found);
+            ASSERT_FALSE(result.path.empty());
+            for (size_t j = 1; j < result.path.size(); ++j)
+                EXPECT_GE(profile_graph.FindArc(result.path.nodes[j - 1], result.path.nodes[j]), 0);
+            EXPECT_GE(result.stats.distance, result.path.Length());
+        }
+    }
+}
+
+
+// The daemon must answer each kind of request, reject malformed ones without
+// dropping the connection, and serve several clients at once. A single worker
+// checks that open but idle connections don't hold on to it.
+TEST_F(RouteGraphTest, TestRouteServer) {
+    RouteService service{model, 2, {RoutingProfile::Car()}};
+    RouteServer server{service, "utest_route_server.sock", 1};
+    std::string why;
+    ASSERT_TRUE(server.Listen(&why)) << why;
+    std::thread serving{[&] { server.Serve(); }};
+
+    RouteClient idle, first, second;
+    ASSERT_TRUE(idle.Connect("utest_route_server.sock"));
+    ASSERT_TRUE(first.Connect("utest_route_server.sock"));
+    ASSERT_TRUE(second.Connect("utest_route_server.sock"));
+    const RouteQueryResult expected = service.Run(10, 10, 90, 90);
+    std::ostringstream distance;
+    distance << std::setprecision(7) << expected.stats.distance;
+
+    std::string route = first.Request(R"({"op":"route","start":[10,10],"end":[90,90]})");
+    EXPECT_EQ(route.find(R"({"status":"found","distance":)" + distance.str() + ","), 0u) << route;
+    EXPECT_NE(route.find(R"("nodes":[)" + std::to_string(expected.path.nodes.front()) + ","), std::string::npos);
+    EXPECT_NE(second.Request(R"({"op":"route","start":[10,10],"end":[90,90],"profile":"car"})").find("found"),
+              std::string::npos);
+
+    const SegmentSnap snap = service.Snap(50, 50);
+    const std::string nearest = second.Request(R"( {"op": "nearest", "point": [50, 50.0]} )");
+    const int node = snap.t <= 0.5f ? snap.from : snap.to;
+    EXPECT_EQ(nearest.find("{\"node\":" + std::to_string(node) + ","), 0u) << nearest;
+
+    const std::string matrix = first.Request(R"({"op":"matrix","points":[[10,10],[90,90]]})");
+    EXPECT_EQ(matrix.find("{\"distances\":[[0," + distance.str() + "],["), 0u) << matrix;
+
+    EXPECT_EQ(first.Request(R"({"op":"route","start":[10,10]})"), R"({"error":"\"end\" must be [x, y]"})");
+    EXPECT_EQ(first.Request(R"({"op":"route","start":[10,10],"end":[90,90],"profile":"boat"})"),
+              R"({"error":"unknown profile"})");
+    EXPECT_EQ(first.Request(R"({"op":"fly"})"), R"({"error":"unknown op"})");
+    EXPECT_EQ(first.Request(R"({"op":"client_key","profile":"boat"})"), R"({"error":"unknown op"})");
+    EXPECT_NE(first.Request(R"({"op":"route",)").find("error"), std::string::npos);
+    EXPECT_NE(first.Request("[1,2").find("error"), std::string::npos);
+
+    const std::string stats = second.Request(R"({"op":"stats"})");
+    EXPECT_NE(stats.find(R"("route":{"count":4,)"), std::string::npos) << stats;
+    EXPECT_NE(stats.find(R"("nearest":{"count":1,)"), std::string::npos) << stats;
+    EXPECT_EQ(stats.find("client_key"), std::string::npos) << stats;
+    EXPECT_EQ(stats.find("fly"), std::string::npos) << stats;
+
+    server.Stop();
+    serving.join();
+}
+
+
+// Histogram percentiles must stay within a bucket of the exact ones.
+TEST_F(RouteGraphTest, TestLatencyHistogram) {
+    LatencyHistogram histogram;
+    EXPECT_EQ(histogram.Percentile(50), 0.);
+    std::vector<double> samples;
+    for (int i = 0; i < 10000; ++i)
+        samples.push_back(0.5 + (i * 7919 % 10000) * (i % 3 ? 0.1 : 10.));
+    for (double sample : samples)
+        histogram.Add(sample);
+    std::sort(samples.begin(), samples.end());
+    EXPECT_EQ(histogram.Count(), 10000);
+    for (double p : {0., 50., 90., 99., 100.}) {
+        EXPECT_GE(histogram.Percentile(p), Percentile(samples, p));
+        EXPECT_LE(histogram.Percentile(p), std::max(1., Percentile(samples, p) * 1.091));
+    }
+    EXPECT_EQ(histogram.Percentile(100), samples.back());
+}
+
+
+// The batched projection must match projecting every node with log/tan, on the
+// map and on synthetic extracts up to a continent, where it falls back.
+TEST_F(RoutePlannerTest, TestProjectionPrecision) {
+    const auto xml = ReadOSMData(osm_data_file);
+    const auto pbf = ConvertOsmXmlToPbf(xml.data(), xml.size());
+    const Model projected{pbf};
+    const PbfFile decoded = ReadOsmPbf(pbf.data(), pbf.size());
+    size_t index = 0;
+    double max_error = 0.;
+    for (const auto &block : decoded.blocks)
+        for (const auto &node : block.nodes) {
+            ASSERT_LT(index, projected.Nodes().size());
+            const Model::Node exact = projected.Project(node.lat, node.lon);
+            max_error = std::max({max_error, std::abs(projected.Nodes()[index].x - exact.x),
+                                  std::abs(projected.Nodes()[index].y - exact.y)});
+            index++;
+        }
+    EXPECT_EQ(index, projected.Nodes().size());
+    EXPECT_LE(max_error * projected.MetricScale(), 1e-6);
+
+    std::mt19937 rng{3};
+    for (auto [low, high] : {std::pair{52.5, 52.6}, std::pair{40., 60.}, std::pair{-80., 89.9}}) {
+        std::uniform_real_distribution<double> lat(low, high), lon(-10., 10.);
+        std::vector<Model::Node> nodes(200000);
+        for (auto &node : nodes)
+            node = {lon(rng), lat(rng)};
+        auto exact = nodes;
+        const double origin_x = MercatorX(-10.), origin_y = MercatorY(low);
+        const double scale = MercatorY(high) - origin_y;
+        ProjectMercator(nodes.data(), nodes.size(), origin_x, origin_y, scale, 4);
+        ProjectMercatorExact(exact.data(), exact.size(), origin_x, origin_y, scale);
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            ASSERT_NEAR(nodes[i].x * scale, exact[i].x * scale, 1e-6) << low << " " << high;
+            ASSERT_NEAR(nodes[i].y * scale, exact[i].y * scale, 1e-6) << low << " " << high;
+        }
+    }
+}
+
+
+// Once a query has sized the result path, repeating it must not touch the heap:
+// neighbor lists and the open list are reserved by the model.
+TEST_F(RoutePlannerTest, TestSearchAllocations) {
+    {
+        AllocationCounter counter;
+        route_planner.AStarSearch();
+        EXPECT_LE(counter.Count(), 2); // the result path's nodes and distances
+    }
+    ASSERT_EQ(route_planner.GetStatus(), SearchStatus::Found);
+    const std::vector<int> expected = model.path.nodes;
+    const float expected_distance = route_planner.GetDistance();
+
+    for (int query = 0; query < 2; ++query) {
+        model.ResetSearchState();
+        AllocationCounter counter;
+        RoutePlanner planner{model, 10, 10, 90, 90};
+        planner.AStarSearch();
+        EXPECT_EQ(counter.Count(), 0);
+        EXPECT_EQ(planner.GetDistance(), expected_distance);
+    }
+    EXPECT_EQ(model.path.nodes, expected);
+}
+
+
+// The differential harness must pass the exact engines on random queries and
+// catch an engine that returns wrong costs or broken routes.
+TEST_F(RouteGraphTest, TestDifferentialEngines) {
+    const ChainGraph chains{graph};
+    const Landmarks landmarks = Landmarks::Compute(graph, 8, 2);
+    PartitionOverlay overlay{graph, {32, 256}};
+    overlay.Customize(2);
+
+    SearchWorkspace workspace;
+    auto astar = [&](int source, int target, RoutePath &path) {
+        SearchResult result = AStar(graph, workspace, {{source, 0.f}}, {{target, 0.f}});
+        if (result.Found())
+            path = ExtractPath(graph, workspace, target);
+        return result;
+    };
+    std::vector<DifferentialEngine> engines = {
+        {"astar", astar},
+        {"alt", [&](int source, int target, RoutePath &) {
+             return landmarks.Search(graph, workspace, source, target);
+         }},
+        {"chain", [&](int source, int target, RoutePath &path) {
+             SearchResult result;
+             path = chains.ShortestPath(workspace, source, target, &result);
+             return result;
+         }},
+        {"overlay", [&](int source, int target, RoutePath &path) {
+             SearchResult result;
+             path = overlay.ShortestPath(workspace, source, target, &result);
+             return result;
+         }},
+        {"inexact", [&](int source, int target, RoutePath &path) {
+             SearchResult result = astar(source, target, path);
+             result.cost *= 1.5f;
+             return result;
+         }, false},
+    };
+    const auto queries = RandomQueries(graph, 1000, 5);
+    ASSERT_EQ(queries.size(), 1000u);
+    DifferentialReport report = RunDifferential(graph, engines, queries);
+    std::ostringstream text;
+    report.Write(text);
+    EXPECT_TRUE(report.Passed()) << text.str();
+    ASSERT_EQ(report.engines.size(), engines.size());
+    EXPECT_GT(report.engines[0].found, 500);
+    for (const auto &engine : report.engines) {
+        EXPECT_EQ(engine.micros.size(), queries.size());
+        EXPECT_EQ(engine.found, report.engines[0].found);
+        EXPECT_NE(text.str().find(engine.name), std::string::npos);
+    }
+
+    // A slightly too long cost, and a route skipping a node, must both be reported.
+    engines.resize(1);
+    engines.push_back({"longer", [&](int source, int target, RoutePath &path) {
+        SearchResult result = astar(source, target, path);
+        result.cost *= 1.01f;
+        path.clear();
+        return result;
+    }});
+    engines.push_back({"shortcut", [&](int source, int target, RoutePath &path) {
+        SearchResult result = astar(source, target, path);
+        if (path.size() > 2)
+            path.nodes.erase(path.nodes.begin() + 1);
+        return result;
+    }});
+    report = RunDifferential(graph, engines, queries);
+    EXPECT_FALSE(report.Passed());
+    EXPECT_EQ(report.engines[1].cost_mismatches, report.engines[0].found);
+    EXPECT_EQ(report.engines[1].invalid_paths, 0);
+    EXPECT_GT(report.engines[2].invalid_paths, 0);
+    EXPECT_EQ(report.engines[2].cost_mismatches, 0);
+    EXPECT_FALSE(report.engines[2].failures.empty());
+}
+
+
+// A planner following a channel must publish partial routes from the start
+// while it searches, end with the complete route, and find the same route.
+TEST_F(RoutePlannerTest, TestProgressiveSearch) {
+    PathChannel channel;
+    RoutePath received, path{{1, 2}, {0.f, 1.f}};
+    bool complete = true;
+    EXPECT_FALSE(channel.TryReceive(received, complete));
+    channel.Publish(path, false);
+    path.nodes = {3, 4, 5};
+    path.distances = {0.f, 1.f, 2.f};
+    channel.Publish(path, true);
+    ASSERT_TRUE(channel.TryReceive(received, complete));
+    EXPECT_EQ(received.nodes, path.nodes); // only the latest route is kept
+    EXPECT_TRUE(complete);
+    EXPECT_FALSE(channel.TryReceive(received, complete));
+    channel.Close();
+    EXPECT_TRUE(channel.Done());
+    EXPECT_FALSE(channel.Receive(received, complete, std::chrono::milliseconds{1}));
+
+    route_planner.AStarSearch();
+    const RoutePath expected = model.path;
+    const float expected_distance = route_planner.GetDistance();
+
+    // Partial routes reach a consumer on another thread only when it happens to
+    // wake up in time, so record every route on the search thread instead. With
+    // no interval the search publishes at every limit check.
+    struct RecordingChannel : PathChannel {
+        std::vector<std::pair<RoutePath, bool>> routes;
+        void Publish(const RoutePath &route, bool route_complete) override {
+            routes.emplace_back(route, route_complete);
+            PathChannel::Publish(route, route_complete);
+        }
+    };
+    model.ResetSearchState();
+    RecordingChannel progress;
+    RoutePlanner planner{model, 10, 10, 90, 90};
+    planner.SetProgress(progress, std::chrono::microseconds{0});
+    planner.AStarSearch();
+    EXPECT_EQ(planner.GetStatus(), SearchStatus::Found);
+    EXPECT_EQ(planner.GetDistance(), expected_distance);
+    EXPECT_EQ(model.path.nodes, expected.nodes);
+    ASSERT_GT(progress.routes.size(), 1u); // a few hundred expansions: several checks
+    EXPECT_TRUE(progress.routes.back().second);
+    EXPECT_EQ(progress.routes.back().first.nodes, expected.nodes);
+    EXPECT_EQ(progress.routes.back().first.distances, expected.distances);
+    ASSERT_TRUE(progress.TryReceive(received, complete));
+    EXPECT_TRUE(complete);
+    EXPECT_EQ(received.nodes, expected.nodes);
+
+    for (size_t i = 0; i + 1 < progress.routes.size(); ++i) {
+        const auto &[route, route_complete] = progress.routes[i];
+        EXPECT_FALSE(route_complete);
+        ASSERT_FALSE(route.empty());
+        EXPECT_EQ(route.nodes.front(), expected.nodes.front());
+        EXPECT_TRUE(std::is_sorted(route.distances.begin(), route.distances.end()));
+        EXPECT_LE(route.Length(), expected_distance + 1e-3f);
+    }
+}
+
+
+// The k nearest facilities must match a full Dijkstra, and the service must
+// agree between single and batch queries.
+TEST_F(RouteGraphTest, TestNearestFacilities) {
+    std::vector<int> routable;
+    for (int node = 0; node < graph.NumNodes(); ++node)
+        if (graph.Degree(node) > 0)
+            routable.push_back(node);
+    std::mt19937 rng{17};
+    std::uniform_int_distribution<size_t> pick(0, routable.size() - 1);
+    FacilitySet facilities{graph};
+    std::vector<int> depots;
+    for (int i = 0; i < 50; ++i) {
+        depots.push_back(routable[pick(rng)]);
+        EXPECT_EQ(facilities.Add(depots.back()), i);
+    }
+    // One facility reached through two nodes counts once, at its cheaper attachment.
+    const int shared = facilities.Add({{depots[0], 1.f}, {depots[1], 0.f}});
+
+    const int k = 5;
+    SearchWorkspace workspace, full;
+    for (int q = 0; q < 50; ++q) {
+        const int source = routable[pick(rng)];
+        const auto nearest = NearestFacilities(graph, workspace, {{source, 0.f}}, facilities, k);
+        BoundedDijkstra(graph, full, {{source, 0.f}}, RouteGraph::kClosed);
+        std::vector<float> expected;
+        for (int depot : depots)
+            if (full.Reached(depot))
+                expected.push_back(full.G(depot));
+        if (full.Reached(depots[0]) || full.Reached(depots[1]))
+            expected.push_back(std::min(full.G(depots[0]) + 1.f, full.G(depots[1])));
+        std::sort(expected.begin(), expected.end());
+        expected.resize(std::min<size_t>(expected.size(), k));
+
+        ASSERT_EQ(nearest.size(), expected.size());
+        std::set<int> seen;
+        for (size_t i = 0; i < nearest.size(); ++i) {
+            EXPECT_NEAR(nearest[i].cost, expected[i], 1e-4f);
+            EXPECT_TRUE(seen.insert(nearest[i].facility).second);
+            const int node = nearest[i].facility == shared ? -1 : depots[nearest[i].facility];
+            if (node >= 0) {
+                EXPECT_NEAR(nearest[i].cost, full.G(node), 1e-4f);
+            }
+        }
+    }
+    EXPECT_TRUE(NearestFacilities(graph, workspace, {{routable[0], 0.f}}, facilities, 0).empty());
+
+    // Service: facilities at points, single and batch queries.
+    RouteService service{model, 2};
+    std::uniform_real_distribution<float> percent(5.f, 95.f);
+    std::vector<std::pair<float, float>> points, queries;
+    for (int i = 0; i < 40; ++i)
+        points.push_back({percent(rng), percent(rng)});
+    for (int i = 0; i < 30; ++i)
+        queries.push_back({percent(rng), percent(rng)});
+    queries.push_back(points[3]); // on a facility
+    const FacilitySet depots_at = service.SnapFacilities(points);
+    ASSERT_EQ(depots_at.Count(), (int)points.size());
+    EXPECT_TRUE(depots_at.Snap(0).Valid());
+
+    // Costs must match a full search from the query point, which also reaches
+    // facilities on the point's own segment directly along it.
+    const RouteGraph &service_graph = service.Graph();
+    const SegmentRTree segments{service_graph};
+    const auto batch = service.NearestFacilities(queries, depots_at, k);
+    ASSERT_EQ(batch.size(), queries.size());
+    for (size_t q = 0; q < queries.size(); ++q) {
+        const auto single = service.NearestFacilities(queries[q].first, queries[q].second, depots_at, k);
+        ASSERT_EQ(batch[q].size(), single.size());
+        EXPECT_LE(single.size(), (size_t)k);
+        for (size_t i = 0; i < single.size(); ++i) {
+            EXPECT_EQ(batch[q][i].facility, single[i].facility);
+            EXPECT_EQ(batch[q][i].cost, single[i].cost);
+            if (i > 0) {
+                EXPECT_LE(single[i - 1].cost, single[i].cost);
+            }
+        }
+
+        const SegmentSnap start = service.Snap(queries[q].first, queries[q].second);
+        BoundedDijkstra(service_graph, full, segments.SourceSeeds(start), RouteGraph::kClosed);
+        std::vector<float> costs;
+        for (int facility = 0; facility < depots_at.Count(); ++facility)
+            costs.push_back(segments.DirectCost(start, depots_at.Snap(facility)));
+        for (int node = 0; node < service_graph.NumNodes(); ++node)
+            if (full.Reached(node))
+                depots_at.ForEachAt(node, [&](int facility, float cost) {
+                    costs[facility] = std::min(costs[facility], full.G(node) + cost);
+                });
+        std::sort(costs.begin(), costs.end());
+        costs.erase(std::find(costs.begin(), costs.end(), RouteGraph::kClosed), costs.end());
+        costs.resize(std::min<size_t>(costs.size(), k));
+        ASSERT_EQ(single.size(), costs.size());
+        for (size_t i = 0; i < single.size(); ++i)
+            EXPECT_NEAR(single[i].cost, costs[i] * service_graph.MetricScale(), 1e-2);
+    }
+    ASSERT_FALSE(batch.back().empty());
+    EXPECT_NEAR(batch.back().front().cost, 0.f, 1e-3f);
 }